@@ -21,6 +21,17 @@
 #ifndef __BOARDS_XTENSA_ESP32_ESP32_DEVKITC_INCLUDE_BOARD_H
 #define __BOARDS_XTENSA_ESP32_ESP32_DEVKITC_INCLUDE_BOARD_H
 
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#if (defined(CONFIG_BOARD_ESP32_HRTIME) || \
+     defined(CONFIG_BOARD_ESP32_SAMPLER)) && !defined(__ASSEMBLY__)
+#  include <nuttx/compiler.h>
+#  include <stdint.h>
+#  include <sys/boardctl.h>
+#endif
+
 /****************************************************************************
  * Pre-processor Definitions
  ****************************************************************************/
@@ -62,4 +73,92 @@
 #define BOARD_NGPIOIN     1 /* Amount of GPIO Input without Interruption */
 #define BOARD_NGPIOINT    1 /* Amount of GPIO Input w/ Interruption pins */
 
+/* High resolution time *****************************************************/
+
+/* boardctl(BOARDIOC_HRTIME_PAGE, (uintptr_t)&page) returns the address of
+ * the struct hrtime_page_s below.  Reading it needs no system call.  The
+ * board commands have the same numbers as on the ESP32-S3.
+ */
+
+#define BOARDIOC_HRTIME_PAGE    (BOARDIOC_USER + 0)
+
+#define HRTIME_VERSION          1
+
+/* Thread placement *********************************************************/
+
+/* boardctl(BOARDIOC_AFFINITY_APPLY, 0) applies the thread placement plan to
+ * the threads running at that time and returns how many it placed.
+ */
+
+#define BOARDIOC_AFFINITY_APPLY (BOARDIOC_USER + 1)
+
+/****************************************************************************
+ * Public Types
+ ****************************************************************************/
+
+#if defined(CONFIG_BOARD_ESP32_HRTIME) && !defined(__ASSEMBLY__)
+
+/* Board time page.  read_us() is the RT timer, a monotonic microsecond
+ * count from the crystal that is cheaper than clock_gettime().
+ * read_cycles() is the cycle counter of the calling CPU, not synchronized
+ * between the CPUs.  The wall clock fields are refreshed from the RTC in
+ * the background, read them with hrtime_realtime_us().
+ */
+
+struct hrtime_page_s
+{
+  volatile uint32_t seq;             /* Odd while the page is updated */
+  uint32_t version;                  /* HRTIME_VERSION */
+  uint32_t cycle_hz;                 /* Rate of read_cycles() */
+  volatile int32_t rtc_ppm;          /* RTC rate error vs read_us() */
+  volatile int64_t realtime_offset;  /* Wall clock minus read_us() (us) */
+  CODE uint64_t (*read_us)(void);
+  CODE uint32_t (*read_cycles)(void);
+};
+
+/****************************************************************************
+ * Inline Functions
+ ****************************************************************************/
+
+/* Microseconds since the epoch, by the RTC */
+
+static inline int64_t
+hrtime_realtime_us(FAR const struct hrtime_page_s *page)
+{
+  uint32_t seq;
+  int64_t us;
+
+  do
+    {
+      seq = page->seq;
+      us  = (int64_t)page->read_us() + page->realtime_offset;
+    }
+  while ((seq & 1) != 0 || seq != page->seq);
+
+  return us;
+}
+
+#endif /* CONFIG_BOARD_ESP32_HRTIME && !__ASSEMBLY__ */
+
+#if defined(CONFIG_BOARD_ESP32_SAMPLER) && !defined(__ASSEMBLY__)
+
+/* Every record read from /dev/sample/<name> starts with this header and
+ * is padded to a multiple of 8 bytes.  'timestamp' is the time the read
+ * of the sample started and 'due' the timer tick it was taken for, both
+ * in microseconds on the RT timer.  A gap in 'seqno' means that records
+ * were dropped from a full ring or that the sampler overran and missed
+ * ticks.
+ */
+
+struct sampler_hdr_s
+{
+  uint64_t timestamp;                /* Acquisition time (us) */
+  uint64_t due;                      /* Due time (us) */
+  uint32_t seqno;                    /* Sample number */
+  uint16_t len;                      /* Data bytes that follow */
+  int16_t  error;                    /* Negated errno of a failed read */
+};
+
+#endif /* CONFIG_BOARD_ESP32_SAMPLER && !__ASSEMBLY__ */
+
 #endif /* __BOARDS_XTENSA_ESP32_ESP32_DEVKITC_INCLUDE_BOARD_H */
@@ -29,6 +29,14 @@
 #include <nuttx/compiler.h>
 #include <stdint.h>
 
+#ifdef CONFIG_BOARD_ESP32_IRQROUTE
+#  include <nuttx/irq.h>
+#endif
+
+#ifdef CONFIG_BOARD_ESP32_PCOUNT
+#  include <sys/types.h>
+#endif
+
 /****************************************************************************
  * Pre-processor Definitions
  ****************************************************************************/
@@ -61,15 +69,88 @@
 #define TIMER2 2
 #define TIMER3 3
 
+/* Hardware timer of the sensor sampler */
+
+#define SAMPLER_TIMER         TIMER3
+
 /* ONESHOT */
 
 #define ONESHOT_TIMER         1
 #define ONESHOT_RESOLUTION_US 1
 
+/* Bringup steps */
+
+#define INITSTEP_BIT(n)       (UINT32_C(1) << (n))
+
+#define INITSTEP_BACKGROUND   (1 << 0) /* NSH does not wait for the step */
+#define INITSTEP_OPTIONAL     (1 << 1) /* Skipped when absent at last boot */
+
+/* Boot profiling marks, see esp32_bootprof_mark() */
+
+#define BOOTPROF_BOARD_INIT   0 /* esp32_board_initialize() entered */
+#define BOOTPROF_LATE_INIT    1 /* board_late_initialize() entered */
+#define BOOTPROF_BRINGUP_DONE 2 /* Foreground bringup steps complete */
+#define BOOTPROF_NSH_START    3 /* NSH called board_app_initialize() */
+#define BOOTPROF_NMARKS       4
+
+/* Warm boot records, see esp32_warmboot_get() */
+
+#define WARMBOOT_ID_ABSENT    1 /* Absent devices, by name CRC-32 */
+
+/* Interrupt sources routed to a CPU, see esp32_irqroute_call() */
+
+#define IRQROUTE_W5500        0 /* W5500 interrupt pin */
+#define IRQROUTE_GPIO         1 /* /dev/gpio interrupt pins */
+#define IRQROUTE_BUTTONS      2 /* BOOT button */
+#define IRQROUTE_TWAI         3 /* TWAI controller */
+#define IRQROUTE_NSOURCES     4
+
+/* Board trace events, see esp32_btrace_begin() */
+
+#define BTRACE_SPI            0 /* SPI transfer, arg: device ID */
+#define BTRACE_LCD            1 /* Display transfer, arg: device ID */
+#define BTRACE_NIDS           2
+
+/* Drivers with counters in /proc/board, see esp32_pcount_end() */
+
+#define PCOUNT_W5500          0 /* W5500 SPI traffic */
+#define PCOUNT_MMCSD          1 /* SD card SPI traffic */
+#define PCOUNT_DISPLAY        2 /* Display SPI traffic */
+#define PCOUNT_GPIO           3 /* /dev/gpio writes and interrupts */
+#define PCOUNT_TWAI           4 /* TWAI frames sent */
+#define PCOUNT_NIDS           5
+
 /****************************************************************************
  * Public Types
  ****************************************************************************/
 
+#ifndef __ASSEMBLY__
+
+/* Usage of one heap region, see esp32_heapmon_stats() */
+
+struct esp32_heapstat_s
+{
+  FAR const char *name;      /* Region name */
+  size_t size;               /* Heap bytes in the region */
+  size_t used;               /* Allocated bytes, chunk headers included */
+  size_t free;               /* Free bytes */
+  size_t largest;            /* Largest free chunk */
+  size_t peak;               /* Highest 'used' sampled since boot */
+  uint32_t nfree;            /* Number of free chunks */
+};
+
+/* One step of the board bringup, see esp32_initsteps_run() */
+
+struct esp32_initstep_s
+{
+  FAR const char *name;      /* Name used in diagnostics */
+  CODE int (*init)(void);    /* NULL if compiled out */
+  uint32_t deps;             /* INITSTEP_BIT() of the steps it waits for */
+  uint8_t flags;             /* INITSTEP_* flags */
+};
+
+#endif /* __ASSEMBLY__ */
+
 /****************************************************************************
  * Public Data
  ****************************************************************************/
@@ -96,6 +177,258 @@
 
 int esp32_bringup(void);
 
+/****************************************************************************
+ * Name: esp32_initsteps_run
+ *
+ * Description:
+ *   Run a table of bringup steps, concurrently where their dependencies
+ *   allow it if CONFIG_BOARD_ESP32_INITSTEPS_PARALLEL is selected.
+ *
+ * Input Parameters:
+ *   steps  - The step table, in dependency order
+ *   nsteps - Number of entries in the table (32 at most)
+ *
+ * Returned Value:
+ *   Zero (OK) is returned on success; A negated errno value is returned
+ *   to indicate the nature of any failure.
+ *
+ ****************************************************************************/
+
+int esp32_initsteps_run(FAR const struct esp32_initstep_s *steps,
+                        int nsteps);
+
+/****************************************************************************
+ * Name: esp32_reclaim / esp32_reclaim_bytes
+ *
+ * Description:
+ *   Add the boot-only ROM app data to the heap once every CPU runs, and
+ *   return how many bytes it gave, for /proc/heapmon.
+ *
+ ****************************************************************************/
+
+void esp32_reclaim(void);
+size_t esp32_reclaim_bytes(void);
+
+/****************************************************************************
+ * Name: esp32_heapmon_initialize
+ *
+ * Description:
+ *   Start sampling the usage of each heap region and register
+ *   /proc/heapmon.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32_HEAPMON
+int esp32_heapmon_initialize(void);
+#endif
+
+/****************************************************************************
+ * Name: esp32_heapmon_stats
+ *
+ * Description:
+ *   Copy the last sample of up to 'nstats' heap regions.
+ *
+ * Returned Value:
+ *   The number of regions copied.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32_HEAPMON
+int esp32_heapmon_stats(FAR struct esp32_heapstat_s *stats, int nstats);
+#endif
+
+/****************************************************************************
+ * Name: esp32_spiarb_install
+ *
+ * Description:
+ *   Route the transfers of every device on the SPI bus 'dev' through the
+ *   bus arbiter.  Long transfers are split in chunks of
+ *   CONFIG_BOARD_ESP32_SPIARB_CHUNK bytes and a waiting thread of higher
+ *   priority gets the bus between two chunks.  The configuration last
+ *   programmed on the bus is cached so that a device finding the bus as
+ *   it left it does not reprogram it.  The bus wait of each device is
+ *   reported in /proc/spiarb.  Calling it again for the same bus is
+ *   harmless.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32_SPIARB
+struct spi_dev_s;
+int esp32_spiarb_install(FAR struct spi_dev_s *dev);
+#endif
+
+/****************************************************************************
+ * Name: esp32_affinity_apply
+ *
+ * Description:
+ *   Pin the threads named in CONFIG_BOARD_ESP32_AFFINITY_PLAN to their CPU
+ *   and set their priority.
+ *
+ * Returned Value:
+ *   The number of threads placed, or a negated errno value.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32_AFFINITY
+int esp32_affinity_apply(void);
+#endif
+
+/****************************************************************************
+ * Name: esp32_affinity_initialize
+ *
+ * Description:
+ *   Start the per-CPU jitter probes and register /proc/jitter.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32_AFFINITY_JITTER
+int esp32_affinity_initialize(void);
+#endif
+
+/****************************************************************************
+ * Name: esp32_irqroute_initialize
+ *
+ * Description:
+ *   Register /proc/irqroute, which shows the CPU each IRQROUTE_* source is
+ *   routed to and the interrupts each CPU took.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32_IRQROUTE
+int esp32_irqroute_initialize(void);
+#endif
+
+/****************************************************************************
+ * Name: esp32_irqroute_call
+ *
+ * Description:
+ *   Run 'func' on the CPU the IRQROUTE_* 'source' is routed to.  An
+ *   interrupt enabled or a driver set up from 'func' is taken by that CPU.
+ *
+ * Returned Value:
+ *   The value returned by 'func', or a negated errno value.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32_IRQROUTE
+int esp32_irqroute_call(int source, CODE int (*func)(FAR void *arg),
+                        FAR void *arg);
+#endif
+
+/****************************************************************************
+ * Name: esp32_irqroute_attach / esp32_irqroute_gpioenable
+ *
+ * Description:
+ *   Replacements for irq_attach() and esp32_gpioirqenable() that count
+ *   the interrupts of 'source' per CPU and enable the pin on its CPU.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32_IRQROUTE
+int esp32_irqroute_attach(int source, int irq, xcpt_t handler,
+                          FAR void *arg);
+int esp32_irqroute_gpioenable(int source, int irq, int intrtype);
+#endif
+
+/****************************************************************************
+ * Name: esp32_bootprof_initialize
+ *
+ * Description:
+ *   Register /proc/boardinit, which reports the time at which each boot
+ *   phase was reached and the duration, return code and heap usage of
+ *   every bringup step.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32_BOOTPROF
+int esp32_bootprof_initialize(void);
+#endif
+
+/****************************************************************************
+ * Name: esp32_bootprof_mark
+ *
+ * Description:
+ *   Record the time at which the boot phase BOOTPROF_<mark> was reached.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32_BOOTPROF
+void esp32_bootprof_mark(int mark);
+#endif
+
+/****************************************************************************
+ * Name: esp32_bootprof_begin / esp32_bootprof_end
+ *
+ * Description:
+ *   Time a bringup step.  esp32_bootprof_begin() returns the handle to
+ *   pass to esp32_bootprof_end() together with the result of the step.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32_BOOTPROF
+int esp32_bootprof_begin(FAR const char *name);
+void esp32_bootprof_end(int handle, int ret);
+#endif
+
+/****************************************************************************
+ * Name: esp32_lazydev_register
+ *
+ * Description:
+ *   Register a placeholder device node at 'path' and run 'init', which
+ *   registers the real driver at the same path, on its first open.
+ *
+ * Returned Value:
+ *   Zero (OK) is returned on success; A negated errno value is returned
+ *   to indicate the nature of any failure.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32_LAZYDEV
+int esp32_lazydev_register(FAR const char *path, CODE int (*init)(void));
+#endif
+
+/****************************************************************************
+ * Name: esp32_warmboot_initialize
+ *
+ * Description:
+ *   Validate and consume the snapshot that the previous boot left in RTC
+ *   memory before a clean reset.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32_WARMBOOT
+void esp32_warmboot_initialize(void);
+#endif
+
+/****************************************************************************
+ * Name: esp32_warmboot_get / esp32_warmboot_put
+ *
+ * Description:
+ *   Look up a WARMBOOT_ID_* record saved by the previous boot, and save
+ *   one for the next boot.  esp32_warmboot_get() returns NULL after a
+ *   cold boot.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32_WARMBOOT
+FAR const void *esp32_warmboot_get(uint16_t id, FAR size_t *len);
+int esp32_warmboot_put(uint16_t id, FAR const void *data, size_t len);
+#endif
+
+/****************************************************************************
+ * Name: esp32_warmboot_commit / esp32_warmboot_invalidate
+ *
+ * Description:
+ *   Called before a reset: store the records saved during this boot in
+ *   RTC memory, or make the next boot a cold one.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32_WARMBOOT
+void esp32_warmboot_commit(void);
+void esp32_warmboot_invalidate(void);
+#endif
+
 /****************************************************************************
  * Name: esp32_mmcsd_initialize
  *
@@ -155,6 +488,23 @@ int board_spidev_initialize(int bus);
 int esp32_twai_setup(void);
 #endif
 
+/****************************************************************************
+ * Name: esp32_canudp_initialize
+ *
+ * Description:
+ *   Start the gateway that forwards CAN frames from the TWAI device to a
+ *   remote host as batched UDP datagrams.
+ *
+ * Returned Value:
+ *   Zero (OK) is returned on success; A negated errno value is returned
+ *   to indicate the nature of any failure.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32_CANUDP
+int esp32_canudp_initialize(void);
+#endif
+
 /****************************************************************************
  * Name: board_i2sdev_initialize
  *
@@ -201,5 +551,185 @@ int board_i2sdev_initialize(int port, bool enable_tx, bool enable_rx);
 int esp32_cs4344_initialize(int port);
 #endif
 
+/****************************************************************************
+ * Name: esp32_btrace_initialize
+ *
+ * Description:
+ *   Start recording scheduler, interrupt and board events in per-CPU
+ *   rings and register /dev/btrace, which returns them as ftrace text.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32_BTRACE
+int esp32_btrace_initialize(void);
+#endif
+
+/****************************************************************************
+ * Name: esp32_btrace_begin / esp32_btrace_end
+ *
+ * Description:
+ *   Mark the start and the end of the BTRACE_* event 'id'.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32_BTRACE
+void esp32_btrace_begin(int id, uint32_t arg);
+void esp32_btrace_end(int id, uint32_t arg);
+#endif
+
+/****************************************************************************
+ * Name: esp32_btrace_ring
+ *
+ * Description:
+ *   Stop tracing and return the raw event ring of 'cpu', for the crash
+ *   dump.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32_BTRACE
+FAR const void *esp32_btrace_ring(int cpu, FAR size_t *size);
+#endif
+
+/****************************************************************************
+ * Name: esp32_pcount_initialize
+ *
+ * Description:
+ *   Register /proc/board, which shows the bytes, transactions, errors,
+ *   longest transaction and busy time of every PCOUNT_* driver.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32_PCOUNT
+int esp32_pcount_initialize(void);
+#endif
+
+/****************************************************************************
+ * Name: esp32_pcount_begin / esp32_pcount_end
+ *
+ * Description:
+ *   Time a transaction of the PCOUNT_* driver 'id' and account it with
+ *   the 'nbytes' it moved and its result 'ret'.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32_PCOUNT
+uint64_t esp32_pcount_begin(void);
+void esp32_pcount_end(int id, uint64_t start, size_t nbytes, int ret);
+#endif
+
+/****************************************************************************
+ * Name: esp32_blog_initialize
+ *
+ * Description:
+ *   Start the thread that formats and prints the deferred log records.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32_BLOG
+int esp32_blog_initialize(void);
+#endif
+
+/****************************************************************************
+ * Name: esp32_blog
+ *
+ * Description:
+ *   syslog() that only records the format and its arguments.  With
+ *   BOARD_ESP32_BLOG the board sources log through it, the debug macros
+ *   built on syslog() included.  Code that logs on the way to a reset or
+ *   a crash must #undef syslog to print synchronously.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32_BLOG
+int esp32_blog(int priority, FAR const IPTR char *fmt, ...)
+  printf_like(2, 3);
+#  define syslog esp32_blog
+#endif
+
+/****************************************************************************
+ * Name: esp32_stkmon_initialize
+ *
+ * Description:
+ *   Start sampling the stacks and register /proc/stkmon, which shows their
+ *   peak use over the boots kept in RTC memory and a recommended size.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32_STKMON
+int esp32_stkmon_initialize(void);
+#endif
+
+/****************************************************************************
+ * Name: esp32_crashdump_initialize
+ *
+ * Description:
+ *   Open the crash dump partition and register /dev/crashdump, which
+ *   returns the dump saved by board_crashdump() before the last reset.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32_CRASHDUMP
+int esp32_crashdump_initialize(void);
+#endif
+
+/****************************************************************************
+ * Name: esp32_hrtime_initialize / esp32_hrtime_page
+ *
+ * Description:
+ *   Set up the time page returned by boardctl(BOARDIOC_HRTIME_PAGE) and
+ *   keep its wall clock offset calibrated against the RTC.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32_HRTIME
+struct hrtime_page_s;
+
+int esp32_hrtime_initialize(void);
+FAR const struct hrtime_page_s *esp32_hrtime_page(void);
+#endif
+
+/****************************************************************************
+ * Name: esp32_rtcsync_initialize
+ *
+ * Description:
+ *   Start disciplining the RTC from an SNTP server, with the frequency
+ *   correction kept in RTC memory across resets and deep sleep.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32_RTCSYNC
+int esp32_rtcsync_initialize(void);
+#endif
+
+/****************************************************************************
+ * Name: esp32_sampler_initialize / esp32_sampler_register
+ *
+ * Description:
+ *   Start the timer driven sensor sampler and add a device to it, read
+ *   every 'period_us' into the ring returned by /dev/sample/<name>.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32_SAMPLER
+int esp32_sampler_initialize(void);
+int esp32_sampler_register(FAR const char *name, FAR const char *devpath,
+                           uint32_t period_us, uint16_t size);
+#endif
+
+/****************************************************************************
+ * Name: esp32_delay_initialize / esp32_delay_us / esp32_delay_ms
+ *
+ * Description:
+ *   Delays timed by the RT timer instead of CONFIG_BOARD_LOOPSPERMSEC.  Long
+ *   delays sleep, short ones and the last tick of long ones spin.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32_DELAY
+int esp32_delay_initialize(void);
+void esp32_delay_us(uint32_t us);
+void esp32_delay_ms(uint32_t ms);
+#endif
+
 #endif /* __ASSEMBLY__ */
 #endif /* __BOARDS_XTENSA_ESP32_ESP32_DEVKITC_SRC_ESP32_DEVKITC_H */
@@ -0,0 +1,691 @@
+/****************************************************************************
+ * boards/xtensa/esp32/esp32-devkitc/src/esp32_blog.c
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <sys/types.h>
+#include <sys/param.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <syslog.h>
+#include <debug.h>
+
+#include <nuttx/clock.h>
+#include <nuttx/kthread.h>
+#include <nuttx/semaphore.h>
+#include <nuttx/spinlock.h>
+
+#include "esp32-devkitc.h"
+
+#ifdef CONFIG_BOARD_ESP32_BLOG
+
+/* The formatter prints through the real syslog() */
+
+#undef syslog
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define BLOG_NRECORDS   CONFIG_BOARD_ESP32_BLOG_NRECORDS
+#define BLOG_DATASIZE   48     /* Argument bytes per record */
+#define BLOG_SPECLEN    24     /* Longest conversion specification */
+#define BLOG_LINELEN    160
+
+/* Argument types, from the length modifier and the conversion */
+
+#define BLOG_INT        0
+#define BLOG_LONG       1
+#define BLOG_LLONG      2
+#define BLOG_SIZE       3
+#define BLOG_INTMAX     4
+#define BLOG_PTRDIFF    5
+#define BLOG_PTR        6
+#define BLOG_DOUBLE     7
+#define BLOG_STRING     8
+#define BLOG_NONE       9      /* %% or an unknown conversion */
+
+/* Precision of a conversion when not given as digits */
+
+#define BLOG_PREC_NONE  -1
+#define BLOG_PREC_STAR  -2     /* From the last '*' argument */
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+/* One log call: the format stays in flash, the arguments are copied in the
+ * order the format consumes them, strings included.
+ */
+
+struct blog_rec_s
+{
+  FAR const IPTR char *fmt;
+  clock_t  time;             /* System ticks when logged */
+  uint8_t  priority;
+  uint8_t  datalen;
+  uint8_t  data[BLOG_DATASIZE];
+};
+
+struct blog_s
+{
+  spinlock_t lock;
+  sem_t      sem;            /* Posted when the ring gets a record */
+  uint32_t   head;           /* Records logged */
+  uint32_t   tail;           /* Records printed */
+  uint32_t   ndropped;       /* Records lost to a full ring */
+  struct blog_rec_s recs[BLOG_NRECORDS];
+};
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+static struct blog_s g_blog =
+{
+  .lock = SP_UNLOCKED,
+  .sem  = SEM_INITIALIZER(0),
+};
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: blog_spec
+ *
+ * Description:
+ *   Parse the conversion specification at 'fmt', just past the '%'.
+ *   Return the type of its argument and, in 'end', the character after
+ *   it.  'nstar' receives the number of '*' widths and precisions and
+ *   'prec' the precision, or BLOG_PREC_NONE or BLOG_PREC_STAR.
+ *
+ ****************************************************************************/
+
+static int blog_spec(FAR const char *fmt, FAR const char **end,
+                     FAR int *nstar, FAR int *prec)
+{
+  int lmod = 0;
+  int type;
+
+  *nstar = 0;
+  *prec  = BLOG_PREC_NONE;
+
+  fmt += strspn(fmt, "-+ #0'");
+
+  if (*fmt == '*')
+    {
+      (*nstar)++;
+      fmt++;
+    }
+
+  fmt += strspn(fmt, "0123456789");
+
+  if (*fmt == '.')
+    {
+      fmt++;
+      if (*fmt == '*')
+        {
+          (*nstar)++;
+          *prec = BLOG_PREC_STAR;
+          fmt++;
+        }
+      else
+        {
+          *prec = atoi(fmt);
+          fmt += strspn(fmt, "0123456789");
+        }
+    }
+
+  switch (*fmt)
+    {
+      case 'h':
+        fmt += fmt[1] == 'h' ? 2 : 1;
+        break;
+
+      case 'l':
+        lmod = fmt[1] == 'l' ? BLOG_LLONG : BLOG_LONG;
+        fmt += fmt[1] == 'l' ? 2 : 1;
+        break;
+
+      case 'z':
+        lmod = BLOG_SIZE;
+        fmt++;
+        break;
+
+      case 'j':
+        lmod = BLOG_INTMAX;
+        fmt++;
+        break;
+
+      case 't':
+        lmod = BLOG_PTRDIFF;
+        fmt++;
+        break;
+
+      case 'L':
+        fmt++;
+        break;
+    }
+
+  switch (*fmt)
+    {
+      case 'd':
+      case 'i':
+      case 'u':
+      case 'o':
+      case 'x':
+      case 'X':
+        type = lmod != 0 ? lmod : BLOG_INT;
+        break;
+
+      case 'c':
+        type = BLOG_INT;
+        break;
+
+      case 'p':
+        type = BLOG_PTR;
+        break;
+
+      case 's':
+        type = BLOG_STRING;
+        break;
+
+      case 'e':
+      case 'E':
+      case 'f':
+      case 'F':
+      case 'g':
+      case 'G':
+      case 'a':
+      case 'A':
+        type = BLOG_DOUBLE;
+        break;
+
+      default:
+        type = BLOG_NONE;
+        break;
+    }
+
+  *end = *fmt != '\0' ? fmt + 1 : fmt;
+  return type;
+}
+
+/****************************************************************************
+ * Name: blog_put
+ ****************************************************************************/
+
+static bool blog_put(FAR struct blog_rec_s *rec, FAR const void *value,
+                     size_t size)
+{
+  if (rec->datalen + size > BLOG_DATASIZE)
+    {
+      return false;
+    }
+
+  memcpy(&rec->data[rec->datalen], value, size);
+  rec->datalen += size;
+  return true;
+}
+
+/****************************************************************************
+ * Name: blog_pack
+ *
+ * Description:
+ *   Copy the arguments of 'fmt' into 'rec'.  Strings are truncated to what
+ *   fits, arguments that do not fit at all are printed as missing.
+ *
+ ****************************************************************************/
+
+static void blog_pack(FAR struct blog_rec_s *rec, FAR const char *fmt,
+                      va_list ap)
+{
+  FAR const char *str;
+  size_t len;
+  union
+    {
+      int i;
+      long l;
+      long long ll;
+      size_t z;
+      intmax_t j;
+      ptrdiff_t t;
+      FAR void *p;
+      double d;
+    } value;
+  int nstar;
+  int prec;
+  int type;
+  size_t size;
+
+  while ((fmt = strchr(fmt, '%')) != NULL)
+    {
+      type = blog_spec(fmt + 1, &fmt, &nstar, &prec);
+
+      while (nstar-- > 0)
+        {
+          value.i = va_arg(ap, int);
+          blog_put(rec, &value.i, sizeof(int));
+        }
+
+      /* A '*' precision is the last '*' argument, negative means none */
+
+      if (prec == BLOG_PREC_STAR)
+        {
+          prec = value.i;
+        }
+
+      switch (type)
+        {
+          case BLOG_INT:
+            value.i = va_arg(ap, int);
+            size = sizeof(int);
+            break;
+
+          case BLOG_LONG:
+            value.l = va_arg(ap, long);
+            size = sizeof(long);
+            break;
+
+          case BLOG_LLONG:
+            value.ll = va_arg(ap, long long);
+            size = sizeof(long long);
+            break;
+
+          case BLOG_SIZE:
+            value.z = va_arg(ap, size_t);
+            size = sizeof(size_t);
+            break;
+
+          case BLOG_INTMAX:
+            value.j = va_arg(ap, intmax_t);
+            size = sizeof(intmax_t);
+            break;
+
+          case BLOG_PTRDIFF:
+            value.t = va_arg(ap, ptrdiff_t);
+            size = sizeof(ptrdiff_t);
+            break;
+
+          case BLOG_PTR:
+            value.p = va_arg(ap, FAR void *);
+            size = sizeof(FAR void *);
+            break;
+
+          case BLOG_DOUBLE:
+            value.d = va_arg(ap, double);
+            size = sizeof(double);
+            break;
+
+          case BLOG_STRING:
+            str = va_arg(ap, FAR const char *);
+            if (str == NULL)
+              {
+                str = "(null)";
+              }
+
+            /* Read no further than the precision, the string need not
+             * be terminated before it, nor than the space left.
+             */
+
+            if (rec->datalen < BLOG_DATASIZE)
+              {
+                len = BLOG_DATASIZE - rec->datalen - 1;
+                if (prec >= 0 && (size_t)prec < len)
+                  {
+                    len = prec;
+                  }
+
+                len = strnlen(str, len);
+                memcpy(&rec->data[rec->datalen], str, len);
+                rec->data[rec->datalen + len] = '\0';
+                rec->datalen += len + 1;
+              }
+
+            continue;
+
+          default:
+            continue;
+        }
+
+      blog_put(rec, &value, size);
+    }
+}
+
+/****************************************************************************
+ * Name: blog_get
+ ****************************************************************************/
+
+static bool blog_get(FAR const struct blog_rec_s *rec, FAR size_t *pos,
+                     FAR void *value, size_t size)
+{
+  if (*pos + size > rec->datalen)
+    {
+      return false;
+    }
+
+  memcpy(value, &rec->data[*pos], size);
+  *pos += size;
+  return true;
+}
+
+/****************************************************************************
+ * Name: blog_format
+ *
+ * Description:
+ *   Print 'rec' into 'line', one conversion specification at a time.
+ *   '*' widths and precisions are written into the specification.
+ *
+ ****************************************************************************/
+
+static void blog_format(FAR const struct blog_rec_s *rec, FAR char *line,
+                        size_t size)
+{
+  FAR const char *fmt = rec->fmt;
+  FAR const char *spec;
+  FAR const char *end;
+  char buf[BLOG_SPECLEN];
+  size_t pos = 0;
+  size_t len = 0;
+  size_t n;
+  union
+    {
+      int i;
+      long l;
+      long long ll;
+      size_t z;
+      intmax_t j;
+      ptrdiff_t t;
+      FAR void *p;
+      double d;
+    } value;
+  int nstar;
+  int prec;
+  int type;
+  int star;
+  bool ok;
+
+  while (*fmt != '\0' && len < size - 1)
+    {
+      spec = strchr(fmt, '%');
+      if (spec == NULL)
+        {
+          spec = fmt + strlen(fmt);
+        }
+
+      /* Literal text up to the next specification */
+
+      n = MIN((size_t)(spec - fmt), size - 1 - len);
+      memcpy(&line[len], fmt, n);
+      len += n;
+
+      if (*spec == '\0')
+        {
+          break;
+        }
+
+      type = blog_spec(spec + 1, &end, &nstar, &prec);
+      fmt  = end;
+
+      if (type == BLOG_NONE)
+        {
+          if (end[-1] == '%')
+            {
+              line[len++] = '%';
+            }
+
+          continue;
+        }
+
+      /* Copy the specification, replacing each '*' with its value */
+
+      for (n = 0; spec < end && n < sizeof(buf) - 12; spec++)
+        {
+          if (*spec == '*')
+            {
+              star = 0;
+              blog_get(rec, &pos, &star, sizeof(int));
+              n += snprintf(&buf[n], sizeof(buf) - n, "%d", star);
+            }
+          else
+            {
+              buf[n++] = *spec;
+            }
+        }
+
+      buf[n] = '\0';
+
+      switch (type)
+        {
+          case BLOG_INT:
+            ok = blog_get(rec, &pos, &value.i, sizeof(int));
+            n  = ok ? snprintf(&line[len], size - len, buf, value.i) : 0;
+            break;
+
+          case BLOG_LONG:
+            ok = blog_get(rec, &pos, &value.l, sizeof(long));
+            n  = ok ? snprintf(&line[len], size - len, buf, value.l) : 0;
+            break;
+
+          case BLOG_LLONG:
+            ok = blog_get(rec, &pos, &value.ll, sizeof(long long));
+            n  = ok ? snprintf(&line[len], size - len, buf, value.ll) : 0;
+            break;
+
+          case BLOG_SIZE:
+            ok = blog_get(rec, &pos, &value.z, sizeof(size_t));
+            n  = ok ? snprintf(&line[len], size - len, buf, value.z) : 0;
+            break;
+
+          case BLOG_INTMAX:
+            ok = blog_get(rec, &pos, &value.j, sizeof(intmax_t));
+            n  = ok ? snprintf(&line[len], size - len, buf, value.j) : 0;
+            break;
+
+          case BLOG_PTRDIFF:
+            ok = blog_get(rec, &pos, &value.t, sizeof(ptrdiff_t));
+            n  = ok ? snprintf(&line[len], size - len, buf, value.t) : 0;
+            break;
+
+          case BLOG_PTR:
+            ok = blog_get(rec, &pos, &value.p, sizeof(FAR void *));
+            n  = ok ? snprintf(&line[len], size - len, buf, value.p) : 0;
+            break;
+
+          case BLOG_DOUBLE:
+            ok = blog_get(rec, &pos, &value.d, sizeof(double));
+            n  = ok ? snprintf(&line[len], size - len, buf, value.d) : 0;
+            break;
+
+          case BLOG_STRING:
+            ok = pos < rec->datalen;
+            if (ok)
+              {
+                n    = snprintf(&line[len], size - len, buf,
+                                (FAR const char *)&rec->data[pos]);
+                pos += strlen((FAR const char *)&rec->data[pos]) + 1;
+              }
+            break;
+
+          default:
+            ok = false;
+            break;
+        }
+
+      if (!ok)
+        {
+          n = snprintf(&line[len], size - len, "<?>");
+        }
+
+      len = MIN(len + n, size - 1);
+    }
+
+  line[len] = '\0';
+}
+
+/****************************************************************************
+ * Name: blog_thread
+ *
+ * Description:
+ *   Format and print the records at low priority.
+ *
+ ****************************************************************************/
+
+static int blog_thread(int argc, FAR char *argv[])
+{
+  FAR struct blog_s *blog = &g_blog;
+  struct blog_rec_s rec;
+  char line[BLOG_LINELEN];
+  irqstate_t flags;
+  uint32_t ndropped;
+  uint32_t ms;
+
+  for (; ; )
+    {
+      nxsem_wait_uninterruptible(&blog->sem);
+
+      for (; ; )
+        {
+          flags = spin_lock_irqsave(&blog->lock);
+
+          if (blog->tail == blog->head)
+            {
+              spin_unlock_irqrestore(&blog->lock, flags);
+              break;
+            }
+
+          rec = blog->recs[blog->tail % BLOG_NRECORDS];
+          blog->tail++;
+
+          ndropped       = blog->ndropped;
+          blog->ndropped = 0;
+
+          spin_unlock_irqrestore(&blog->lock, flags);
+
+          if (ndropped > 0)
+            {
+              syslog(LOG_WARNING, "WARNING: %" PRIu32 " log records lost\n",
+                     ndropped);
+            }
+
+          /* Messages keep the time they were logged at */
+
+          ms = TICK2MSEC(rec.time);
+          blog_format(&rec, line, sizeof(line));
+          syslog(rec.priority, "[%5" PRIu32 ".%03" PRIu32 "] %s",
+                 ms / 1000, ms % 1000, line);
+        }
+    }
+
+  return OK;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: esp32_blog_initialize
+ *
+ * Description:
+ *   Start the formatter thread.  Records logged before are kept until it
+ *   runs, as many as the ring holds.
+ *
+ ****************************************************************************/
+
+int esp32_blog_initialize(void)
+{
+  int pid;
+
+  pid = kthread_create("blog", CONFIG_BOARD_ESP32_BLOG_PRIORITY,
+                       CONFIG_BOARD_ESP32_BLOG_STACKSIZE,
+                       blog_thread, NULL);
+  if (pid < 0)
+    {
+      return pid;
+    }
+
+  nxsem_post(&g_blog.sem);
+  return OK;
+}
+
+/****************************************************************************
+ * Name: esp32_blog
+ *
+ * Description:
+ *   Replaces syslog() in the board sources.  Only the format pointer and
+ *   the arguments are recorded, the formatter thread prints the message
+ *   later.  The format must stay valid, as string literals do; strings
+ *   passed with %s are copied.  Callable from interrupt handlers.
+ *
+ ****************************************************************************/
+
+int esp32_blog(int priority, FAR const IPTR char *fmt, ...)
+{
+  FAR struct blog_s *blog = &g_blog;
+  FAR struct blog_rec_s *rec;
+  irqstate_t flags;
+  va_list ap;
+  bool wake;
+
+  flags = spin_lock_irqsave(&blog->lock);
+
+  if (blog->head - blog->tail >= BLOG_NRECORDS)
+    {
+      blog->ndropped++;
+      spin_unlock_irqrestore(&blog->lock, flags);
+      return -ENOSPC;
+    }
+
+  rec           = &blog->recs[blog->head % BLOG_NRECORDS];
+  rec->fmt      = fmt;
+  rec->time     = clock_systime_ticks();
+  rec->priority = priority;
+  rec->datalen  = 0;
+
+  va_start(ap, fmt);
+  blog_pack(rec, fmt, ap);
+  va_end(ap);
+
+  wake = blog->head == blog->tail;
+  blog->head++;
+
+  spin_unlock_irqrestore(&blog->lock, flags);
+
+  if (wake)
+    {
+      nxsem_post(&blog->sem);
+    }
+
+  return OK;
+}
+
+#endif /* CONFIG_BOARD_ESP32_BLOG */
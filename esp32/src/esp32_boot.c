@@ -27,9 +27,7 @@
 #include <debug.h>
 
 #include <nuttx/board.h>
-#include <nuttx/mm/mm.h>
 #include <arch/board/board.h>
-#include <arch/esp32/memory_layout.h>
 
 #include "esp32-devkitc.h"
 
@@ -58,6 +56,13 @@
 
 void esp32_board_initialize(void)
 {
+#ifdef CONFIG_BOARD_ESP32_BOOTPROF
+  esp32_bootprof_mark(BOOTPROF_BOARD_INIT);
+#endif
+
+#ifdef CONFIG_BOARD_ESP32_WARMBOOT
+  esp32_warmboot_initialize();
+#endif
 }
 
 /****************************************************************************
@@ -77,20 +82,12 @@ void esp32_board_initialize(void)
 #ifdef CONFIG_BOARD_LATE_INITIALIZE
 void board_late_initialize(void)
 {
+#ifdef CONFIG_BOARD_ESP32_BOOTPROF
+  esp32_bootprof_mark(BOOTPROF_LATE_INIT);
+#endif
+
   /* Perform board-specific initialization */
 
   esp32_bringup();
-
-#ifdef CONFIG_SMP
-  /* To avoid corrupting the heap, this region of memory (~3KB) is not
-   * included until the APP CPU has started.
-   * So we can't add it with the rest of the regions at xtensa_add_region(),
-   * that function is called early from up_initialize().  We wait until the
-   * SMP bringup is complete.
-   */
-
-  umm_addregion((void *)HEAP_REGION_ROMAPP_START,
-                (size_t)(HEAP_REGION_ROMAPP_END - HEAP_REGION_ROMAPP_START));
-#endif
 }
 #endif
@@ -0,0 +1,414 @@
+/****************************************************************************
+ * boards/xtensa/esp32/esp32-devkitc/src/esp32_bootprof.c
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <inttypes.h>
+#include <malloc.h>
+#include <string.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <debug.h>
+
+#include <nuttx/arch.h>
+#include <nuttx/irq.h>
+#include <nuttx/kmalloc.h>
+#include <nuttx/fs/fs.h>
+#include <nuttx/fs/procfs.h>
+#include <nuttx/spinlock.h>
+
+#include "esp32-devkitc.h"
+
+#ifdef CONFIG_BOARD_ESP32_BOOTPROF
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define BOOTPROF_NSTEPS   32
+#define BOOTPROF_LINELEN  64
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+struct bootprof_step_s
+{
+  FAR const char *name;
+  clock_t  start;      /* Cycle counter when the step started */
+  clock_t  end;        /* Cycle counter when the step returned */
+  ssize_t  heapdelta;  /* Change of the allocated heap bytes */
+  int      ret;        /* Value returned by the step */
+  uint8_t  cpu;        /* CPU that started the step */
+  bool     migrated;   /* Step finished on another CPU */
+};
+
+struct bootprof_file_s
+{
+  struct procfs_file_s base;       /* Base open file structure */
+  char line[BOOTPROF_LINELEN];     /* Pre-allocated buffer for lines */
+};
+
+/****************************************************************************
+ * Private Function Prototypes
+ ****************************************************************************/
+
+static int     bootprof_open(FAR struct file *filep,
+                             FAR const char *relpath, int oflags,
+                             mode_t mode);
+static int     bootprof_close(FAR struct file *filep);
+static ssize_t bootprof_read(FAR struct file *filep, FAR char *buffer,
+                             size_t buflen);
+static int     bootprof_dup(FAR const struct file *oldp,
+                            FAR struct file *newp);
+static int     bootprof_stat(FAR const char *relpath, FAR struct stat *buf);
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+static FAR const char * const g_bootprof_marknames[BOOTPROF_NMARKS] =
+{
+  "board_initialize",
+  "late_initialize",
+  "bringup_done",
+  "nsh_start",
+};
+
+static clock_t g_bootprof_marks[BOOTPROF_NMARKS];
+static struct bootprof_step_s g_bootprof_steps[BOOTPROF_NSTEPS];
+static int g_bootprof_nsteps;
+static spinlock_t g_bootprof_lock = SP_UNLOCKED;
+
+static const struct procfs_operations g_bootprof_operations =
+{
+  .open  = bootprof_open,
+  .close = bootprof_close,
+  .read  = bootprof_read,
+  .dup   = bootprof_dup,
+  .stat  = bootprof_stat,
+};
+
+static const struct procfs_entry_s g_bootprof_entry =
+{
+  "boardinit", &g_bootprof_operations, PROCFS_FILE_TYPE
+};
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: bootprof_usec
+ *
+ * Description:
+ *   Convert a cycle count into microseconds.
+ *
+ ****************************************************************************/
+
+static uint32_t bootprof_usec(clock_t cycles)
+{
+  struct timespec ts;
+
+  up_perf_convert(cycles, &ts);
+  return ts.tv_sec * USEC_PER_SEC + ts.tv_nsec / NSEC_PER_USEC;
+}
+
+/****************************************************************************
+ * Name: bootprof_heapused
+ ****************************************************************************/
+
+static size_t bootprof_heapused(void)
+{
+  struct mallinfo info = mallinfo();
+
+  return info.uordblks;
+}
+
+/****************************************************************************
+ * Name: bootprof_open
+ ****************************************************************************/
+
+static int bootprof_open(FAR struct file *filep, FAR const char *relpath,
+                         int oflags, mode_t mode)
+{
+  FAR struct bootprof_file_s *priv;
+
+  /* This is a read-only file */
+
+  if ((oflags & O_WRONLY) != 0 || (oflags & O_RDONLY) == 0)
+    {
+      return -EACCES;
+    }
+
+  priv = kmm_zalloc(sizeof(struct bootprof_file_s));
+  if (priv == NULL)
+    {
+      return -ENOMEM;
+    }
+
+  filep->f_priv = priv;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: bootprof_close
+ ****************************************************************************/
+
+static int bootprof_close(FAR struct file *filep)
+{
+  kmm_free(filep->f_priv);
+  filep->f_priv = NULL;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: bootprof_read
+ ****************************************************************************/
+
+static ssize_t bootprof_read(FAR struct file *filep, FAR char *buffer,
+                             size_t buflen)
+{
+  FAR struct bootprof_file_s *priv = filep->f_priv;
+  FAR struct bootprof_step_s *step;
+  off_t offset = filep->f_pos;
+  size_t totalsize = 0;
+  size_t linesize;
+  size_t copysize;
+  int nsteps;
+  int i;
+
+  DEBUGASSERT(priv != NULL);
+
+  linesize = procfs_snprintf(priv->line, BOOTPROF_LINELEN,
+                             "%-20s %10s\n", "MARK", "TIME(us)");
+  copysize = procfs_memcpy(priv->line, linesize, buffer, buflen, &offset);
+  totalsize += copysize;
+
+  /* Timestamps are relative to the reset of CPU0, which is when its cycle
+   * counter started.
+   */
+
+  for (i = 0; i < BOOTPROF_NMARKS && totalsize < buflen; i++)
+    {
+      if (g_bootprof_marks[i] == 0)
+        {
+          continue;
+        }
+
+      linesize = procfs_snprintf(priv->line, BOOTPROF_LINELEN,
+                                 "%-20s %10" PRIu32 "\n",
+                                 g_bootprof_marknames[i],
+                                 bootprof_usec(g_bootprof_marks[i]));
+      copysize = procfs_memcpy(priv->line, linesize, buffer + totalsize,
+                               buflen - totalsize, &offset);
+      totalsize += copysize;
+    }
+
+  if (totalsize < buflen)
+    {
+      linesize = procfs_snprintf(priv->line, BOOTPROF_LINELEN,
+                                 "\n%-16s %3s %10s %8s %5s %8s\n",
+                                 "STEP", "CPU", "START(us)", "TIME(us)",
+                                 "RET", "HEAP");
+      copysize = procfs_memcpy(priv->line, linesize, buffer + totalsize,
+                               buflen - totalsize, &offset);
+      totalsize += copysize;
+    }
+
+  nsteps = g_bootprof_nsteps;
+
+  for (i = 0; i < nsteps && totalsize < buflen; i++)
+    {
+      step = &g_bootprof_steps[i];
+      if (step->end == 0)
+        {
+          /* Still running in the background */
+
+          linesize = procfs_snprintf(priv->line, BOOTPROF_LINELEN,
+                                     "%-16.16s %3u %10" PRIu32 " %8s\n",
+                                     step->name, step->cpu,
+                                     bootprof_usec(step->start), "-");
+        }
+      else
+        {
+          /* Durations of steps that moved to another CPU mix two cycle
+           * counters and are flagged with a '*'.
+           */
+
+          linesize = procfs_snprintf(priv->line, BOOTPROF_LINELEN,
+                                     "%-16.16s %3u %10" PRIu32
+                                     " %7" PRIu32 "%c %5d %+8zd\n",
+                                     step->name, step->cpu,
+                                     bootprof_usec(step->start),
+                                     bootprof_usec(step->end - step->start),
+                                     step->migrated ? '*' : ' ',
+                                     step->ret, step->heapdelta);
+        }
+
+      copysize = procfs_memcpy(priv->line, linesize, buffer + totalsize,
+                               buflen - totalsize, &offset);
+      totalsize += copysize;
+    }
+
+  filep->f_pos += totalsize;
+  return totalsize;
+}
+
+/****************************************************************************
+ * Name: bootprof_dup
+ ****************************************************************************/
+
+static int bootprof_dup(FAR const struct file *oldp, FAR struct file *newp)
+{
+  FAR struct bootprof_file_s *newpriv;
+
+  newpriv = kmm_zalloc(sizeof(struct bootprof_file_s));
+  if (newpriv == NULL)
+    {
+      return -ENOMEM;
+    }
+
+  memcpy(newpriv, oldp->f_priv, sizeof(struct bootprof_file_s));
+  newp->f_priv = newpriv;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: bootprof_stat
+ ****************************************************************************/
+
+static int bootprof_stat(FAR const char *relpath, FAR struct stat *buf)
+{
+  memset(buf, 0, sizeof(struct stat));
+  buf->st_mode = S_IFREG | S_IROTH | S_IRGRP | S_IRUSR;
+  return OK;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: esp32_bootprof_mark
+ *
+ * Description:
+ *   Record the time at which a boot phase was reached.  Safe to call
+ *   before the heap or the scheduler are up.
+ *
+ ****************************************************************************/
+
+void esp32_bootprof_mark(int mark)
+{
+  DEBUGASSERT(mark >= 0 && mark < BOOTPROF_NMARKS);
+
+  if (g_bootprof_marks[mark] == 0)
+    {
+      g_bootprof_marks[mark] = up_perf_gettime();
+    }
+}
+
+/****************************************************************************
+ * Name: esp32_bootprof_begin
+ *
+ * Description:
+ *   Start timing a bringup step.
+ *
+ * Returned Value:
+ *   A handle to pass to esp32_bootprof_end(), or a negated errno value if
+ *   no more steps can be recorded.
+ *
+ ****************************************************************************/
+
+int esp32_bootprof_begin(FAR const char *name)
+{
+  FAR struct bootprof_step_s *step;
+  irqstate_t flags;
+  int handle;
+
+  flags = spin_lock_irqsave(&g_bootprof_lock);
+  handle = g_bootprof_nsteps;
+  if (handle < BOOTPROF_NSTEPS)
+    {
+      g_bootprof_nsteps++;
+    }
+
+  spin_unlock_irqrestore(&g_bootprof_lock, flags);
+
+  if (handle >= BOOTPROF_NSTEPS)
+    {
+      return -ENOSPC;
+    }
+
+  step            = &g_bootprof_steps[handle];
+  step->name      = name;
+  step->cpu       = up_cpu_index();
+  step->heapdelta = bootprof_heapused();
+  step->start     = up_perf_gettime();
+  return handle;
+}
+
+/****************************************************************************
+ * Name: esp32_bootprof_end
+ *
+ * Description:
+ *   Stop timing a bringup step and record its result.  With concurrent
+ *   steps the heap delta includes the allocations of the steps running
+ *   at the same time.
+ *
+ ****************************************************************************/
+
+void esp32_bootprof_end(int handle, int ret)
+{
+  FAR struct bootprof_step_s *step;
+  clock_t end = up_perf_gettime();
+
+  if (handle < 0 || handle >= BOOTPROF_NSTEPS)
+    {
+      return;
+    }
+
+  step            = &g_bootprof_steps[handle];
+  step->migrated  = step->cpu != up_cpu_index();
+  step->ret       = ret;
+  step->heapdelta = (ssize_t)bootprof_heapused() - step->heapdelta;
+  step->end       = end;
+}
+
+/****************************************************************************
+ * Name: esp32_bootprof_initialize
+ *
+ * Description:
+ *   Register /proc/boardinit.
+ *
+ ****************************************************************************/
+
+int esp32_bootprof_initialize(void)
+{
+  return procfs_register(&g_bootprof_entry);
+}
+
+#endif /* CONFIG_BOARD_ESP32_BOOTPROF */
@@ -142,7 +142,7 @@
 #  include "esp32_rtc_lowerhalf.h"
 #endif
 
-#ifdef CONFIG_SPI_DRIVER
+#if defined(CONFIG_SPI_DRIVER) || defined(CONFIG_BOARD_ESP32_SPIARB)
 #  include "esp32_spi.h"
 #endif
 
@@ -159,99 +159,326 @@
 #include "esp32_i2c.h"
 
 /****************************************************************************
- * Public Functions
+ * Pre-processor Definitions
  ****************************************************************************/
 
+#define STEP(n)  INITSTEP_BIT(n)
+
 /****************************************************************************
- * Name: esp32_bringup
- *
- * Description:
- *   Perform architecture-specific initialization
- *
- *   CONFIG_BOARD_LATE_INITIALIZE=y :
- *     Called from board_late_initialize().
- *
- *   CONFIG_BOARD_LATE_INITIALIZE=n && CONFIG_BOARDCTL=y :
- *     Called from the NSH library
- *
+ * Private Types
  ****************************************************************************/
 
-int esp32_bringup(void)
+/* Bringup steps, in dependency order */
+
+enum esp32_step_e
 {
-  int ret;
-  struct mpu_config_s mpu;
+  STEP_BLOG = 0,
+  STEP_RT_TIMER,
+  STEP_BTRACE,
+  STEP_PCOUNT,
+  STEP_AES,
+  STEP_PROCFS,
+  STEP_TMPFS,
+  STEP_MMCSD,
+  STEP_RTC,
+  STEP_TWAI,
+  STEP_CANUDP,
+  STEP_I2C0,
+  STEP_LCD,
+  STEP_IMU,
+  STEP_AMB,
+  STEP_HEAPMON,
+  STEP_IRQROUTE,
+  STEP_STKMON,
+  STEP_CRASHDUMP,
+  STEP_HRTIME,
+  STEP_RTCSYNC,
+  STEP_SAMPLER,
+  STEP_DELAY,
+  STEP_JITTER,
+  STEP_NSTEPS
+};
 
+/****************************************************************************
+ * Private Function Prototypes
+ ****************************************************************************/
+
+#ifdef CONFIG_FS_PROCFS
+static int esp32_init_procfs(void);
+#endif
+#ifdef CONFIG_FS_TMPFS
+static int esp32_init_tmpfs(void);
+#endif
+#ifdef CONFIG_MMCSD
+static int esp32_init_mmcsd(void);
+#endif
+static int esp32_init_i2c0(void);
+static int esp32_init_lcd(void);
+static int esp32_init_imu(void);
+static int esp32_init_amb(void);
+static int esp32_register_lcd(void);
+static int esp32_register_imu(void);
+static int esp32_register_amb(void);
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+static struct i2c_master_s *g_i2c0;
+
+static const struct esp32_initstep_s g_bringup_steps[STEP_NSTEPS] =
+{
+#ifdef CONFIG_BOARD_ESP32_BLOG
+  [STEP_BLOG]     = { "deferred log", esp32_blog_initialize, 0, 0 },
+#endif
+#ifdef CONFIG_ESP32_RT_TIMER
+  [STEP_RT_TIMER] = { "RT timer", esp32_rt_timer_init, 0, 0 },
+#endif
+#ifdef CONFIG_BOARD_ESP32_BTRACE
+  [STEP_BTRACE]   =
+  {
+    "tracer", esp32_btrace_initialize, STEP(STEP_RT_TIMER), 0
+  },
+#endif
+#ifdef CONFIG_BOARD_ESP32_PCOUNT
+  [STEP_PCOUNT]   =
+  {
+    "driver counters", esp32_pcount_initialize, STEP(STEP_RT_TIMER), 0
+  },
+#endif
 #ifdef CONFIG_ESP32_AES_ACCELERATOR
-  ret = esp32_aes_init();
-  if (ret < 0)
-    {
-      syslog(LOG_ERR,
-             "ERROR: Failed to initialize AES: %d\n", ret);
-    }
+  [STEP_AES]      = { "AES", esp32_aes_init, 0, 0 },
+#endif
+#ifdef CONFIG_FS_PROCFS
+  [STEP_PROCFS]   = { "procfs", esp32_init_procfs, 0, 0 },
+#endif
+#ifdef CONFIG_FS_TMPFS
+  [STEP_TMPFS]    = { "tmpfs", esp32_init_tmpfs, 0, 0 },
+#endif
+#ifdef CONFIG_MMCSD
+  [STEP_MMCSD]    = { "SD slot", esp32_init_mmcsd, 0, INITSTEP_BACKGROUND },
 #endif
+#ifdef CONFIG_RTC_DRIVER
+  [STEP_RTC]      = { "RTC driver", esp32_rtc_driverinit, 0, 0 },
+#endif
+#ifdef CONFIG_ESP32_TWAI
+  [STEP_TWAI]     = { "TWAI", esp32_twai_setup, 0, 0 },
+#endif
+#ifdef CONFIG_BOARD_ESP32_CANUDP
+  [STEP_CANUDP]   =
+  {
+    "CAN gateway", esp32_canudp_initialize, STEP(STEP_TWAI),
+    INITSTEP_BACKGROUND
+  },
+#endif
+  [STEP_I2C0]     = { "I2C0", esp32_init_i2c0, 0, 0 },
+  [STEP_LCD]      = { "LCD", esp32_register_lcd, 0, INITSTEP_BACKGROUND },
+  [STEP_IMU]      =
+  {
+    "IMU", esp32_register_imu, STEP(STEP_I2C0),
+    INITSTEP_BACKGROUND | INITSTEP_OPTIONAL
+  },
+  [STEP_AMB]      =
+  {
+    "light sensor", esp32_register_amb, STEP(STEP_I2C0),
+    INITSTEP_BACKGROUND | INITSTEP_OPTIONAL
+  },
+#ifdef CONFIG_BOARD_ESP32_HEAPMON
+  [STEP_HEAPMON]  = { "heap monitor", esp32_heapmon_initialize, 0, 0 },
+#endif
+#ifdef CONFIG_BOARD_ESP32_IRQROUTE
+  [STEP_IRQROUTE] = { "IRQ routing", esp32_irqroute_initialize, 0, 0 },
+#endif
+#ifdef CONFIG_BOARD_ESP32_STKMON
+  [STEP_STKMON]   = { "stack monitor", esp32_stkmon_initialize, 0, 0 },
+#endif
+#ifdef CONFIG_BOARD_ESP32_CRASHDUMP
+  [STEP_CRASHDUMP] = { "crash dump", esp32_crashdump_initialize, 0, 0 },
+#endif
+#ifdef CONFIG_BOARD_ESP32_HRTIME
+  [STEP_HRTIME]   =
+  {
+    "time page", esp32_hrtime_initialize, STEP(STEP_RT_TIMER) |
+    STEP(STEP_RTC), 0
+  },
+#endif
+#ifdef CONFIG_BOARD_ESP32_RTCSYNC
+  [STEP_RTCSYNC]  =
+  {
+    "RTC sync", esp32_rtcsync_initialize, STEP(STEP_RTC), 0
+  },
+#endif
+#ifdef CONFIG_BOARD_ESP32_SAMPLER
+  [STEP_SAMPLER]  =
+  {
+    "sampler", esp32_sampler_initialize, STEP(STEP_RT_TIMER), 0
+  },
+#endif
+#ifdef CONFIG_BOARD_ESP32_DELAY
+  [STEP_DELAY]    =
+  {
+    "delays", esp32_delay_initialize, STEP(STEP_RT_TIMER), 0
+  },
+#endif
+#ifdef CONFIG_BOARD_ESP32_AFFINITY_JITTER
+  [STEP_JITTER]   =
+  {
+    "jitter probes", esp32_affinity_initialize, STEP(STEP_RT_TIMER), 0
+  },
+#endif
+};
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
 
 #ifdef CONFIG_FS_PROCFS
+static int esp32_init_procfs(void)
+{
   /* Mount the procfs file system */
 
-  ret = nx_mount(NULL, "/proc", "procfs", 0, NULL);
-  if (ret < 0)
-    {
-      syslog(LOG_ERR, "ERROR: Failed to mount procfs at /proc: %d\n", ret);
-    }
+  return nx_mount(NULL, "/proc", "procfs", 0, NULL);
+}
 #endif
 
-
 #ifdef CONFIG_FS_TMPFS
+static int esp32_init_tmpfs(void)
+{
   /* Mount the tmpfs file system */
 
-  ret = nx_mount(NULL, CONFIG_LIBC_TMPDIR, "tmpfs", 0, NULL);
-  if (ret < 0)
-    {
-      syslog(LOG_ERR, "ERROR: Failed to mount tmpfs at %s: %d\n",
-             CONFIG_LIBC_TMPDIR, ret);
-    }
+  return nx_mount(NULL, CONFIG_LIBC_TMPDIR, "tmpfs", 0, NULL);
+}
 #endif
 
 #ifdef CONFIG_MMCSD
-  ret = esp32_mmcsd_initialize(0);
+static int esp32_init_mmcsd(void)
+{
+  return esp32_mmcsd_initialize(0);
+}
+#endif
+
+static int esp32_init_i2c0(void)
+{
+  g_i2c0 = esp32_i2cbus_initialize(0);
+  return g_i2c0 != NULL ? OK : -ENODEV;
+}
+
+static int esp32_init_lcd(void)
+{
+  int ret;
+
+#ifdef CONFIG_BOARD_ESP32_SPIARB
+  /* The W5500 shares the display bus */
+
+  ret = esp32_spiarb_install(esp32_spibus_initialize(DISPLAY_SPI));
   if (ret < 0)
     {
-      syslog(LOG_ERR, "Failed to initialize SD slot: %d\n", ret);
+      return ret;
     }
 #endif
 
-#ifdef CONFIG_ESP32_RT_TIMER
-  ret = esp32_rt_timer_init();
-  if (ret < 0)
+  ret = board_lcd_initialize();
+  if (ret >= 0)
     {
-      syslog(LOG_ERR, "Failed to initialize RT timer: %d\n", ret);
+      ret = lcddev_register(0);
     }
+
+  esp32_gpiowrite(DISPLAY_BCKL, false);
+  return ret;
+}
+
+static int esp32_init_imu(void)
+{
+  struct mpu_config_s mpu;
+
+  mpu.i2c  = g_i2c0;
+  mpu.addr = 0x68;
+
+  return mpu60x0_register("/dev/imu", &mpu);
+}
+
+static int esp32_init_amb(void)
+{
+  return bh1750fvi_register("/dev/amb", g_i2c0, 0x23);
+}
+
+/* With CONFIG_BOARD_ESP32_LAZYDEV the display and the sensors are only
+ * brought up when their device node is first opened.
+ */
+
+static int esp32_register_lcd(void)
+{
+#ifdef CONFIG_BOARD_ESP32_LAZYDEV
+  return esp32_lazydev_register("/dev/lcd0", esp32_init_lcd);
+#else
+  return esp32_init_lcd();
 #endif
+}
 
-#ifdef CONFIG_RTC_DRIVER
-  /* Instantiate the ESP32 RTC driver */
+static int esp32_register_imu(void)
+{
+#ifdef CONFIG_BOARD_ESP32_LAZYDEV
+  return esp32_lazydev_register("/dev/imu", esp32_init_imu);
+#else
+  return esp32_init_imu();
+#endif
+}
 
-  ret = esp32_rtc_driverinit();
-  if (ret < 0)
-    {
-      syslog(LOG_ERR,
-             "ERROR: Failed to Instantiate the RTC driver: %d\n", ret);
-    }
+static int esp32_register_amb(void)
+{
+#ifdef CONFIG_BOARD_ESP32_LAZYDEV
+  return esp32_lazydev_register("/dev/amb", esp32_init_amb);
+#else
+  return esp32_init_amb();
 #endif
+}
 
-  mpu.i2c = esp32_i2cbus_initialize(0);
-  mpu.addr = 0x68;
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: esp32_bringup
+ *
+ * Description:
+ *   Perform architecture-specific initialization
+ *
+ *   CONFIG_BOARD_LATE_INITIALIZE=y :
+ *     Called from board_late_initialize().
+ *
+ *   CONFIG_BOARD_LATE_INITIALIZE=n && CONFIG_BOARDCTL=y :
+ *     Called from the NSH library
+ *
+ ****************************************************************************/
 
-  board_lcd_initialize();
+int esp32_bringup(void)
+{
+  int ret;
 
-  lcddev_register(0);
+  /* Both callers run after nx_smp_start(), so the memory the APP CPU
+   * used to start can go to the heap before the bringup allocates.
+   */
 
-  esp32_gpiowrite(DISPLAY_BCKL, false);
+  esp32_reclaim();
 
-  mpu60x0_register("/dev/imu", &mpu);
+#ifdef CONFIG_BOARD_ESP32_BOOTPROF
+  ret = esp32_bootprof_initialize();
+  if (ret < 0)
+    {
+      syslog(LOG_ERR, "ERROR: Failed to register /proc/boardinit: %d\n",
+             ret);
+    }
+#endif
 
-  bh1750fvi_register("/dev/amb", mpu.i2c, 0x23);
+  ret = esp32_initsteps_run(g_bringup_steps, STEP_NSTEPS);
+
+#ifdef CONFIG_BOARD_ESP32_BOOTPROF
+  esp32_bootprof_mark(BOOTPROF_BRINGUP_DONE);
+#endif
+
+#ifdef CONFIG_BOARD_ESP32_AFFINITY
+  esp32_affinity_apply();
+#endif
 
-  UNUSED(ret);
-  return OK;
+  return ret;
 }
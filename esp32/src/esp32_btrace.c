@@ -0,0 +1,633 @@
+/****************************************************************************
+ * boards/xtensa/esp32/esp32-devkitc/src/esp32_btrace.c
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <sys/types.h>
+#include <sys/param.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <debug.h>
+
+#include <nuttx/arch.h>
+#include <nuttx/clock.h>
+#include <nuttx/irq.h>
+#include <nuttx/sched.h>
+#include <nuttx/kmalloc.h>
+#include <nuttx/spinlock.h>
+#include <nuttx/fs/fs.h>
+#include <nuttx/note/note_driver.h>
+
+#include "esp32_rt_timer.h"
+#include "esp32-devkitc.h"
+
+#ifdef CONFIG_BOARD_ESP32_BTRACE
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define BTRACE_NEVENTS   CONFIG_BOARD_ESP32_BTRACE_NEVENTS
+#define BTRACE_MASK      (BTRACE_NEVENTS - 1)
+#define BTRACE_LINELEN   192
+
+#if (BTRACE_NEVENTS & BTRACE_MASK) != 0
+#  error "CONFIG_BOARD_ESP32_BTRACE_NEVENTS must be a power of two"
+#endif
+
+#ifndef CONFIG_SMP_NCPUS
+#  define CONFIG_SMP_NCPUS 1
+#endif
+
+/* Event types */
+
+#define BTRACE_T_START      0   /* Task created, id: PID */
+#define BTRACE_T_STOP       1   /* Task exited, id: PID */
+#define BTRACE_T_SUSPEND    2   /* Task switched out, id: PID, arg: state */
+#define BTRACE_T_RESUME     3   /* Task switched in, id: PID */
+#define BTRACE_T_IRQENTER   4   /* Interrupt handler entered, id: IRQ */
+#define BTRACE_T_IRQLEAVE   5   /* Interrupt handler returned, id: IRQ */
+#define BTRACE_T_BEGIN      6   /* Board event started, id: BTRACE_* */
+#define BTRACE_T_END        7   /* Board event finished, id: BTRACE_* */
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+struct btrace_event_s
+{
+  uint64_t time;             /* RT timer, in microseconds */
+  uint32_t arg;              /* Type dependent argument */
+  int16_t  id;               /* PID, IRQ or BTRACE_* event */
+  uint8_t  type;             /* BTRACE_T_* */
+  uint8_t  prio;             /* Task priority */
+};
+
+/* Written only by the CPU that owns it, with its interrupts disabled */
+
+struct btrace_ring_s
+{
+  volatile uint32_t head;    /* Events written since boot */
+  volatile bool writing;     /* An event is being written */
+  struct btrace_event_s events[BTRACE_NEVENTS];
+};
+
+struct btrace_s
+{
+  volatile bool enabled;     /* Tracing is on */
+  mutex_t lock;              /* Serializes the readers */
+  struct note_driver_s driver;
+  struct btrace_ring_s rings[CONFIG_SMP_NCPUS];
+};
+
+/* State of the merge of the rings by one reader */
+
+struct btrace_file_s
+{
+  uint32_t pos[CONFIG_SMP_NCPUS];   /* Next event of each ring */
+  uint32_t end[CONFIG_SMP_NCPUS];   /* Head of each ring when opened */
+  pid_t    pid[CONFIG_SMP_NCPUS];   /* Task running on each CPU */
+  uint8_t  prio[CONFIG_SMP_NCPUS];  /* Its priority when switched out */
+  char     state[CONFIG_SMP_NCPUS]; /* Its state when switched out */
+  uint64_t base;                    /* Time of the first event */
+  bool     based;                   /* 'base' was set */
+  bool     header;                  /* The header was formatted */
+  size_t   linepos;                 /* Bytes of line already returned */
+  size_t   linelen;                 /* Bytes in line */
+  char     line[BTRACE_LINELEN];
+};
+
+/****************************************************************************
+ * Private Function Prototypes
+ ****************************************************************************/
+
+static void    btrace_note_start(FAR struct note_driver_s *drv,
+                                 FAR struct tcb_s *tcb);
+static void    btrace_note_stop(FAR struct note_driver_s *drv,
+                                FAR struct tcb_s *tcb);
+#ifdef CONFIG_SCHED_INSTRUMENTATION_SWITCH
+static void    btrace_note_suspend(FAR struct note_driver_s *drv,
+                                   FAR struct tcb_s *tcb);
+static void    btrace_note_resume(FAR struct note_driver_s *drv,
+                                  FAR struct tcb_s *tcb);
+#endif
+#ifdef CONFIG_SCHED_INSTRUMENTATION_IRQHANDLER
+static void    btrace_note_irqhandler(FAR struct note_driver_s *drv,
+                                      int irq, FAR void *handler,
+                                      bool enter);
+#endif
+
+static int     btrace_open(FAR struct file *filep);
+static int     btrace_close(FAR struct file *filep);
+static ssize_t btrace_read(FAR struct file *filep, FAR char *buffer,
+                           size_t buflen);
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+static const struct note_driver_ops_s g_btrace_noteops =
+{
+  .start      = btrace_note_start,
+  .stop       = btrace_note_stop,
+#ifdef CONFIG_SCHED_INSTRUMENTATION_SWITCH
+  .suspend    = btrace_note_suspend,
+  .resume     = btrace_note_resume,
+#endif
+#ifdef CONFIG_SCHED_INSTRUMENTATION_IRQHANDLER
+  .irqhandler = btrace_note_irqhandler,
+#endif
+};
+
+static struct btrace_s g_btrace =
+{
+  .lock   = NXMUTEX_INITIALIZER,
+  .driver =
+  {
+#ifdef CONFIG_SCHED_INSTRUMENTATION_FILTER
+    .name = "btrace",
+#endif
+    .ops  = &g_btrace_noteops,
+  },
+};
+
+static const struct file_operations g_btrace_fops =
+{
+  .open  = btrace_open,
+  .close = btrace_close,
+  .read  = btrace_read,
+};
+
+static FAR const char * const g_btrace_names[BTRACE_NIDS] =
+{
+  "spi",
+  "lcd",
+};
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: btrace_record
+ *
+ * Description:
+ *   Append an event to the ring of the calling CPU.  Only that CPU writes
+ *   the ring, so masking its interrupts is all the locking needed.
+ *
+ ****************************************************************************/
+
+static void btrace_record(int type, int id, int prio, uint32_t arg)
+{
+  FAR struct btrace_ring_s *ring;
+  FAR struct btrace_event_s *event;
+  irqstate_t flags;
+
+  flags = up_irq_save();
+
+  ring = &g_btrace.rings[up_cpu_index()];
+  ring->writing = true;
+  SP_DMB();
+
+  if (g_btrace.enabled)
+    {
+      event       = &ring->events[ring->head & BTRACE_MASK];
+      event->time = esp32_rt_timer_time_us();
+      event->arg  = arg;
+      event->id   = id;
+      event->type = type;
+      event->prio = prio;
+      ring->head++;
+    }
+
+  SP_DMB();
+  ring->writing = false;
+
+  up_irq_restore(flags);
+}
+
+/****************************************************************************
+ * Name: btrace_note_*
+ *
+ * Description:
+ *   Scheduler instrumentation callbacks.
+ *
+ ****************************************************************************/
+
+static void btrace_note_start(FAR struct note_driver_s *drv,
+                              FAR struct tcb_s *tcb)
+{
+  btrace_record(BTRACE_T_START, tcb->pid, tcb->sched_priority, 0);
+}
+
+static void btrace_note_stop(FAR struct note_driver_s *drv,
+                             FAR struct tcb_s *tcb)
+{
+  btrace_record(BTRACE_T_STOP, tcb->pid, tcb->sched_priority, 0);
+}
+
+#ifdef CONFIG_SCHED_INSTRUMENTATION_SWITCH
+static void btrace_note_suspend(FAR struct note_driver_s *drv,
+                                FAR struct tcb_s *tcb)
+{
+  btrace_record(BTRACE_T_SUSPEND, tcb->pid, tcb->sched_priority,
+                tcb->task_state);
+}
+
+static void btrace_note_resume(FAR struct note_driver_s *drv,
+                               FAR struct tcb_s *tcb)
+{
+  btrace_record(BTRACE_T_RESUME, tcb->pid, tcb->sched_priority, 0);
+}
+#endif
+
+#ifdef CONFIG_SCHED_INSTRUMENTATION_IRQHANDLER
+static void btrace_note_irqhandler(FAR struct note_driver_s *drv, int irq,
+                                   FAR void *handler, bool enter)
+{
+  btrace_record(enter ? BTRACE_T_IRQENTER : BTRACE_T_IRQLEAVE, irq, 0, 0);
+}
+#endif
+
+/****************************************************************************
+ * Name: btrace_comm
+ *
+ * Description:
+ *   Return the name of 'pid', or "<...>" as ftrace does once the task has
+ *   exited.
+ *
+ ****************************************************************************/
+
+static FAR const char *btrace_comm(pid_t pid)
+{
+#if CONFIG_TASK_NAME_SIZE > 0
+  FAR struct tcb_s *tcb;
+
+  tcb = nxsched_get_tcb(pid);
+  if (tcb != NULL && tcb->name[0] != '\0')
+    {
+      return tcb->name;
+    }
+#endif
+
+  return "<...>";
+}
+
+/****************************************************************************
+ * Name: btrace_next
+ *
+ * Description:
+ *   Return the CPU holding the oldest unread event, or -1 when every ring
+ *   has been read.
+ *
+ ****************************************************************************/
+
+static int btrace_next(FAR struct btrace_file_s *priv)
+{
+  FAR struct btrace_event_s *event;
+  FAR struct btrace_event_s *oldest = NULL;
+  int next = -1;
+  int cpu;
+
+  for (cpu = 0; cpu < CONFIG_SMP_NCPUS; cpu++)
+    {
+      if (priv->pos[cpu] == priv->end[cpu])
+        {
+          continue;
+        }
+
+      event = &g_btrace.rings[cpu].events[priv->pos[cpu] & BTRACE_MASK];
+      if (oldest == NULL || event->time < oldest->time)
+        {
+          oldest = event;
+          next   = cpu;
+        }
+    }
+
+  return next;
+}
+
+/****************************************************************************
+ * Name: btrace_format
+ *
+ * Description:
+ *   Format the next event as a line of ftrace text output, which trace-cmd,
+ *   Perfetto and the Chrome trace viewer import.  Returns the line length,
+ *   zero once every event has been formatted.
+ *
+ ****************************************************************************/
+
+static size_t btrace_format(FAR struct btrace_file_s *priv)
+{
+  FAR struct btrace_event_s *event;
+  FAR char *line = priv->line;
+  uint64_t elapsed;
+  size_t len;
+  pid_t pid;
+  int cpu;
+
+  if (!priv->header)
+    {
+      priv->header = true;
+      return snprintf(line, BTRACE_LINELEN,
+                      "# tracer: nop\n#\n"
+                      "#           TASK-PID   CPU#  TIMESTAMP  FUNCTION\n"
+                      "#              | |       |       |         |\n");
+    }
+
+  do
+    {
+      cpu = btrace_next(priv);
+      if (cpu < 0)
+        {
+          return 0;
+        }
+
+      event = &g_btrace.rings[cpu].events[priv->pos[cpu]++ & BTRACE_MASK];
+      if (!priv->based)
+        {
+          priv->base  = event->time;
+          priv->based = true;
+        }
+
+      /* Switches out are only remembered for the next switch in */
+
+      if (event->type == BTRACE_T_SUSPEND)
+        {
+          priv->pid[cpu]   = event->id;
+          priv->prio[cpu]  = event->prio;
+          priv->state[cpu] = event->arg == TSTATE_TASK_READYTORUN ?
+                             'R' : 'S';
+        }
+    }
+  while (event->type == BTRACE_T_SUSPEND);
+
+  elapsed = event->time - priv->base;
+
+  pid = priv->pid[cpu];
+  len = snprintf(line, BTRACE_LINELEN, "%16s-%-5d [%03d] .... %5u.%06u: ",
+                 btrace_comm(pid), pid, cpu,
+                 (unsigned int)(elapsed / USEC_PER_SEC),
+                 (unsigned int)(elapsed % USEC_PER_SEC));
+
+  switch (event->type)
+    {
+      case BTRACE_T_START:
+        len += snprintf(line + len, BTRACE_LINELEN - len,
+                        "sched_wakeup_new: comm=%s pid=%d prio=%u "
+                        "target_cpu=%03d\n",
+                        btrace_comm(event->id), event->id, event->prio, cpu);
+        break;
+
+      case BTRACE_T_STOP:
+        len += snprintf(line + len, BTRACE_LINELEN - len,
+                        "sched_process_exit: comm=%s pid=%d prio=%u\n",
+                        btrace_comm(event->id), event->id, event->prio);
+        break;
+
+      case BTRACE_T_RESUME:
+        len += snprintf(line + len, BTRACE_LINELEN - len,
+                        "sched_switch: prev_comm=%s prev_pid=%d "
+                        "prev_prio=%u prev_state=%c ==> next_comm=%s "
+                        "next_pid=%d next_prio=%u\n",
+                        btrace_comm(pid), pid, priv->prio[cpu],
+                        priv->state[cpu] != '\0' ? priv->state[cpu] : 'R',
+                        btrace_comm(event->id), event->id, event->prio);
+        priv->pid[cpu] = event->id;
+        break;
+
+      case BTRACE_T_IRQENTER:
+        len += snprintf(line + len, BTRACE_LINELEN - len,
+                        "irq_handler_entry: irq=%d name=%d\n",
+                        event->id, event->id);
+        break;
+
+      case BTRACE_T_IRQLEAVE:
+        len += snprintf(line + len, BTRACE_LINELEN - len,
+                        "irq_handler_exit: irq=%d ret=handled\n",
+                        event->id);
+        break;
+
+      case BTRACE_T_BEGIN:
+        len += snprintf(line + len, BTRACE_LINELEN - len,
+                        "tracing_mark_write: B|%d|%s %08" PRIx32 "\n",
+                        pid, g_btrace_names[event->id], event->arg);
+        break;
+
+      case BTRACE_T_END:
+        len += snprintf(line + len, BTRACE_LINELEN - len,
+                        "tracing_mark_write: E|%d\n", pid);
+        break;
+    }
+
+  return MIN(len, BTRACE_LINELEN - 1);
+}
+
+/****************************************************************************
+ * Name: btrace_open
+ *
+ * Description:
+ *   Stop tracing while the rings are read, so that the writers do not
+ *   overwrite the events being formatted.
+ *
+ ****************************************************************************/
+
+static int btrace_open(FAR struct file *filep)
+{
+  FAR struct btrace_file_s *priv;
+  FAR struct btrace_ring_s *ring;
+  int ret;
+  int cpu;
+
+  if ((filep->f_oflags & O_WRONLY) != 0)
+    {
+      return -EACCES;
+    }
+
+  priv = kmm_zalloc(sizeof(struct btrace_file_s));
+  if (priv == NULL)
+    {
+      return -ENOMEM;
+    }
+
+  ret = nxmutex_trylock(&g_btrace.lock);
+  if (ret < 0)
+    {
+      kmm_free(priv);
+      return -EBUSY;
+    }
+
+  g_btrace.enabled = false;
+
+  for (cpu = 0; cpu < CONFIG_SMP_NCPUS; cpu++)
+    {
+      ring = &g_btrace.rings[cpu];
+      while (ring->writing)
+        {
+        }
+
+      priv->end[cpu] = ring->head;
+      priv->pos[cpu] = ring->head > BTRACE_NEVENTS ?
+                       ring->head - BTRACE_NEVENTS : 0;
+    }
+
+  filep->f_priv = priv;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: btrace_close
+ *
+ * Description:
+ *   Empty the rings and resume tracing.
+ *
+ ****************************************************************************/
+
+static int btrace_close(FAR struct file *filep)
+{
+  int cpu;
+
+  for (cpu = 0; cpu < CONFIG_SMP_NCPUS; cpu++)
+    {
+      g_btrace.rings[cpu].head = 0;
+    }
+
+  g_btrace.enabled = true;
+  nxmutex_unlock(&g_btrace.lock);
+
+  kmm_free(filep->f_priv);
+  filep->f_priv = NULL;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: btrace_read
+ ****************************************************************************/
+
+static ssize_t btrace_read(FAR struct file *filep, FAR char *buffer,
+                           size_t buflen)
+{
+  FAR struct btrace_file_s *priv = filep->f_priv;
+  size_t totalsize = 0;
+  size_t copysize;
+
+  DEBUGASSERT(priv != NULL);
+
+  while (totalsize < buflen)
+    {
+      if (priv->linepos == priv->linelen)
+        {
+          priv->linepos = 0;
+          priv->linelen = btrace_format(priv);
+          if (priv->linelen == 0)
+            {
+              break;
+            }
+        }
+
+      copysize = MIN(priv->linelen - priv->linepos, buflen - totalsize);
+      memcpy(buffer + totalsize, priv->line + priv->linepos, copysize);
+      priv->linepos += copysize;
+      totalsize     += copysize;
+    }
+
+  filep->f_pos += totalsize;
+  return totalsize;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: esp32_btrace_initialize
+ *
+ * Description:
+ *   Start tracing and register /dev/btrace.
+ *
+ ****************************************************************************/
+
+int esp32_btrace_initialize(void)
+{
+  int ret;
+
+  g_btrace.enabled = true;
+
+  ret = note_driver_register(&g_btrace.driver);
+  if (ret < 0)
+    {
+      g_btrace.enabled = false;
+      return ret;
+    }
+
+  return register_driver("/dev/btrace", &g_btrace_fops, 0444, NULL);
+}
+
+/****************************************************************************
+ * Name: esp32_btrace_begin / esp32_btrace_end
+ *
+ * Description:
+ *   Mark the start and the end of the BTRACE_* board event 'id'.  'arg'
+ *   is shown next to the event name, such as the SPI device ID.  Callable
+ *   from interrupt handlers.
+ *
+ ****************************************************************************/
+
+void esp32_btrace_begin(int id, uint32_t arg)
+{
+  DEBUGASSERT(id >= 0 && id < BTRACE_NIDS);
+  btrace_record(BTRACE_T_BEGIN, id, 0, arg);
+}
+
+void esp32_btrace_end(int id, uint32_t arg)
+{
+  DEBUGASSERT(id >= 0 && id < BTRACE_NIDS);
+  btrace_record(BTRACE_T_END, id, 0, arg);
+}
+
+/****************************************************************************
+ * Name: esp32_btrace_ring
+ *
+ * Description:
+ *   Stop tracing and return the raw ring of 'cpu' and its size, for the
+ *   crash dump.
+ *
+ ****************************************************************************/
+
+FAR const void *esp32_btrace_ring(int cpu, FAR size_t *size)
+{
+  DEBUGASSERT(cpu >= 0 && cpu < CONFIG_SMP_NCPUS);
+
+  g_btrace.enabled = false;
+
+  *size = sizeof(struct btrace_ring_s);
+  return &g_btrace.rings[cpu];
+}
+
+#endif /* CONFIG_BOARD_ESP32_BTRACE */
@@ -81,7 +81,11 @@ uint32_t board_buttons(void)
 
   for (i = 0; i < 10; i++)
     {
-      up_mdelay(1); /* TODO */
+#ifdef CONFIG_BOARD_ESP32_DELAY
+      esp32_delay_ms(1);
+#else
+      up_mdelay(1);
+#endif
 
       bool b1 = esp32_gpioread(BUTTON_BOOT);
 
@@ -140,7 +144,11 @@ int board_button_irq(int id, xcpt_t irqhandler, void *arg)
 
       esp32_gpioirqdisable(irq);
 
+#ifdef CONFIG_BOARD_ESP32_IRQROUTE
+      ret = esp32_irqroute_attach(IRQROUTE_BUTTONS, irq, irqhandler, arg);
+#else
       ret = irq_attach(irq, irqhandler, arg);
+#endif
       if (ret < 0)
         {
           syslog(LOG_ERR, "ERROR: irq_attach() failed: %d\n", ret);
@@ -153,7 +161,11 @@ int board_button_irq(int id, xcpt_t irqhandler, void *arg)
 
       /* Configure the interrupt for rising and falling edges */
 
+#ifdef CONFIG_BOARD_ESP32_IRQROUTE
+      esp32_irqroute_gpioenable(IRQROUTE_BUTTONS, irq, CHANGE);
+#else
       esp32_gpioirqenable(irq, CHANGE);
+#endif
     }
   else
     {
@@ -0,0 +1,679 @@
+/****************************************************************************
+ * boards/xtensa/esp32/esp32-devkitc/src/esp32_canudp.c
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <stdatomic.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <debug.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+#include <nuttx/can/can.h>
+#include <nuttx/clock.h>
+#include <nuttx/fs/fs.h>
+#include <nuttx/fs/procfs.h>
+#include <nuttx/kmalloc.h>
+#include <nuttx/kthread.h>
+#include <nuttx/net/net.h>
+#include <nuttx/semaphore.h>
+
+#include "esp32-devkitc.h"
+
+#ifdef CONFIG_BOARD_ESP32_CANUDP
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+/* Largest message the CAN upper half may return in one piece */
+
+#define CANUDP_MSGMAX      CAN_MSGLEN(CAN_MAXDATALEN)
+
+#define CANUDP_RINGSIZE    CONFIG_BOARD_ESP32_CANUDP_RINGSIZE
+#define CANUDP_MAXPAYLOAD  CONFIG_BOARD_ESP32_CANUDP_MAXPAYLOAD
+#define CANUDP_FLUSH_TICKS MSEC2TICK(CONFIG_BOARD_ESP32_CANUDP_FLUSH_MS)
+
+/* The count field of the datagram header is 8 bits wide */
+
+#define CANUDP_MAXFRAMES   255
+
+#define CANUDP_MAGIC       0x4355   /* "CU" */
+#define CANUDP_VERSION     1
+
+#define CANUDP_LINELEN     64
+
+#if CANUDP_MAXPAYLOAD < CANUDP_MSGMAX
+#  error "CONFIG_BOARD_ESP32_CANUDP_MAXPAYLOAD cannot hold one CAN message"
+#endif
+
+#if CANUDP_RINGSIZE < 2 * CANUDP_MAXPAYLOAD
+#  error "CONFIG_BOARD_ESP32_CANUDP_RINGSIZE must hold two datagrams"
+#endif
+
+#ifdef CONFIG_CAN_FD
+#  define CANUDP_DLC2BYTES(d) can_dlc2bytes(d)
+#else
+#  define CANUDP_DLC2BYTES(d) (d)
+#endif
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+/* Every datagram starts with this header, followed by the CAN messages
+ * exactly as returned by the CAN upper half: a struct can_hdr_s and
+ * ch_dlc data bytes each, packed back to back in target byte order.
+ */
+
+begin_packed_struct struct canudp_hdr_s
+{
+  uint16_t magic;      /* CANUDP_MAGIC, network order */
+  uint8_t  version;    /* CANUDP_VERSION */
+  uint8_t  nframes;    /* Number of CAN messages in the datagram */
+  uint32_t seqno;      /* Datagram sequence number, network order */
+} end_packed_struct;
+
+/* Single producer (CAN reader) / single consumer (UDP sender) ring.
+ * Messages are never split: when the room left at the end of the buffer
+ * cannot take a full message the producer records the end of valid data
+ * in 'wrap' and continues at offset zero.
+ */
+
+struct canudp_ring_s
+{
+  atomic_uint head;    /* Next write offset, owned by the reader */
+  atomic_uint tail;    /* Next read offset, owned by the sender */
+  atomic_uint wrap;    /* End of data before the reader wrapped */
+  sem_t       datasem; /* Posted by the reader when data was added */
+  sem_t       roomsem; /* Posted by the sender when room was freed */
+  aligned_data(4) uint8_t buffer[CANUDP_RINGSIZE];
+};
+
+struct canudp_stats_s
+{
+  uint32_t frames;     /* CAN messages forwarded */
+  uint32_t datagrams;  /* Datagrams sent */
+  uint32_t senderrs;   /* Datagrams the network refused */
+  uint32_t stalls;     /* Times the reader waited for ring room */
+};
+
+#ifdef CONFIG_FS_PROCFS
+struct canudp_file_s
+{
+  struct procfs_file_s base;       /* Base open file structure */
+  char line[CANUDP_LINELEN];       /* Pre-allocated buffer for lines */
+};
+#endif
+
+/****************************************************************************
+ * Private Function Prototypes
+ ****************************************************************************/
+
+#ifdef CONFIG_FS_PROCFS
+static int     canudp_open(FAR struct file *filep, FAR const char *relpath,
+                           int oflags, mode_t mode);
+static int     canudp_close(FAR struct file *filep);
+static ssize_t canudp_read(FAR struct file *filep, FAR char *buffer,
+                           size_t buflen);
+static int     canudp_dup(FAR const struct file *oldp,
+                          FAR struct file *newp);
+static int     canudp_stat(FAR const char *relpath, FAR struct stat *buf);
+#endif
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+static struct canudp_ring_s g_canudp_ring;
+static struct canudp_stats_s g_canudp_stats;
+
+#ifdef CONFIG_FS_PROCFS
+static const struct procfs_operations g_canudp_operations =
+{
+  .open  = canudp_open,
+  .close = canudp_close,
+  .read  = canudp_read,
+  .dup   = canudp_dup,
+  .stat  = canudp_stat,
+};
+
+static const struct procfs_entry_s g_canudp_entry =
+{
+  "canudp", &g_canudp_operations, PROCFS_FILE_TYPE
+};
+#endif
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: canudp_signal
+ *
+ * Description:
+ *   Post a ring event semaphore, keeping its count at one at most so that
+ *   a busy producer does not make the peer spin on stale events.
+ *
+ ****************************************************************************/
+
+static void canudp_signal(FAR sem_t *sem)
+{
+  int value;
+
+  if (nxsem_get_value(sem, &value) >= 0 && value < 1)
+    {
+      nxsem_post(sem);
+    }
+}
+
+/****************************************************************************
+ * Name: canudp_msglen
+ *
+ * Description:
+ *   Return the size of the CAN message stored at 'msg'.  Messages are
+ *   packed without padding, so the header is copied out before it is
+ *   inspected.
+ *
+ ****************************************************************************/
+
+static size_t canudp_msglen(FAR const uint8_t *msg)
+{
+  struct can_hdr_s hdr;
+
+  memcpy(&hdr, msg, sizeof(hdr));
+  return CAN_MSGLEN(CANUDP_DLC2BYTES(hdr.ch_dlc));
+}
+
+/****************************************************************************
+ * Name: canudp_reader
+ *
+ * Description:
+ *   Read CAN messages straight into the free part of the ring.
+ *
+ ****************************************************************************/
+
+static int canudp_reader(int argc, FAR char *argv[])
+{
+  FAR struct canudp_ring_s *ring = &g_canudp_ring;
+  struct file filep;
+  unsigned int head;
+  unsigned int tail;
+  size_t room;
+  ssize_t nread;
+  int ret;
+
+  ret = file_open(&filep, CONFIG_BOARD_ESP32_CANUDP_DEVPATH, O_RDONLY);
+  if (ret < 0)
+    {
+      canerr("ERROR: Failed to open %s: %d\n",
+             CONFIG_BOARD_ESP32_CANUDP_DEVPATH, ret);
+      return ret;
+    }
+
+  head = 0;
+
+  for (; ; )
+    {
+      tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+      if (head >= tail)
+        {
+          room = CANUDP_RINGSIZE - head;
+          if (room < CANUDP_MSGMAX && tail > CANUDP_MSGMAX)
+            {
+              /* Continue at the start of the buffer */
+
+              atomic_store_explicit(&ring->wrap, head,
+                                    memory_order_relaxed);
+              head = 0;
+              room = tail - 1;
+            }
+        }
+      else
+        {
+          room = tail - head - 1;
+        }
+
+      if (room < CANUDP_MSGMAX)
+        {
+          /* The sender is behind, wait until it frees some room */
+
+          g_canudp_stats.stalls++;
+          nxsem_wait_uninterruptible(&ring->roomsem);
+          continue;
+        }
+
+      nread = file_read(&filep, &ring->buffer[head], room);
+      if (nread < 0)
+        {
+          if (nread != -EINTR)
+            {
+              canerr("ERROR: CAN read failed: %zd\n", nread);
+            }
+
+          continue;
+        }
+
+      head += nread;
+      atomic_store_explicit(&ring->head, head, memory_order_release);
+      canudp_signal(&ring->datasem);
+    }
+
+  return OK;
+}
+
+/****************************************************************************
+ * Name: canudp_pending
+ *
+ * Description:
+ *   Return the number of bytes queued in the ring.
+ *
+ ****************************************************************************/
+
+static size_t canudp_pending(FAR struct canudp_ring_s *ring,
+                             unsigned int tail)
+{
+  unsigned int head = atomic_load_explicit(&ring->head,
+                                           memory_order_acquire);
+
+  if (head >= tail)
+    {
+      return head - tail;
+    }
+
+  return atomic_load_explicit(&ring->wrap, memory_order_relaxed) -
+         tail + head;
+}
+
+/****************************************************************************
+ * Name: canudp_send
+ *
+ * Description:
+ *   Send the messages at the tail of the ring as one datagram.  The
+ *   payload is described in place by an I/O vector, so the only copy of
+ *   the frame data is the one made by the network stack.
+ *
+ ****************************************************************************/
+
+static unsigned int canudp_send(FAR struct canudp_ring_s *ring,
+                                FAR struct socket *psock,
+                                unsigned int tail, uint32_t seqno)
+{
+  struct canudp_hdr_s hdr;
+  struct iovec iov[3];
+  struct msghdr msg;
+  unsigned int head;
+  unsigned int end;
+  unsigned int pos;
+  size_t payload;
+  size_t msglen;
+  int nframes;
+  int niov;
+  ssize_t ret;
+
+  head = atomic_load_explicit(&ring->head, memory_order_acquire);
+  if (tail == head)
+    {
+      return tail;
+    }
+
+  iov[0].iov_base = &hdr;
+  iov[0].iov_len  = sizeof(hdr);
+  niov            = 1;
+  payload         = 0;
+  nframes         = 0;
+  pos             = tail;
+
+  /* Gather at most two contiguous runs: up to the wrap point, then from
+   * the start of the buffer.
+   */
+
+  while (pos != head && nframes < CANUDP_MAXFRAMES)
+    {
+      if (pos > head)
+        {
+          end = atomic_load_explicit(&ring->wrap, memory_order_relaxed);
+          if (pos == end)
+            {
+              pos = 0;
+              continue;
+            }
+        }
+      else
+        {
+          end = head;
+        }
+
+      iov[niov].iov_base = &ring->buffer[pos];
+      iov[niov].iov_len  = 0;
+
+      while (pos < end && nframes < CANUDP_MAXFRAMES)
+        {
+          msglen = canudp_msglen(&ring->buffer[pos]);
+          if (payload + msglen > CANUDP_MAXPAYLOAD)
+            {
+              break;
+            }
+
+          iov[niov].iov_len += msglen;
+          payload           += msglen;
+          pos               += msglen;
+          nframes++;
+        }
+
+      niov++;
+
+      if (pos < end || niov == 3)
+        {
+          break;
+        }
+    }
+
+  hdr.magic   = HTONS(CANUDP_MAGIC);
+  hdr.version = CANUDP_VERSION;
+  hdr.nframes = nframes;
+  hdr.seqno   = htonl(seqno);
+
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov    = iov;
+  msg.msg_iovlen = niov;
+
+  ret = psock_sendmsg(psock, &msg, 0);
+  if (ret < 0)
+    {
+      g_canudp_stats.senderrs++;
+      nerr("ERROR: CAN datagram not sent: %zd\n", ret);
+    }
+  else
+    {
+      g_canudp_stats.datagrams++;
+      g_canudp_stats.frames += nframes;
+    }
+
+  /* The frames are dropped on error as well: retrying would only delay
+   * newer traffic behind data the host no longer expects.
+   */
+
+  return pos;
+}
+
+/****************************************************************************
+ * Name: canudp_sender
+ *
+ * Description:
+ *   Batch the queued CAN messages into UDP datagrams.  A datagram is sent
+ *   as soon as it is full or when its first message has waited for the
+ *   configured flush deadline.
+ *
+ ****************************************************************************/
+
+static int canudp_sender(int argc, FAR char *argv[])
+{
+  FAR struct canudp_ring_s *ring = &g_canudp_ring;
+  struct sockaddr_in addr;
+  struct socket sock;
+  clock_t deadline;
+  sclock_t remaining;
+  unsigned int tail;
+  uint32_t seqno;
+  int ret;
+
+  ret = psock_socket(AF_INET, SOCK_DGRAM, 0, &sock);
+  if (ret < 0)
+    {
+      nerr("ERROR: Failed to create the gateway socket: %d\n", ret);
+      return ret;
+    }
+
+  addr.sin_family      = AF_INET;
+  addr.sin_port        = HTONS(CONFIG_BOARD_ESP32_CANUDP_PORT);
+  addr.sin_addr.s_addr = HTONL(CONFIG_BOARD_ESP32_CANUDP_IPADDR);
+
+  ret = psock_connect(&sock, (FAR const struct sockaddr *)&addr,
+                      sizeof(addr));
+  if (ret < 0)
+    {
+      nerr("ERROR: Failed to set the gateway peer: %d\n", ret);
+      psock_close(&sock);
+      return ret;
+    }
+
+  tail  = 0;
+  seqno = 0;
+
+  for (; ; )
+    {
+      /* Wait for the first message of the next batch */
+
+      while (canudp_pending(ring, tail) == 0)
+        {
+          nxsem_wait_uninterruptible(&ring->datasem);
+        }
+
+      /* Then for the batch to fill up or for its deadline to expire */
+
+      deadline = clock_systime_ticks() + CANUDP_FLUSH_TICKS;
+
+      while (canudp_pending(ring, tail) + CANUDP_MSGMAX <=
+             CANUDP_MAXPAYLOAD)
+        {
+          remaining = (sclock_t)(deadline - clock_systime_ticks());
+          if (remaining <= 0 ||
+              nxsem_tickwait_uninterruptible(&ring->datasem,
+                                             remaining) == -ETIMEDOUT)
+            {
+              break;
+            }
+        }
+
+      tail = canudp_send(ring, &sock, tail, seqno++);
+      atomic_store_explicit(&ring->tail, tail, memory_order_release);
+      canudp_signal(&ring->roomsem);
+    }
+
+  return OK;
+}
+
+#ifdef CONFIG_FS_PROCFS
+
+/****************************************************************************
+ * Name: canudp_open
+ ****************************************************************************/
+
+static int canudp_open(FAR struct file *filep, FAR const char *relpath,
+                       int oflags, mode_t mode)
+{
+  FAR struct canudp_file_s *priv;
+
+  /* This is a read-only file */
+
+  if ((oflags & O_WRONLY) != 0 || (oflags & O_RDONLY) == 0)
+    {
+      return -EACCES;
+    }
+
+  priv = kmm_zalloc(sizeof(struct canudp_file_s));
+  if (priv == NULL)
+    {
+      return -ENOMEM;
+    }
+
+  filep->f_priv = priv;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: canudp_close
+ ****************************************************************************/
+
+static int canudp_close(FAR struct file *filep)
+{
+  kmm_free(filep->f_priv);
+  filep->f_priv = NULL;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: canudp_read
+ *
+ * Description:
+ *   Report the gateway counters and the bytes waiting in the ring.  The
+ *   frames per datagram tell how well the batching works at the current
+ *   bus load.
+ *
+ ****************************************************************************/
+
+static ssize_t canudp_read(FAR struct file *filep, FAR char *buffer,
+                           size_t buflen)
+{
+  FAR struct canudp_file_s *priv = filep->f_priv;
+  struct canudp_stats_s stats = g_canudp_stats;
+  off_t offset = filep->f_pos;
+  size_t totalsize = 0;
+  size_t linesize;
+  unsigned int tail;
+  uint32_t avg10;
+
+  DEBUGASSERT(priv != NULL);
+
+  tail  = atomic_load_explicit(&g_canudp_ring.tail, memory_order_acquire);
+
+  avg10 = stats.datagrams > 0 ?
+          (uint32_t)((uint64_t)stats.frames * 10 / stats.datagrams) : 0;
+
+  linesize = procfs_snprintf(priv->line, CANUDP_LINELEN,
+                             "Frames:    %" PRIu32 "\n"
+                             "Datagrams: %" PRIu32 "\n",
+                             stats.frames, stats.datagrams);
+  totalsize += procfs_memcpy(priv->line, linesize, buffer, buflen,
+                             &offset);
+
+  linesize = procfs_snprintf(priv->line, CANUDP_LINELEN,
+                             "Per dgram: %" PRIu32 ".%" PRIu32 "\n"
+                             "Send errs: %" PRIu32 "\n",
+                             avg10 / 10, avg10 % 10, stats.senderrs);
+  totalsize += procfs_memcpy(priv->line, linesize, buffer + totalsize,
+                             buflen - totalsize, &offset);
+
+  linesize = procfs_snprintf(priv->line, CANUDP_LINELEN,
+                             "Stalls:    %" PRIu32 "\n"
+                             "Queued:    %zu\n",
+                             stats.stalls,
+                             canudp_pending(&g_canudp_ring, tail));
+  totalsize += procfs_memcpy(priv->line, linesize, buffer + totalsize,
+                             buflen - totalsize, &offset);
+
+  filep->f_pos += totalsize;
+  return totalsize;
+}
+
+/****************************************************************************
+ * Name: canudp_dup
+ ****************************************************************************/
+
+static int canudp_dup(FAR const struct file *oldp, FAR struct file *newp)
+{
+  FAR struct canudp_file_s *newpriv;
+
+  newpriv = kmm_zalloc(sizeof(struct canudp_file_s));
+  if (newpriv == NULL)
+    {
+      return -ENOMEM;
+    }
+
+  memcpy(newpriv, oldp->f_priv, sizeof(struct canudp_file_s));
+  newp->f_priv = newpriv;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: canudp_stat
+ ****************************************************************************/
+
+static int canudp_stat(FAR const char *relpath, FAR struct stat *buf)
+{
+  memset(buf, 0, sizeof(struct stat));
+  buf->st_mode = S_IFREG | S_IROTH | S_IRGRP | S_IRUSR;
+  return OK;
+}
+
+#endif /* CONFIG_FS_PROCFS */
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: esp32_canudp_initialize
+ *
+ * Description:
+ *   Start the CAN to UDP gateway threads.
+ *
+ ****************************************************************************/
+
+int esp32_canudp_initialize(void)
+{
+  FAR struct canudp_ring_s *ring = &g_canudp_ring;
+  int pid;
+
+  nxsem_init(&ring->datasem, 0, 0);
+  nxsem_init(&ring->roomsem, 0, 0);
+
+  /* The sender runs one priority level below the reader so that CAN
+   * reception is never held off by a slow network transmission.
+   */
+
+  pid = kthread_create("canudp_tx", CONFIG_BOARD_ESP32_CANUDP_PRIORITY - 1,
+                       CONFIG_BOARD_ESP32_CANUDP_STACKSIZE,
+                       canudp_sender, NULL);
+  if (pid < 0)
+    {
+      return pid;
+    }
+
+  pid = kthread_create("canudp_rx", CONFIG_BOARD_ESP32_CANUDP_PRIORITY,
+                       CONFIG_BOARD_ESP32_CANUDP_STACKSIZE,
+                       canudp_reader, NULL);
+  if (pid < 0)
+    {
+      return pid;
+    }
+
+#ifdef CONFIG_FS_PROCFS
+  return procfs_register(&g_canudp_entry);
+#else
+  return OK;
+#endif
+}
+
+#endif /* CONFIG_BOARD_ESP32_CANUDP */
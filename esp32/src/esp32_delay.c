@@ -0,0 +1,126 @@
+/****************************************************************************
+ * boards/xtensa/esp32/esp32-devkitc/src/esp32_delay.c
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <sys/types.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <nuttx/arch.h>
+#include <nuttx/clock.h>
+#include <nuttx/init.h>
+#include <nuttx/sched.h>
+#include <nuttx/signal.h>
+
+#include "esp32_rt_timer.h"
+#include "esp32-devkitc.h"
+
+#ifdef CONFIG_BOARD_ESP32_DELAY
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+/* The RT timer cannot be read before its bringup step */
+
+static bool g_delay_ready;
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: delay_can_sleep
+ ****************************************************************************/
+
+static bool delay_can_sleep(void)
+{
+  return OSINIT_OS_READY() && !up_interrupt_context() && !sched_idletask();
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: esp32_delay_initialize
+ *
+ * Description:
+ *   Switch the board delays over to the RT timer, once it runs.
+ *
+ ****************************************************************************/
+
+int esp32_delay_initialize(void)
+{
+  g_delay_ready = true;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: esp32_delay_us
+ *
+ * Description:
+ *   Wait for at least 'us' microseconds by the RT timer, which counts the
+ *   crystal whatever the CPU frequency.  Delays of two ticks or more sleep
+ *   for all but the last tick, the rest is spent spinning on the timer, so
+ *   the delay ends within a few microseconds of the deadline.  Interrupt
+ *   handlers and the idle thread always spin.
+ *
+ ****************************************************************************/
+
+void esp32_delay_us(uint32_t us)
+{
+  uint64_t deadline;
+
+  if (!g_delay_ready)
+    {
+      up_udelay(us);
+      return;
+    }
+
+  deadline = esp32_rt_timer_time_us() + us;
+
+  /* A sleep of n ticks may end up to a tick early, never late */
+
+  if (us >= 2 * USEC_PER_TICK && delay_can_sleep())
+    {
+      nxsig_usleep(us - USEC_PER_TICK);
+    }
+
+  while (esp32_rt_timer_time_us() < deadline)
+    {
+    }
+}
+
+/****************************************************************************
+ * Name: esp32_delay_ms
+ ****************************************************************************/
+
+void esp32_delay_ms(uint32_t ms)
+{
+  esp32_delay_us(ms * USEC_PER_MSEC);
+}
+
+#endif /* CONFIG_BOARD_ESP32_DELAY */
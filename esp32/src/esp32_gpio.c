@@ -191,12 +191,23 @@ static int gpout_read(struct gpio_dev_s *dev, bool *value)
 static int gpout_write(struct gpio_dev_s *dev, bool value)
 {
   struct esp32gpio_dev_s *esp32gpio = (struct esp32gpio_dev_s *)dev;
+#ifdef CONFIG_BOARD_ESP32_PCOUNT
+  uint64_t start;
+#endif
 
   DEBUGASSERT(esp32gpio != NULL);
   DEBUGASSERT(esp32gpio->id < BOARD_NGPIOOUT);
   gpioinfo("Writing %d\n", (int)value);
 
+#ifdef CONFIG_BOARD_ESP32_PCOUNT
+  start = esp32_pcount_begin();
+#endif
+
   esp32_gpiowrite(g_gpiooutputs[esp32gpio->id], value);
+
+#ifdef CONFIG_BOARD_ESP32_PCOUNT
+  esp32_pcount_end(PCOUNT_GPIO, start, 0, OK);
+#endif
   return OK;
 }
 #endif
@@ -228,12 +239,23 @@ static int esp32gpio_interrupt(int irq, void *context, void *arg)
 {
   struct esp32gpint_dev_s *esp32gpint =
     (struct esp32gpint_dev_s *)arg;
+#ifdef CONFIG_BOARD_ESP32_PCOUNT
+  uint64_t start;
+#endif
 
   DEBUGASSERT(esp32gpint != NULL && esp32gpint->callback != NULL);
   gpioinfo("Interrupt! callback=%p\n", esp32gpint->callback);
 
+#ifdef CONFIG_BOARD_ESP32_PCOUNT
+  start = esp32_pcount_begin();
+#endif
+
   esp32gpint->callback(&esp32gpint->esp32gpio.gpio,
                        esp32gpint->esp32gpio.id);
+
+#ifdef CONFIG_BOARD_ESP32_PCOUNT
+  esp32_pcount_end(PCOUNT_GPIO, start, 0, OK);
+#endif
   return OK;
 }
 
@@ -271,9 +293,15 @@ static int gpint_attach(struct gpio_dev_s *dev,
   /* Make sure the interrupt is disabled */
 
   esp32_gpioirqdisable(irq);
+#ifdef CONFIG_BOARD_ESP32_IRQROUTE
+  ret = esp32_irqroute_attach(IRQROUTE_GPIO, irq,
+                              esp32gpio_interrupt,
+                              &g_gpint[esp32gpint->esp32gpio.id]);
+#else
   ret = irq_attach(irq,
                    esp32gpio_interrupt,
                    &g_gpint[esp32gpint->esp32gpio.id]);
+#endif
   if (ret < 0)
     {
       syslog(LOG_ERR, "ERROR: gpint_attach() failed: %d\n", ret);
@@ -303,7 +331,11 @@ static int gpint_enable(struct gpio_dev_s *dev, bool enable)
 
           /* Configure the interrupt for rising edge */
 
+#ifdef CONFIG_BOARD_ESP32_IRQROUTE
+          esp32_irqroute_gpioenable(IRQROUTE_GPIO, irq, RISING);
+#else
           esp32_gpioirqenable(irq, RISING);
+#endif
         }
     }
   else
@@ -0,0 +1,385 @@
+/****************************************************************************
+ * boards/xtensa/esp32/esp32-devkitc/src/esp32_heapmon.c
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <sys/types.h>
+#include <sys/param.h>
+#include <sys/stat.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <debug.h>
+
+#include <nuttx/clock.h>
+#include <nuttx/kmalloc.h>
+#include <nuttx/mm/mm.h>
+#include <nuttx/fs/fs.h>
+#include <nuttx/fs/procfs.h>
+#include <nuttx/spinlock.h>
+#include <nuttx/wqueue.h>
+#include <arch/esp32/memory_layout.h>
+
+#include "mm_heap/mm.h"
+#include "hardware/esp32_soc.h"
+#include "esp32-devkitc.h"
+
+#ifdef CONFIG_BOARD_ESP32_HEAPMON
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define HEAPMON_LINELEN  64
+#define HEAPMON_PERIOD   MSEC2TICK(CONFIG_BOARD_ESP32_HEAPMON_PERIOD_MS)
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+struct heapmon_region_s
+{
+  FAR const char *name;
+  uintptr_t start;
+  uintptr_t end;
+};
+
+struct heapmon_file_s
+{
+  struct procfs_file_s base;       /* Base open file structure */
+  char line[HEAPMON_LINELEN];      /* Pre-allocated buffer for lines */
+};
+
+/****************************************************************************
+ * Private Function Prototypes
+ ****************************************************************************/
+
+static int     heapmon_open(FAR struct file *filep, FAR const char *relpath,
+                            int oflags, mode_t mode);
+static int     heapmon_close(FAR struct file *filep);
+static ssize_t heapmon_read(FAR struct file *filep, FAR char *buffer,
+                            size_t buflen);
+static int     heapmon_dup(FAR const struct file *oldp,
+                           FAR struct file *newp);
+static int     heapmon_stat(FAR const char *relpath, FAR struct stat *buf);
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+/* Heap regions by address.  The first match wins, DRAM takes the rest. */
+
+static const struct heapmon_region_s g_heapmon_regions[] =
+{
+#ifdef CONFIG_SMP
+  { "ROMAPP", HEAP_REGION_ROMAPP_START, HEAP_REGION_ROMAPP_END },
+#endif
+#ifdef CONFIG_ESP32_SPIRAM
+  { "PSRAM",  SOC_EXTRAM_DATA_LOW,      SOC_EXTRAM_DATA_HIGH   },
+#endif
+  { "DRAM",   0,                        UINTPTR_MAX            },
+};
+
+#define HEAPMON_NREGIONS nitems(g_heapmon_regions)
+
+/* Last published sample, 'peak' persists across samples */
+
+static struct esp32_heapstat_s g_heapmon_stats[HEAPMON_NREGIONS];
+static spinlock_t g_heapmon_lock = SP_UNLOCKED;
+static struct work_s g_heapmon_work;
+
+static const struct procfs_operations g_heapmon_operations =
+{
+  .open  = heapmon_open,
+  .close = heapmon_close,
+  .read  = heapmon_read,
+  .dup   = heapmon_dup,
+  .stat  = heapmon_stat,
+};
+
+static const struct procfs_entry_s g_heapmon_entry =
+{
+  "heapmon", &g_heapmon_operations, PROCFS_FILE_TYPE
+};
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: heapmon_node
+ *
+ * Description:
+ *   Account one heap chunk to the region holding it.  Called by
+ *   mm_foreach() with the heap locked, so it must not allocate.
+ *
+ ****************************************************************************/
+
+static void heapmon_node(FAR struct mm_allocnode_s *node, FAR void *arg)
+{
+  FAR struct esp32_heapstat_s *stats = arg;
+  FAR struct esp32_heapstat_s *stat;
+  uintptr_t addr = (uintptr_t)node;
+  size_t size = MM_SIZEOF_NODE(node);
+  int i;
+
+  for (i = 0; i < HEAPMON_NREGIONS - 1; i++)
+    {
+      if (addr >= g_heapmon_regions[i].start &&
+          addr < g_heapmon_regions[i].end)
+        {
+          break;
+        }
+    }
+
+  stat        = &stats[i];
+  stat->size += size;
+
+  if (MM_NODE_IS_ALLOC(node))
+    {
+      stat->used += size;
+    }
+  else
+    {
+      stat->free += size;
+      stat->nfree++;
+      if (size > stat->largest)
+        {
+          stat->largest = size;
+        }
+    }
+}
+
+/****************************************************************************
+ * Name: heapmon_sample
+ *
+ * Description:
+ *   Walk the heap once and publish the per-region figures.  Runs on the
+ *   low priority work queue, the walk holds the heap lock for a time
+ *   proportional to the number of chunks.
+ *
+ ****************************************************************************/
+
+static void heapmon_sample(FAR void *arg)
+{
+  struct esp32_heapstat_s stats[HEAPMON_NREGIONS];
+  irqstate_t flags;
+  int i;
+
+  memset(stats, 0, sizeof(stats));
+  mm_foreach(g_mmheap, heapmon_node, stats);
+
+  flags = spin_lock_irqsave(&g_heapmon_lock);
+
+  for (i = 0; i < HEAPMON_NREGIONS; i++)
+    {
+      stats[i].name = g_heapmon_regions[i].name;
+      stats[i].peak = MAX(g_heapmon_stats[i].peak, stats[i].used);
+      g_heapmon_stats[i] = stats[i];
+    }
+
+  spin_unlock_irqrestore(&g_heapmon_lock, flags);
+
+  work_queue(LPWORK, &g_heapmon_work, heapmon_sample, NULL,
+             HEAPMON_PERIOD);
+}
+
+/****************************************************************************
+ * Name: heapmon_open
+ ****************************************************************************/
+
+static int heapmon_open(FAR struct file *filep, FAR const char *relpath,
+                        int oflags, mode_t mode)
+{
+  FAR struct heapmon_file_s *priv;
+
+  /* This is a read-only file */
+
+  if ((oflags & O_WRONLY) != 0 || (oflags & O_RDONLY) == 0)
+    {
+      return -EACCES;
+    }
+
+  priv = kmm_zalloc(sizeof(struct heapmon_file_s));
+  if (priv == NULL)
+    {
+      return -ENOMEM;
+    }
+
+  filep->f_priv = priv;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: heapmon_close
+ ****************************************************************************/
+
+static int heapmon_close(FAR struct file *filep)
+{
+  kmm_free(filep->f_priv);
+  filep->f_priv = NULL;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: heapmon_read
+ ****************************************************************************/
+
+static ssize_t heapmon_read(FAR struct file *filep, FAR char *buffer,
+                            size_t buflen)
+{
+  FAR struct heapmon_file_s *priv = filep->f_priv;
+  struct esp32_heapstat_s stats[HEAPMON_NREGIONS];
+  FAR struct esp32_heapstat_s *stat;
+  off_t offset = filep->f_pos;
+  size_t totalsize = 0;
+  size_t linesize;
+  size_t copysize;
+  unsigned int frag;
+  int nstats;
+  int i;
+
+  DEBUGASSERT(priv != NULL);
+
+  nstats = esp32_heapmon_stats(stats, HEAPMON_NREGIONS);
+
+  linesize = procfs_snprintf(priv->line, HEAPMON_LINELEN,
+                             "%-6s %7s %7s %7s %7s %4s %7s\n",
+                             "REGION", "SIZE", "USED", "FREE", "LARGEST",
+                             "FRAG", "PEAK");
+  copysize = procfs_memcpy(priv->line, linesize, buffer, buflen, &offset);
+  totalsize += copysize;
+
+  for (i = 0; i < nstats && totalsize < buflen; i++)
+    {
+      stat = &stats[i];
+      if (stat->size == 0)
+        {
+          continue;
+        }
+
+      /* Share of the free memory that is not in the largest chunk */
+
+      frag = stat->free > 0 ?
+             100 - (unsigned int)(stat->largest * 100 / stat->free) : 0;
+
+      linesize = procfs_snprintf(priv->line, HEAPMON_LINELEN,
+                                 "%-6s %7zu %7zu %7zu %7zu %3u%% %7zu\n",
+                                 stat->name, stat->size, stat->used,
+                                 stat->free, stat->largest, frag,
+                                 stat->peak);
+      copysize = procfs_memcpy(priv->line, linesize, buffer + totalsize,
+                               buflen - totalsize, &offset);
+      totalsize += copysize;
+    }
+
+  if (totalsize < buflen)
+    {
+      linesize = procfs_snprintf(priv->line, HEAPMON_LINELEN,
+                                 "Reclaimed at boot: %zu\n",
+                                 esp32_reclaim_bytes());
+      copysize = procfs_memcpy(priv->line, linesize, buffer + totalsize,
+                               buflen - totalsize, &offset);
+      totalsize += copysize;
+    }
+
+  filep->f_pos += totalsize;
+  return totalsize;
+}
+
+/****************************************************************************
+ * Name: heapmon_dup
+ ****************************************************************************/
+
+static int heapmon_dup(FAR const struct file *oldp, FAR struct file *newp)
+{
+  FAR struct heapmon_file_s *newpriv;
+
+  newpriv = kmm_zalloc(sizeof(struct heapmon_file_s));
+  if (newpriv == NULL)
+    {
+      return -ENOMEM;
+    }
+
+  memcpy(newpriv, oldp->f_priv, sizeof(struct heapmon_file_s));
+  newp->f_priv = newpriv;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: heapmon_stat
+ ****************************************************************************/
+
+static int heapmon_stat(FAR const char *relpath, FAR struct stat *buf)
+{
+  memset(buf, 0, sizeof(struct stat));
+  buf->st_mode = S_IFREG | S_IROTH | S_IRGRP | S_IRUSR;
+  return OK;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: esp32_heapmon_stats
+ *
+ * Description:
+ *   Copy the last sample of up to 'nstats' heap regions, for telemetry.
+ *
+ * Returned Value:
+ *   The number of regions copied.
+ *
+ ****************************************************************************/
+
+int esp32_heapmon_stats(FAR struct esp32_heapstat_s *stats, int nstats)
+{
+  irqstate_t flags;
+
+  nstats = MIN(nstats, (int)HEAPMON_NREGIONS);
+
+  flags = spin_lock_irqsave(&g_heapmon_lock);
+  memcpy(stats, g_heapmon_stats, nstats * sizeof(struct esp32_heapstat_s));
+  spin_unlock_irqrestore(&g_heapmon_lock, flags);
+
+  return nstats;
+}
+
+/****************************************************************************
+ * Name: esp32_heapmon_initialize
+ *
+ * Description:
+ *   Take the first sample, start the periodic sampling and register
+ *   /proc/heapmon.
+ *
+ ****************************************************************************/
+
+int esp32_heapmon_initialize(void)
+{
+  heapmon_sample(NULL);
+  return procfs_register(&g_heapmon_entry);
+}
+
+#endif /* CONFIG_BOARD_ESP32_HEAPMON */
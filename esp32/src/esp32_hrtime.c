@@ -0,0 +1,220 @@
+/****************************************************************************
+ * boards/xtensa/esp32/esp32-devkitc/src/esp32_hrtime.c
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <sys/types.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include <errno.h>
+#include <debug.h>
+
+#include <nuttx/arch.h>
+#include <nuttx/clock.h>
+#include <nuttx/irq.h>
+#include <nuttx/spinlock.h>
+#include <nuttx/wqueue.h>
+#include <arch/board/board.h>
+
+#include "esp32_rt_timer.h"
+#include "esp32-devkitc.h"
+
+#ifdef CONFIG_BOARD_ESP32_HRTIME
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define HRTIME_PERIOD  MSEC2TICK(CONFIG_BOARD_ESP32_HRTIME_CAL_MS)
+
+/* An RTC error beyond this is a step of the wall clock, not drift */
+
+#define HRTIME_STEP_PPM 1000
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+/* Calibration sample the RTC rate is measured from, taken again when
+ * the wall clock is stepped.
+ */
+
+struct hrtime_cal_s
+{
+  uint64_t us;               /* RT timer */
+  int64_t  rtc;              /* RTC, in microseconds */
+  bool     valid;
+};
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+static struct hrtime_page_s g_hrtime_page;
+static struct hrtime_cal_s g_hrtime_base;
+static struct work_s g_hrtime_work;
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: hrtime_cycles
+ ****************************************************************************/
+
+static uint32_t hrtime_cycles(void)
+{
+  return (uint32_t)up_perf_gettime();
+}
+
+/****************************************************************************
+ * Name: hrtime_sample
+ *
+ * Description:
+ *   Read the RT timer and the RTC together.  The RT timer is read on both
+ *   sides of the RTC and averaged, with the interrupts masked.
+ *
+ ****************************************************************************/
+
+static void hrtime_sample(FAR uint64_t *us, FAR int64_t *rtc)
+{
+  struct timespec ts;
+  irqstate_t flags;
+  uint64_t before;
+  uint64_t after;
+
+  flags  = up_irq_save();
+  before = esp32_rt_timer_time_us();
+#ifdef CONFIG_RTC_HIRES
+  up_rtc_gettime(&ts);
+#else
+  clock_gettime(CLOCK_REALTIME, &ts);
+#endif
+  after  = esp32_rt_timer_time_us();
+  up_irq_restore(flags);
+
+  *us  = before + (after - before) / 2;
+  *rtc = (int64_t)ts.tv_sec * USEC_PER_SEC + ts.tv_nsec / NSEC_PER_USEC;
+}
+
+/****************************************************************************
+ * Name: hrtime_calibrate
+ *
+ * Description:
+ *   Refresh the offset from the RT timer to the wall clock and the rate of
+ *   the RTC against the RT timer, which runs from the crystal.  A gap
+ *   between the two beyond HRTIME_STEP_PPM is a step of the wall clock,
+ *   settimeofday() or the RTC discipline, and restarts the rate
+ *   measurement.  Readers retry while 'seq' is odd or changed.
+ *
+ ****************************************************************************/
+
+static void hrtime_calibrate(FAR void *arg)
+{
+  FAR struct hrtime_page_s *page = &g_hrtime_page;
+  FAR struct hrtime_cal_s *base = &g_hrtime_base;
+  uint64_t us;
+  int64_t rtc;
+  int64_t elapsed;
+  int64_t error;
+  int32_t ppm = 0;
+
+  hrtime_sample(&us, &rtc);
+
+  if (base->valid && us > base->us)
+    {
+      elapsed = (int64_t)(us - base->us);
+      error   = (rtc - base->rtc) - elapsed;
+
+      if (error > elapsed / (1000000 / HRTIME_STEP_PPM) ||
+          error < -elapsed / (1000000 / HRTIME_STEP_PPM))
+        {
+          base->valid = false;
+        }
+      else
+        {
+          ppm = error * 1000000 / elapsed;
+        }
+    }
+
+  if (!base->valid)
+    {
+      base->us    = us;
+      base->rtc   = rtc;
+      base->valid = true;
+    }
+
+  page->seq++;
+  SP_DMB();
+
+  page->realtime_offset = rtc - (int64_t)us;
+  page->rtc_ppm         = ppm;
+
+  SP_DMB();
+  page->seq++;
+
+  work_queue(LPWORK, &g_hrtime_work, hrtime_calibrate, NULL,
+             HRTIME_PERIOD);
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: esp32_hrtime_initialize
+ *
+ * Description:
+ *   Fill the time page and start its calibration.
+ *
+ ****************************************************************************/
+
+int esp32_hrtime_initialize(void)
+{
+  FAR struct hrtime_page_s *page = &g_hrtime_page;
+
+  page->version     = HRTIME_VERSION;
+  page->cycle_hz    = up_perf_getfreq();
+  page->read_us     = esp32_rt_timer_time_us;
+  page->read_cycles = hrtime_cycles;
+
+  hrtime_calibrate(NULL);
+  return OK;
+}
+
+/****************************************************************************
+ * Name: esp32_hrtime_page
+ *
+ * Description:
+ *   Return the time page, for boardctl(BOARDIOC_HRTIME_PAGE).
+ *
+ ****************************************************************************/
+
+FAR const struct hrtime_page_s *esp32_hrtime_page(void)
+{
+  return &g_hrtime_page;
+}
+
+#endif /* CONFIG_BOARD_ESP32_HRTIME */
@@ -0,0 +1,481 @@
+/****************************************************************************
+ * boards/xtensa/esp32/esp32-devkitc/src/esp32_irqroute.c
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <sched.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <debug.h>
+
+#include <nuttx/arch.h>
+#include <nuttx/irq.h>
+#include <nuttx/kmalloc.h>
+#include <nuttx/sched.h>
+#include <nuttx/spinlock.h>
+#include <nuttx/fs/fs.h>
+#include <nuttx/fs/procfs.h>
+
+#include "esp32_gpio.h"
+#include "esp32-devkitc.h"
+
+#ifdef CONFIG_BOARD_ESP32_IRQROUTE
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define IRQROUTE_NSLOTS   8
+#define IRQROUTE_LINELEN  64
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+struct irqroute_source_s
+{
+  FAR const char *name;
+  int8_t   cpu;                      /* CPU the source is routed to */
+  int8_t   lastcpu;                  /* CPU of the last enable, or -1 */
+  bool     counted;                  /* Handlers go through a trampoline */
+  uint32_t nmisroute;                /* Enables done on another CPU */
+  uint32_t count[CONFIG_SMP_NCPUS];  /* Interrupts taken per CPU */
+};
+
+/* A handler attached through the counting trampoline */
+
+struct irqroute_slot_s
+{
+  int      irq;
+  int      source;
+  xcpt_t   handler;                    /* NULL if the slot is free */
+  FAR void *arg;
+};
+
+struct irqroute_gpio_s
+{
+  int irq;
+  int intrtype;
+};
+
+struct irqroute_file_s
+{
+  struct procfs_file_s base;           /* Base open file structure */
+  char line[IRQROUTE_LINELEN];         /* Pre-allocated buffer for lines */
+};
+
+/****************************************************************************
+ * Private Function Prototypes
+ ****************************************************************************/
+
+static int     irqroute_open(FAR struct file *filep,
+                             FAR const char *relpath, int oflags,
+                             mode_t mode);
+static int     irqroute_close(FAR struct file *filep);
+static ssize_t irqroute_read(FAR struct file *filep, FAR char *buffer,
+                             size_t buflen);
+static int     irqroute_dup(FAR const struct file *oldp,
+                            FAR struct file *newp);
+static int     irqroute_stat(FAR const char *relpath, FAR struct stat *buf);
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+static struct irqroute_source_s g_irqroute_sources[IRQROUTE_NSOURCES] =
+{
+  [IRQROUTE_W5500]   =
+  {
+    "w5500", CONFIG_BOARD_ESP32_IRQROUTE_W5500_CPU, -1
+  },
+  [IRQROUTE_GPIO]    =
+  {
+    "gpio", CONFIG_BOARD_ESP32_IRQROUTE_GPIO_CPU, -1
+  },
+  [IRQROUTE_BUTTONS] =
+  {
+    "buttons", CONFIG_BOARD_ESP32_IRQROUTE_BUTTONS_CPU, -1
+  },
+  [IRQROUTE_TWAI]    =
+  {
+    "twai", CONFIG_BOARD_ESP32_IRQROUTE_TWAI_CPU, -1
+  },
+};
+
+static struct irqroute_slot_s g_irqroute_slots[IRQROUTE_NSLOTS];
+static spinlock_t g_irqroute_lock = SP_UNLOCKED;
+
+static const struct procfs_operations g_irqroute_operations =
+{
+  .open  = irqroute_open,
+  .close = irqroute_close,
+  .read  = irqroute_read,
+  .dup   = irqroute_dup,
+  .stat  = irqroute_stat,
+};
+
+static const struct procfs_entry_s g_irqroute_entry =
+{
+  "irqroute", &g_irqroute_operations, PROCFS_FILE_TYPE
+};
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: irqroute_trampoline
+ *
+ * Description:
+ *   Count the interrupt on the CPU taking it and call the real handler.
+ *
+ ****************************************************************************/
+
+static int irqroute_trampoline(int irq, FAR void *context, FAR void *arg)
+{
+  FAR struct irqroute_slot_s *slot = arg;
+
+  g_irqroute_sources[slot->source].count[up_cpu_index()]++;
+  return slot->handler(irq, context, slot->arg);
+}
+
+/****************************************************************************
+ * Name: irqroute_gpioenable
+ ****************************************************************************/
+
+static int irqroute_gpioenable(FAR void *arg)
+{
+  FAR struct irqroute_gpio_s *gpio = arg;
+
+  esp32_gpioirqenable(gpio->irq, gpio->intrtype);
+  return OK;
+}
+
+/****************************************************************************
+ * Name: irqroute_open
+ ****************************************************************************/
+
+static int irqroute_open(FAR struct file *filep, FAR const char *relpath,
+                         int oflags, mode_t mode)
+{
+  FAR struct irqroute_file_s *priv;
+
+  /* This is a read-only file */
+
+  if ((oflags & O_WRONLY) != 0 || (oflags & O_RDONLY) == 0)
+    {
+      return -EACCES;
+    }
+
+  priv = kmm_zalloc(sizeof(struct irqroute_file_s));
+  if (priv == NULL)
+    {
+      return -ENOMEM;
+    }
+
+  filep->f_priv = priv;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: irqroute_close
+ ****************************************************************************/
+
+static int irqroute_close(FAR struct file *filep)
+{
+  kmm_free(filep->f_priv);
+  filep->f_priv = NULL;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: irqroute_read
+ ****************************************************************************/
+
+static ssize_t irqroute_read(FAR struct file *filep, FAR char *buffer,
+                             size_t buflen)
+{
+  FAR struct irqroute_file_s *priv = filep->f_priv;
+  FAR struct irqroute_source_s *src;
+  off_t offset = filep->f_pos;
+  size_t totalsize = 0;
+  size_t linesize;
+  size_t copysize;
+  int cpu;
+  int i;
+
+  DEBUGASSERT(priv != NULL);
+
+  linesize = procfs_snprintf(priv->line, IRQROUTE_LINELEN,
+                             "%-8s %5s %5s %8s", "SOURCE", "ROUTE", "LAST",
+                             "MISROUTE");
+  for (cpu = 0; cpu < CONFIG_SMP_NCPUS; cpu++)
+    {
+      linesize += procfs_snprintf(priv->line + linesize,
+                                  IRQROUTE_LINELEN - linesize,
+                                  " %6s%d", "CPU", cpu);
+    }
+
+  linesize += procfs_snprintf(priv->line + linesize,
+                              IRQROUTE_LINELEN - linesize, "\n");
+  copysize = procfs_memcpy(priv->line, linesize, buffer, buflen, &offset);
+  totalsize += copysize;
+
+  for (i = 0; i < IRQROUTE_NSOURCES && totalsize < buflen; i++)
+    {
+      src = &g_irqroute_sources[i];
+
+      linesize = procfs_snprintf(priv->line, IRQROUTE_LINELEN,
+                                 "%-8s %5d %5d %8" PRIu32, src->name,
+                                 src->cpu, src->lastcpu, src->nmisroute);
+      for (cpu = 0; cpu < CONFIG_SMP_NCPUS; cpu++)
+        {
+          /* Interrupts attached by the arch driver are not counted */
+
+          if (src->counted)
+            {
+              linesize += procfs_snprintf(priv->line + linesize,
+                                          IRQROUTE_LINELEN - linesize,
+                                          " %7" PRIu32, src->count[cpu]);
+            }
+          else
+            {
+              linesize += procfs_snprintf(priv->line + linesize,
+                                          IRQROUTE_LINELEN - linesize,
+                                          " %7s", "-");
+            }
+        }
+
+      linesize += procfs_snprintf(priv->line + linesize,
+                                  IRQROUTE_LINELEN - linesize, "\n");
+      copysize = procfs_memcpy(priv->line, linesize, buffer + totalsize,
+                               buflen - totalsize, &offset);
+      totalsize += copysize;
+    }
+
+  filep->f_pos += totalsize;
+  return totalsize;
+}
+
+/****************************************************************************
+ * Name: irqroute_dup
+ ****************************************************************************/
+
+static int irqroute_dup(FAR const struct file *oldp, FAR struct file *newp)
+{
+  FAR struct irqroute_file_s *newpriv;
+
+  newpriv = kmm_zalloc(sizeof(struct irqroute_file_s));
+  if (newpriv == NULL)
+    {
+      return -ENOMEM;
+    }
+
+  memcpy(newpriv, oldp->f_priv, sizeof(struct irqroute_file_s));
+  newp->f_priv = newpriv;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: irqroute_stat
+ ****************************************************************************/
+
+static int irqroute_stat(FAR const char *relpath, FAR struct stat *buf)
+{
+  memset(buf, 0, sizeof(struct stat));
+  buf->st_mode = S_IFREG | S_IROTH | S_IRGRP | S_IRUSR;
+  return OK;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: esp32_irqroute_call
+ *
+ * Description:
+ *   Run 'func' on the CPU the IRQROUTE_* 'source' is routed to.  The
+ *   ESP32 connects a peripheral interrupt to the CPU that enables it, so
+ *   the enable or the driver setup is run there.  The calling thread
+ *   moves to that CPU for the duration of the call unless it already runs
+ *   on it.  From an interrupt handler 'func' runs on the current CPU and
+ *   the call is counted as misrouted.
+ *
+ * Returned Value:
+ *   The value returned by 'func', or a negated errno value if the thread
+ *   could not be moved.
+ *
+ ****************************************************************************/
+
+int esp32_irqroute_call(int source, CODE int (*func)(FAR void *arg),
+                        FAR void *arg)
+{
+  FAR struct irqroute_source_s *src;
+  cpu_set_t oldset;
+  cpu_set_t cpuset;
+  int ret;
+
+  DEBUGASSERT(source >= 0 && source < IRQROUTE_NSOURCES);
+  src = &g_irqroute_sources[source];
+
+  /* Fast path, already on the right CPU */
+
+  sched_lock();
+  if (up_interrupt_context() || up_cpu_index() == src->cpu)
+    {
+      if (up_cpu_index() != src->cpu)
+        {
+          src->nmisroute++;
+        }
+
+      src->lastcpu = up_cpu_index();
+      ret = func(arg);
+      sched_unlock();
+      return ret;
+    }
+
+  sched_unlock();
+
+  ret = nxsched_get_affinity(0, sizeof(oldset), &oldset);
+  if (ret < 0)
+    {
+      return ret;
+    }
+
+  CPU_ZERO(&cpuset);
+  CPU_SET(src->cpu, &cpuset);
+
+  ret = nxsched_set_affinity(0, sizeof(cpuset), &cpuset);
+  if (ret < 0)
+    {
+      return ret;
+    }
+
+  sched_lock();
+  DEBUGASSERT(up_cpu_index() == src->cpu);
+  src->lastcpu = up_cpu_index();
+  ret = func(arg);
+  sched_unlock();
+
+  nxsched_set_affinity(0, sizeof(oldset), &oldset);
+  return ret;
+}
+
+/****************************************************************************
+ * Name: esp32_irqroute_attach
+ *
+ * Description:
+ *   Attach 'handler' to 'irq' through a trampoline counting the
+ *   interrupts of 'source' per CPU, for /proc/irqroute.  Attaching again
+ *   to the same IRQ replaces the handler.
+ *
+ * Returned Value:
+ *   Zero (OK) is returned on success; -ENOSPC if IRQROUTE_NSLOTS IRQs
+ *   are already attached, or the error of irq_attach().
+ *
+ ****************************************************************************/
+
+int esp32_irqroute_attach(int source, int irq, xcpt_t handler,
+                          FAR void *arg)
+{
+  FAR struct irqroute_slot_s *slot = NULL;
+  irqstate_t flags;
+  int i;
+
+  DEBUGASSERT(source >= 0 && source < IRQROUTE_NSOURCES &&
+              handler != NULL);
+
+  flags = spin_lock_irqsave(&g_irqroute_lock);
+
+  for (i = 0; i < IRQROUTE_NSLOTS; i++)
+    {
+      if (g_irqroute_slots[i].handler != NULL &&
+          g_irqroute_slots[i].irq == irq)
+        {
+          slot = &g_irqroute_slots[i];
+          break;
+        }
+
+      if (g_irqroute_slots[i].handler == NULL && slot == NULL)
+        {
+          slot = &g_irqroute_slots[i];
+        }
+    }
+
+  if (slot == NULL)
+    {
+      spin_unlock_irqrestore(&g_irqroute_lock, flags);
+      return -ENOSPC;
+    }
+
+  slot->irq     = irq;
+  slot->source  = source;
+  slot->handler = handler;
+  slot->arg     = arg;
+
+  g_irqroute_sources[source].counted = true;
+
+  spin_unlock_irqrestore(&g_irqroute_lock, flags);
+
+  return irq_attach(irq, irqroute_trampoline, slot);
+}
+
+/****************************************************************************
+ * Name: esp32_irqroute_gpioenable
+ *
+ * Description:
+ *   Enable the GPIO interrupt 'irq' on the CPU of 'source'.
+ *
+ ****************************************************************************/
+
+int esp32_irqroute_gpioenable(int source, int irq, int intrtype)
+{
+  struct irqroute_gpio_s gpio;
+
+  gpio.irq      = irq;
+  gpio.intrtype = intrtype;
+
+  return esp32_irqroute_call(source, irqroute_gpioenable, &gpio);
+}
+
+/****************************************************************************
+ * Name: esp32_irqroute_initialize
+ *
+ * Description:
+ *   Register /proc/irqroute.
+ *
+ ****************************************************************************/
+
+int esp32_irqroute_initialize(void)
+{
+  return procfs_register(&g_irqroute_entry);
+}
+
+#endif /* CONFIG_BOARD_ESP32_IRQROUTE */
@@ -0,0 +1,306 @@
+/****************************************************************************
+ * boards/xtensa/esp32/esp32-devkitc/src/esp32_lazydev.c
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <sys/types.h>
+#include <stdbool.h>
+#include <string.h>
+#include <poll.h>
+#include <errno.h>
+#include <syslog.h>
+#include <debug.h>
+
+#include <nuttx/kmalloc.h>
+#include <nuttx/mutex.h>
+#include <nuttx/fs/fs.h>
+
+#include "esp32-devkitc.h"
+
+#ifdef CONFIG_BOARD_ESP32_LAZYDEV
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+/* A device whose driver is registered on first open.  Entries are never
+ * freed: an open that looked up the proxy node before it was removed may
+ * still reach lazydev_open() later.
+ */
+
+struct lazydev_s
+{
+  FAR const char *path;      /* Path shared by the proxy and the driver */
+  CODE int (*init)(void);    /* Initializes and registers the driver */
+  mutex_t lock;              /* Serializes the initialization */
+  bool ready;                /* The real driver is registered */
+};
+
+/****************************************************************************
+ * Private Function Prototypes
+ ****************************************************************************/
+
+static int     lazydev_open(FAR struct file *filep);
+static int     lazydev_close(FAR struct file *filep);
+static ssize_t lazydev_read(FAR struct file *filep, FAR char *buffer,
+                            size_t buflen);
+static ssize_t lazydev_write(FAR struct file *filep, FAR const char *buffer,
+                             size_t buflen);
+static off_t   lazydev_seek(FAR struct file *filep, off_t offset,
+                            int whence);
+static int     lazydev_ioctl(FAR struct file *filep, int cmd,
+                             unsigned long arg);
+static int     lazydev_poll(FAR struct file *filep, FAR struct pollfd *fds,
+                            bool setup);
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+static const struct file_operations g_lazydev_fops =
+{
+  .open  = lazydev_open,
+  .close = lazydev_close,
+  .read  = lazydev_read,
+  .write = lazydev_write,
+  .seek  = lazydev_seek,
+  .ioctl = lazydev_ioctl,
+  .poll  = lazydev_poll,
+};
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: lazydev_iseager
+ *
+ * Description:
+ *   Return true if 'path' is listed in CONFIG_BOARD_ESP32_LAZYDEV_EAGER.
+ *
+ ****************************************************************************/
+
+static bool lazydev_iseager(FAR const char *path)
+{
+  FAR const char *list = CONFIG_BOARD_ESP32_LAZYDEV_EAGER;
+  size_t len = strlen(path);
+  size_t toklen;
+
+  while (*list != '\0')
+    {
+      list += strspn(list, ", ");
+      toklen = strcspn(list, ", ");
+      if (toklen == len && strncmp(list, path, len) == 0)
+        {
+          return true;
+        }
+
+      list += toklen;
+    }
+
+  return false;
+}
+
+/****************************************************************************
+ * Name: lazydev_open
+ *
+ * Description:
+ *   On the first open, replace the proxy node with the real driver.  The
+ *   file opened through the proxy keeps the proxy node and forwards every
+ *   operation to a file opened on the real driver, later opens reach the
+ *   driver directly.
+ *
+ ****************************************************************************/
+
+static int lazydev_open(FAR struct file *filep)
+{
+  FAR struct lazydev_s *dev = filep->f_inode->i_private;
+  FAR struct file *real;
+  int ret;
+
+  real = kmm_zalloc(sizeof(struct file));
+  if (real == NULL)
+    {
+      return -ENOMEM;
+    }
+
+  nxmutex_lock(&dev->lock);
+
+  if (!dev->ready)
+    {
+      /* The proxy node stays alive until this file is closed, but frees
+       * the path for the driver.
+       */
+
+      unregister_driver(dev->path);
+
+      ret = dev->init();
+      if (ret < 0)
+        {
+          syslog(LOG_ERR, "ERROR: Failed to initialize %s: %d\n",
+                 dev->path, ret);
+
+          /* Put the proxy back so that the next open retries */
+
+          register_driver(dev->path, &g_lazydev_fops, 0666, dev);
+          goto errout;
+        }
+
+      dev->ready = true;
+    }
+
+  ret = file_open(real, dev->path, filep->f_oflags);
+  if (ret < 0)
+    {
+      goto errout;
+    }
+
+  nxmutex_unlock(&dev->lock);
+
+  filep->f_priv = real;
+  return OK;
+
+errout:
+  nxmutex_unlock(&dev->lock);
+  kmm_free(real);
+  return ret;
+}
+
+/****************************************************************************
+ * Name: lazydev_close
+ ****************************************************************************/
+
+static int lazydev_close(FAR struct file *filep)
+{
+  FAR struct file *real = filep->f_priv;
+  int ret;
+
+  ret = file_close(real);
+  kmm_free(real);
+  filep->f_priv = NULL;
+  return ret;
+}
+
+/****************************************************************************
+ * Name: lazydev_read
+ ****************************************************************************/
+
+static ssize_t lazydev_read(FAR struct file *filep, FAR char *buffer,
+                            size_t buflen)
+{
+  return file_read(filep->f_priv, buffer, buflen);
+}
+
+/****************************************************************************
+ * Name: lazydev_write
+ ****************************************************************************/
+
+static ssize_t lazydev_write(FAR struct file *filep, FAR const char *buffer,
+                             size_t buflen)
+{
+  return file_write(filep->f_priv, buffer, buflen);
+}
+
+/****************************************************************************
+ * Name: lazydev_seek
+ ****************************************************************************/
+
+static off_t lazydev_seek(FAR struct file *filep, off_t offset, int whence)
+{
+  return file_seek(filep->f_priv, offset, whence);
+}
+
+/****************************************************************************
+ * Name: lazydev_ioctl
+ ****************************************************************************/
+
+static int lazydev_ioctl(FAR struct file *filep, int cmd, unsigned long arg)
+{
+  return file_ioctl(filep->f_priv, cmd, arg);
+}
+
+/****************************************************************************
+ * Name: lazydev_poll
+ ****************************************************************************/
+
+static int lazydev_poll(FAR struct file *filep, FAR struct pollfd *fds,
+                        bool setup)
+{
+  return file_poll(filep->f_priv, fds, setup);
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: esp32_lazydev_register
+ *
+ * Description:
+ *   Register a placeholder at 'path' and defer 'init', which must register
+ *   the real driver at the same path, until the device is first opened.
+ *   Devices listed in CONFIG_BOARD_ESP32_LAZYDEV_EAGER are initialized
+ *   immediately.
+ *
+ * Input Parameters:
+ *   path - Path of the device node, must stay valid
+ *   init - Function initializing the hardware and registering the driver
+ *
+ * Returned Value:
+ *   Zero (OK) is returned on success; A negated errno value is returned
+ *   to indicate the nature of any failure.
+ *
+ ****************************************************************************/
+
+int esp32_lazydev_register(FAR const char *path, CODE int (*init)(void))
+{
+  FAR struct lazydev_s *dev;
+  int ret;
+
+  if (lazydev_iseager(path))
+    {
+      return init();
+    }
+
+  dev = kmm_zalloc(sizeof(struct lazydev_s));
+  if (dev == NULL)
+    {
+      return -ENOMEM;
+    }
+
+  dev->path = path;
+  dev->init = init;
+  nxmutex_init(&dev->lock);
+
+  ret = register_driver(path, &g_lazydev_fops, 0666, dev);
+  if (ret < 0)
+    {
+      nxmutex_destroy(&dev->lock);
+      kmm_free(dev);
+    }
+
+  return ret;
+}
+
+#endif /* CONFIG_BOARD_ESP32_LAZYDEV */
@@ -71,6 +71,15 @@ int esp32_mmcsd_initialize(int minor)
       return -ENODEV;
     }
 
+#ifdef CONFIG_BOARD_ESP32_SPIARB
+  rv = esp32_spiarb_install(spi);
+  if (rv < 0)
+    {
+      mcerr("ERROR: Failed to arbitrate SPI port %d: %d\n",
+            CONFIG_NSH_MMCSDSPIPORTNO, rv);
+    }
+#endif
+
   rv = mmcsd_spislotinitialize(minor, 0, spi);
   if (rv < 0)
     {
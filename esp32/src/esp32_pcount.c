@@ -0,0 +1,344 @@
+/****************************************************************************
+ * boards/xtensa/esp32/esp32-devkitc/src/esp32_pcount.c
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <sys/types.h>
+#include <sys/param.h>
+#include <sys/stat.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <string.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <debug.h>
+
+#include <nuttx/arch.h>
+#include <nuttx/irq.h>
+#include <nuttx/kmalloc.h>
+#include <nuttx/fs/fs.h>
+#include <nuttx/fs/procfs.h>
+
+#include "esp32_rt_timer.h"
+#include "esp32-devkitc.h"
+
+#ifdef CONFIG_BOARD_ESP32_PCOUNT
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define PCOUNT_LINELEN  80
+
+#ifndef CONFIG_SMP_NCPUS
+#  define CONFIG_SMP_NCPUS 1
+#endif
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+/* Counters of one driver on one CPU, only updated by that CPU with its
+ * interrupts disabled.  A reader on the other CPU may see an update half
+ * done, which only skews one line of /proc/board.
+ */
+
+struct pcount_slot_s
+{
+  uint64_t bytes;            /* Bytes transferred */
+  uint64_t busy;             /* Time spent in the driver (us) */
+  uint32_t ntrans;           /* Transactions */
+  uint32_t nerr;             /* Failed transactions */
+  uint32_t maxlat;           /* Longest transaction (us) */
+};
+
+struct pcount_file_s
+{
+  struct procfs_file_s base;       /* Base open file structure */
+  char line[PCOUNT_LINELEN];       /* Pre-allocated buffer for lines */
+};
+
+/****************************************************************************
+ * Private Function Prototypes
+ ****************************************************************************/
+
+static int     pcount_open(FAR struct file *filep, FAR const char *relpath,
+                           int oflags, mode_t mode);
+static int     pcount_close(FAR struct file *filep);
+static ssize_t pcount_read(FAR struct file *filep, FAR char *buffer,
+                           size_t buflen);
+static int     pcount_dup(FAR const struct file *oldp,
+                          FAR struct file *newp);
+static int     pcount_stat(FAR const char *relpath, FAR struct stat *buf);
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+static struct pcount_slot_s g_pcount[CONFIG_SMP_NCPUS][PCOUNT_NIDS];
+
+/* The RT timer cannot be read before its bringup step */
+
+static bool g_pcount_ready;
+
+static FAR const char * const g_pcount_names[PCOUNT_NIDS] =
+{
+  "w5500",
+  "mmcsd",
+  "display",
+  "gpio",
+  "twai",
+};
+
+static const struct procfs_operations g_pcount_operations =
+{
+  .open  = pcount_open,
+  .close = pcount_close,
+  .read  = pcount_read,
+  .dup   = pcount_dup,
+  .stat  = pcount_stat,
+};
+
+static const struct procfs_entry_s g_pcount_entry =
+{
+  "board", &g_pcount_operations, PROCFS_FILE_TYPE
+};
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: pcount_open
+ ****************************************************************************/
+
+static int pcount_open(FAR struct file *filep, FAR const char *relpath,
+                       int oflags, mode_t mode)
+{
+  FAR struct pcount_file_s *priv;
+
+  /* This is a read-only file */
+
+  if ((oflags & O_WRONLY) != 0 || (oflags & O_RDONLY) == 0)
+    {
+      return -EACCES;
+    }
+
+  priv = kmm_zalloc(sizeof(struct pcount_file_s));
+  if (priv == NULL)
+    {
+      return -ENOMEM;
+    }
+
+  filep->f_priv = priv;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: pcount_close
+ ****************************************************************************/
+
+static int pcount_close(FAR struct file *filep)
+{
+  kmm_free(filep->f_priv);
+  filep->f_priv = NULL;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: pcount_read
+ *
+ * Description:
+ *   Report the counters of every driver, summed over the CPUs.
+ *
+ ****************************************************************************/
+
+static ssize_t pcount_read(FAR struct file *filep, FAR char *buffer,
+                           size_t buflen)
+{
+  FAR struct pcount_file_s *priv = filep->f_priv;
+  FAR struct pcount_slot_s *slot;
+  off_t offset = filep->f_pos;
+  size_t totalsize = 0;
+  size_t linesize;
+  size_t copysize;
+  uint64_t bytes;
+  uint64_t busy;
+  uint32_t ntrans;
+  uint32_t nerr;
+  uint32_t maxlat;
+  int cpu;
+  int id;
+
+  DEBUGASSERT(priv != NULL);
+
+  linesize = procfs_snprintf(priv->line, PCOUNT_LINELEN,
+                             "%-8s %12s %10s %7s %10s %12s\n",
+                             "DRIVER", "BYTES", "TRANS", "ERRORS",
+                             "MAXLAT(us)", "BUSY(us)");
+  copysize = procfs_memcpy(priv->line, linesize, buffer, buflen, &offset);
+  totalsize += copysize;
+
+  for (id = 0; id < PCOUNT_NIDS && totalsize < buflen; id++)
+    {
+      bytes  = 0;
+      busy   = 0;
+      ntrans = 0;
+      nerr   = 0;
+      maxlat = 0;
+
+      for (cpu = 0; cpu < CONFIG_SMP_NCPUS; cpu++)
+        {
+          slot    = &g_pcount[cpu][id];
+          bytes  += slot->bytes;
+          busy   += slot->busy;
+          ntrans += slot->ntrans;
+          nerr   += slot->nerr;
+          maxlat  = MAX(maxlat, slot->maxlat);
+        }
+
+      linesize = procfs_snprintf(priv->line, PCOUNT_LINELEN,
+                                 "%-8s %12" PRIu64 " %10" PRIu32
+                                 " %7" PRIu32 " %10" PRIu32
+                                 " %12" PRIu64 "\n",
+                                 g_pcount_names[id], bytes, ntrans, nerr,
+                                 maxlat, busy);
+      copysize = procfs_memcpy(priv->line, linesize, buffer + totalsize,
+                               buflen - totalsize, &offset);
+      totalsize += copysize;
+    }
+
+  filep->f_pos += totalsize;
+  return totalsize;
+}
+
+/****************************************************************************
+ * Name: pcount_dup
+ ****************************************************************************/
+
+static int pcount_dup(FAR const struct file *oldp, FAR struct file *newp)
+{
+  FAR struct pcount_file_s *newpriv;
+
+  newpriv = kmm_zalloc(sizeof(struct pcount_file_s));
+  if (newpriv == NULL)
+    {
+      return -ENOMEM;
+    }
+
+  memcpy(newpriv, oldp->f_priv, sizeof(struct pcount_file_s));
+  newp->f_priv = newpriv;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: pcount_stat
+ ****************************************************************************/
+
+static int pcount_stat(FAR const char *relpath, FAR struct stat *buf)
+{
+  memset(buf, 0, sizeof(struct stat));
+  buf->st_mode = S_IFREG | S_IROTH | S_IRGRP | S_IRUSR;
+  return OK;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: esp32_pcount_initialize
+ *
+ * Description:
+ *   Register /proc/board.
+ *
+ ****************************************************************************/
+
+int esp32_pcount_initialize(void)
+{
+  g_pcount_ready = true;
+  return procfs_register(&g_pcount_entry);
+}
+
+/****************************************************************************
+ * Name: esp32_pcount_begin
+ *
+ * Description:
+ *   Return the start time of a transaction, to pass to esp32_pcount_end().
+ *
+ ****************************************************************************/
+
+uint64_t esp32_pcount_begin(void)
+{
+  return g_pcount_ready ? esp32_rt_timer_time_us() : 0;
+}
+
+/****************************************************************************
+ * Name: esp32_pcount_end
+ *
+ * Description:
+ *   Account a transaction of the PCOUNT_* driver 'id' that started at
+ *   'start', as returned by esp32_pcount_begin(), moved 'nbytes' and
+ *   returned 'ret'.  Callable from interrupt handlers.  The time comes
+ *   from the RT timer, which all CPUs share and which runs at the same
+ *   rate whatever the CPU frequency, so a thread may move to the other
+ *   CPU in the middle of a transaction.
+ *
+ ****************************************************************************/
+
+void esp32_pcount_end(int id, uint64_t start, size_t nbytes, int ret)
+{
+  FAR struct pcount_slot_s *slot;
+  irqstate_t flags;
+  uint32_t lat;
+
+  DEBUGASSERT(id >= 0 && id < PCOUNT_NIDS);
+
+  /* Transactions started before the counters were ready are not timed */
+
+  lat = start != 0 ? (uint32_t)(esp32_rt_timer_time_us() - start) : 0;
+
+  /* Stay on this CPU while its slot is updated */
+
+  flags = up_irq_save();
+  slot  = &g_pcount[up_cpu_index()][id];
+
+  slot->bytes += nbytes;
+  slot->busy  += lat;
+  slot->ntrans++;
+
+  if (ret < 0)
+    {
+      slot->nerr++;
+    }
+
+  if (lat > slot->maxlat)
+    {
+      slot->maxlat = lat;
+    }
+
+  up_irq_restore(flags);
+}
+
+#endif /* CONFIG_BOARD_ESP32_PCOUNT */
@@ -0,0 +1,80 @@
+/****************************************************************************
+ * boards/xtensa/esp32/esp32-devkitc/src/esp32_reclaim.c
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <sys/types.h>
+#include <stdint.h>
+#include <syslog.h>
+#include <debug.h>
+
+#include <nuttx/mm/mm.h>
+#include <arch/esp32/memory_layout.h>
+
+#include "esp32-devkitc.h"
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+static size_t g_reclaim_bytes;         /* Bytes given to the heap */
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: esp32_reclaim
+ *
+ * Description:
+ *   Give the heap the memory used by the ROM code while the APP CPU
+ *   starts.  Called once, after nx_smp_start() and before the bringup
+ *   steps allocate.
+ *
+ ****************************************************************************/
+
+void esp32_reclaim(void)
+{
+#ifdef CONFIG_SMP
+  size_t size = HEAP_REGION_ROMAPP_END - HEAP_REGION_ROMAPP_START;
+
+  umm_addregion((FAR void *)HEAP_REGION_ROMAPP_START, size);
+  g_reclaim_bytes = size;
+
+  syslog(LOG_INFO, "Reclaimed %zu bytes of ROM app data\n", size);
+#endif
+}
+
+/****************************************************************************
+ * Name: esp32_reclaim_bytes
+ *
+ * Description:
+ *   Return the number of bytes reclaimed.
+ *
+ ****************************************************************************/
+
+size_t esp32_reclaim_bytes(void)
+{
+  return g_reclaim_bytes;
+}
@@ -31,6 +31,13 @@
 #include <nuttx/board.h>
 
 #include "esp32_systemreset.h"
+#include "esp32-devkitc.h"
+
+/* The reboot status must be printed before the reset, not deferred by
+ * BOARD_ESP32_BLOG.
+ */
+
+#undef syslog
 
 #ifdef CONFIG_BOARDCTL_RESET
 
@@ -70,12 +77,24 @@ int board_reset(int status)
     {
       case EXIT_SUCCESS:
         up_shutdown_handler();
+#ifdef CONFIG_BOARD_ESP32_WARMBOOT
+        esp32_warmboot_commit();
+#endif
         break;
 
       case CONFIG_BOARD_ASSERT_RESET_VALUE:
+
+        /* The saved device state may be what made the system fail */
+
+#ifdef CONFIG_BOARD_ESP32_WARMBOOT
+        esp32_warmboot_invalidate();
+#endif
         break;
 
       default:
+#ifdef CONFIG_BOARD_ESP32_WARMBOOT
+        esp32_warmboot_commit();
+#endif
         break;
     }
 
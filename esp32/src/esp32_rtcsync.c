@@ -0,0 +1,511 @@
+/****************************************************************************
+ * boards/xtensa/esp32/esp32-devkitc/src/esp32_rtcsync.c
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <sys/types.h>
+#include <sys/param.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <syslog.h>
+#include <time.h>
+#include <errno.h>
+#include <debug.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+#include <nuttx/arch.h>
+#include <nuttx/clock.h>
+#include <nuttx/compiler.h>
+#include <nuttx/crc32.h>
+#include <nuttx/kthread.h>
+#include <nuttx/signal.h>
+#include <nuttx/net/net.h>
+
+#include "esp32-devkitc.h"
+
+#ifdef CONFIG_BOARD_ESP32_RTCSYNC
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define RTCSYNC_MAGIC      0x52545353 /* "RTSS" */
+
+#define RTCSYNC_IPADDR     CONFIG_BOARD_ESP32_RTCSYNC_IPADDR
+
+#define RTCSYNC_MINPOLL    CONFIG_BOARD_ESP32_RTCSYNC_MINPOLL_S
+#define RTCSYNC_MAXPOLL    CONFIG_BOARD_ESP32_RTCSYNC_MAXPOLL_S
+#define RTCSYNC_RETRY      CONFIG_BOARD_ESP32_RTCSYNC_RETRY_S
+#define RTCSYNC_CORR       CONFIG_BOARD_ESP32_RTCSYNC_CORR_S
+#define RTCSYNC_TOLERANCE  (CONFIG_BOARD_ESP32_RTCSYNC_TOLERANCE_MS * 1000)
+
+/* Frequency corrections beyond this are taken as a bad sample */
+
+#define RTCSYNC_MAXPPB     500000
+
+/* Seconds from the NTP era (1900) to the Unix epoch (1970) */
+
+#define NTP_EPOCH_OFFSET   2208988800u
+
+#define NTP_PORT           123
+#define NTP_PKTLEN         48
+#define NTP_LI_VN_CLIENT   0x23       /* LI 0, version 4, mode 3 */
+#define NTP_MODE_MASK      0x07
+#define NTP_MODE_SERVER    4
+
+/* RTC slow memory that the startup code leaves untouched, so that the
+ * frequency correction survives resets and deep sleep.  The CRC rejects
+ * it after a power-on reset.
+ */
+
+#define RTCSYNC_NOINIT     locate_data(".rtc_noinit")
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+struct rtcsync_rtc_s
+{
+  uint32_t magic;            /* RTCSYNC_MAGIC if valid */
+  uint32_t crc;              /* CRC-32 of the rest */
+  int32_t  ppb;              /* RTC rate error, positive if it gains */
+  uint32_t poll;             /* Seconds between syncs */
+  uint32_t nsyncs;           /* Successful syncs */
+  uint32_t reserved;
+  int64_t  lastsync;         /* RTC time of the last sync (us) */
+  int64_t  lastcorr;         /* RTC time of the last correction (us) */
+  int64_t  lastup;           /* Uptime of the last correction (us) */
+  int64_t  slept;            /* Time asleep since the last sync (us) */
+  int64_t  pending;          /* Correction not applied yet (ns) */
+};
+
+/* NTP packet, all fields in network order */
+
+begin_packed_struct struct ntp_pkt_s
+{
+  uint8_t  li_vn_mode;
+  uint8_t  stratum;
+  int8_t   poll;
+  int8_t   precision;
+  uint32_t rootdelay;
+  uint32_t rootdisp;
+  uint32_t refid;
+  uint32_t reftime[2];
+  uint32_t origtime[2];      /* T1, copied back by the server */
+  uint32_t recvtime[2];      /* T2 */
+  uint32_t xmittime[2];      /* T3 */
+} end_packed_struct;
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+static struct rtcsync_rtc_s g_rtcsync RTCSYNC_NOINIT;
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: rtcsync_crc
+ ****************************************************************************/
+
+static uint32_t rtcsync_crc(void)
+{
+  return crc32((FAR const uint8_t *)&g_rtcsync.ppb,
+               sizeof(g_rtcsync) - offsetof(struct rtcsync_rtc_s, ppb));
+}
+
+/****************************************************************************
+ * Name: rtcsync_now / rtcsync_uptime / rtcsync_step
+ *
+ * Description:
+ *   Read the RTC or the time since boot in microseconds, or move the RTC
+ *   by 'delta'.  CLOCK_REALTIME runs from the system tick once set, so
+ *   the RTC itself is read to see its drift, and the rate corrections go
+ *   to the RTC alone.  A sync ('sysclk') sets CLOCK_REALTIME to the same
+ *   time.
+ *
+ *   With RTC_HIRES the RTC reads the RT timer, which runs from the main
+ *   crystal, plus an offset.  The slow clock only keeps the time while
+ *   the RT timer is stopped, in deep sleep, so that is where its rate
+ *   error shows.
+ *
+ ****************************************************************************/
+
+static int64_t rtcsync_now(void)
+{
+  struct timespec ts;
+
+  up_rtc_gettime(&ts);
+  return (int64_t)ts.tv_sec * USEC_PER_SEC + ts.tv_nsec / NSEC_PER_USEC;
+}
+
+static int64_t rtcsync_uptime(void)
+{
+  struct timespec ts;
+
+  clock_systime_timespec(&ts);
+  return (int64_t)ts.tv_sec * USEC_PER_SEC + ts.tv_nsec / NSEC_PER_USEC;
+}
+
+static int64_t rtcsync_step(int64_t delta, bool sysclk)
+{
+  struct timespec ts;
+  int64_t us;
+
+  us = rtcsync_now() + delta;
+
+  ts.tv_sec  = us / USEC_PER_SEC;
+  ts.tv_nsec = (us % USEC_PER_SEC) * NSEC_PER_USEC;
+  up_rtc_settime(&ts);
+
+  if (sysclk)
+    {
+      clock_settime(CLOCK_REALTIME, &ts);
+    }
+
+  return us;
+}
+
+/****************************************************************************
+ * Name: ntp_to_us / us_to_ntp
+ ****************************************************************************/
+
+static int64_t ntp_to_us(FAR const uint32_t *ntp)
+{
+  uint32_t sec = NTOHL(ntp[0]) - NTP_EPOCH_OFFSET;
+  uint64_t frac = NTOHL(ntp[1]);
+
+  return (int64_t)sec * USEC_PER_SEC +
+         (int64_t)((frac * USEC_PER_SEC) >> 32);
+}
+
+static void us_to_ntp(int64_t us, FAR uint32_t *ntp)
+{
+  uint64_t frac = (uint64_t)(us % USEC_PER_SEC) << 32;
+
+  ntp[0] = HTONL((uint32_t)(us / USEC_PER_SEC) + NTP_EPOCH_OFFSET);
+  ntp[1] = HTONL((uint32_t)(frac / USEC_PER_SEC));
+}
+
+/****************************************************************************
+ * Name: rtcsync_query
+ *
+ * Description:
+ *   Ask the server for the time once.  On success return the offset of the
+ *   server clock from the RTC and the round trip delay, in microseconds.
+ *
+ ****************************************************************************/
+
+static int rtcsync_query(FAR int64_t *offset, FAR int64_t *delay)
+{
+  struct ntp_pkt_s pkt;
+  struct sockaddr_in addr;
+  struct socket sock;
+  struct timeval tv;
+  uint32_t xmit[2];
+  int64_t t1;
+  int64_t t2;
+  int64_t t3;
+  int64_t t4;
+  ssize_t nbytes;
+  int ret;
+
+  ret = psock_socket(AF_INET, SOCK_DGRAM, 0, &sock);
+  if (ret < 0)
+    {
+      return ret;
+    }
+
+  tv.tv_sec  = CONFIG_BOARD_ESP32_RTCSYNC_TIMEOUT_MS / 1000;
+  tv.tv_usec = (CONFIG_BOARD_ESP32_RTCSYNC_TIMEOUT_MS % 1000) * 1000;
+  psock_setsockopt(&sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+  addr.sin_family      = AF_INET;
+  addr.sin_port        = HTONS(NTP_PORT);
+  addr.sin_addr.s_addr = HTONL(RTCSYNC_IPADDR);
+
+  memset(&pkt, 0, sizeof(pkt));
+  pkt.li_vn_mode = NTP_LI_VN_CLIENT;
+
+  t1 = rtcsync_now();
+  us_to_ntp(t1, pkt.xmittime);
+  memcpy(xmit, pkt.xmittime, sizeof(xmit));
+
+  nbytes = psock_sendto(&sock, &pkt, NTP_PKTLEN, 0,
+                        (FAR const struct sockaddr *)&addr, sizeof(addr));
+  if (nbytes < 0)
+    {
+      ret = (int)nbytes;
+      goto errout;
+    }
+
+  nbytes = psock_recvfrom(&sock, &pkt, NTP_PKTLEN, 0, NULL, NULL);
+  t4 = rtcsync_now();
+
+  if (nbytes < 0)
+    {
+      ret = (int)nbytes;
+      goto errout;
+    }
+
+  /* Only take a server reply to this very request from a synchronized
+   * server, as RFC 4330 asks of SNTP clients.
+   */
+
+  if (nbytes < NTP_PKTLEN ||
+      (pkt.li_vn_mode & NTP_MODE_MASK) != NTP_MODE_SERVER ||
+      pkt.stratum == 0 || pkt.stratum > 15 ||
+      memcmp(pkt.origtime, xmit, sizeof(xmit)) != 0 ||
+      pkt.xmittime[0] == 0)
+    {
+      ret = -EPROTO;
+      goto errout;
+    }
+
+  t2 = ntp_to_us(pkt.recvtime);
+  t3 = ntp_to_us(pkt.xmittime);
+
+  *offset = ((t2 - t1) + (t3 - t4)) / 2;
+  *delay  = (t4 - t1) - (t3 - t2);
+  ret     = OK;
+
+errout:
+  psock_close(&sock);
+  return ret;
+}
+
+/****************************************************************************
+ * Name: rtcsync_sync
+ *
+ * Description:
+ *   Step the RTC and the system clock to the server time and refine the
+ *   frequency correction of the RTC from the offset that built up since
+ *   the last sync, which is what the current correction failed to remove
+ *   from the time spent asleep.
+ *   The poll interval grows while the offsets stay within the tolerance
+ *   and shrinks otherwise.
+ *
+ ****************************************************************************/
+
+static int rtcsync_sync(void)
+{
+  FAR struct rtcsync_rtc_s *st = &g_rtcsync;
+  int64_t offset;
+  int64_t delay;
+  int64_t error;
+  int64_t now;
+  int ret;
+
+  ret = rtcsync_query(&offset, &delay);
+  if (ret < 0)
+    {
+      return ret;
+    }
+
+  now = rtcsync_step(offset, true);
+
+  if (st->nsyncs > 0 &&
+      st->slept >= (int64_t)RTCSYNC_MINPOLL * USEC_PER_SEC)
+    {
+      /* A negative offset means that the RTC still gains */
+
+      error = -offset * 1000000000 / st->slept;
+      if (error > -RTCSYNC_MAXPPB && error < RTCSYNC_MAXPPB)
+        {
+          st->ppb += (int32_t)(st->nsyncs == 1 ? error : error / 2);
+          st->ppb  = MAX(MIN(st->ppb, RTCSYNC_MAXPPB), -RTCSYNC_MAXPPB);
+        }
+    }
+
+  if (offset > -RTCSYNC_TOLERANCE && offset < RTCSYNC_TOLERANCE)
+    {
+      st->poll = MIN(st->poll * 2, RTCSYNC_MAXPOLL);
+    }
+  else
+    {
+      st->poll = MAX(st->poll / 2, RTCSYNC_MINPOLL);
+    }
+
+  st->nsyncs++;
+  st->lastsync = now;
+  st->lastcorr = now;
+  st->lastup   = rtcsync_uptime();
+  st->slept    = 0;
+  st->pending  = 0;
+  st->crc      = rtcsync_crc();
+
+  syslog(LOG_INFO, "rtcsync: offset %" PRId64 " us, delay %" PRId64
+         " us, rate %" PRId32 " ppb, next in %" PRIu32 " s\n",
+         offset, delay, st->ppb, st->poll);
+  return OK;
+}
+
+/****************************************************************************
+ * Name: rtcsync_correct
+ *
+ * Description:
+ *   Take the frequency error out of the time spent asleep since the last
+ *   correction by moving the RTC.  That is the RTC time elapsed less the
+ *   time the system ran, which the RT timer kept.  The system clock is
+ *   set from the RTC at the next boot or wake.  Corrections below a
+ *   microsecond are carried over.
+ *
+ ****************************************************************************/
+
+static void rtcsync_correct(void)
+{
+  FAR struct rtcsync_rtc_s *st = &g_rtcsync;
+  int64_t slept;
+  int64_t step;
+  int64_t now;
+  int64_t up;
+
+  now   = rtcsync_now();
+  up    = rtcsync_uptime();
+  slept = (now - st->lastcorr) - (up - st->lastup);
+
+  st->lastup = up;
+
+  if (slept <= 0)
+    {
+      st->lastcorr = now;
+      st->crc      = rtcsync_crc();
+      return;
+    }
+
+  st->slept   += slept;
+  st->pending -= slept * st->ppb / 1000000;
+  step         = st->pending / 1000;
+
+  if (step != 0)
+    {
+      now          = rtcsync_step(step, false);
+      st->pending -= step * 1000;
+    }
+
+  st->lastcorr = now;
+  st->crc      = rtcsync_crc();
+}
+
+/****************************************************************************
+ * Name: rtcsync_thread
+ ****************************************************************************/
+
+static int rtcsync_thread(int argc, FAR char *argv[])
+{
+  FAR struct rtcsync_rtc_s *st = &g_rtcsync;
+  int64_t due;
+  int ret;
+
+  for (; ; )
+    {
+      rtcsync_correct();
+
+      due = st->lastsync + (int64_t)st->poll * USEC_PER_SEC;
+      if (st->nsyncs == 0 || rtcsync_now() >= due)
+        {
+          ret = rtcsync_sync();
+          if (ret < 0)
+            {
+              /* Most likely the network is not up yet */
+
+              ninfo("SNTP query failed: %d\n", ret);
+              nxsig_sleep(RTCSYNC_RETRY);
+              continue;
+            }
+        }
+
+      nxsig_sleep(RTCSYNC_CORR);
+    }
+
+  return OK;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: esp32_rtcsync_initialize
+ *
+ * Description:
+ *   Take over the frequency correction kept in RTC memory and start the
+ *   discipline thread, unless no SNTP server is set.
+ *
+ ****************************************************************************/
+
+int esp32_rtcsync_initialize(void)
+{
+  FAR struct rtcsync_rtc_s *st = &g_rtcsync;
+  int pid;
+
+  if (RTCSYNC_IPADDR == 0)
+    {
+      ninfo("No SNTP server set, the RTC is not disciplined\n");
+      return OK;
+    }
+
+  if (st->magic != RTCSYNC_MAGIC || st->crc != rtcsync_crc() ||
+      st->poll < RTCSYNC_MINPOLL || st->poll > RTCSYNC_MAXPOLL)
+    {
+      memset(st, 0, sizeof(*st));
+      st->magic    = RTCSYNC_MAGIC;
+      st->poll     = RTCSYNC_MINPOLL;
+      st->lastcorr = rtcsync_now();
+      st->lastup   = rtcsync_uptime();
+    }
+  else
+    {
+      /* The time since boot starts again from zero, whatever came before
+       * the reset, deep sleep included, counts as asleep.
+       */
+
+      st->lastup = 0;
+    }
+
+  st->crc = rtcsync_crc();
+
+  pid = kthread_create("rtcsync", CONFIG_BOARD_ESP32_RTCSYNC_PRIORITY,
+                       CONFIG_BOARD_ESP32_RTCSYNC_STACKSIZE,
+                       rtcsync_thread, NULL);
+  if (pid < 0)
+    {
+      syslog(LOG_ERR, "ERROR: Failed to start the RTC sync thread: %d\n",
+             pid);
+      return pid;
+    }
+
+  return OK;
+}
+
+#endif /* CONFIG_BOARD_ESP32_RTCSYNC */
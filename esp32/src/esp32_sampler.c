@@ -0,0 +1,491 @@
+/****************************************************************************
+ * boards/xtensa/esp32/esp32-devkitc/src/esp32_sampler.c
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <sys/types.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <syslog.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <debug.h>
+
+#include <nuttx/arch.h>
+#include <nuttx/irq.h>
+#include <nuttx/kmalloc.h>
+#include <nuttx/kthread.h>
+#include <nuttx/semaphore.h>
+#include <nuttx/spinlock.h>
+#include <nuttx/fs/fs.h>
+#include <arch/board/board.h>
+
+#include "esp32_rt_timer.h"
+#include "esp32_tim.h"
+#include "esp32-devkitc.h"
+
+#ifdef CONFIG_BOARD_ESP32_SAMPLER
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define SAMPLER_TICK_US    CONFIG_BOARD_ESP32_SAMPLER_TICK_US
+#define SAMPLER_NSENSORS   CONFIG_BOARD_ESP32_SAMPLER_NSENSORS
+#define SAMPLER_NRECORDS   CONFIG_BOARD_ESP32_SAMPLER_NRECORDS
+
+/* The timer groups count the 80 MHz APB clock, prescaled to 1 MHz */
+
+#define SAMPLER_PRESCALER  80
+
+/* Bytes returned by one read of the board sensors: the MPU-6050 gives its
+ * accelerometer, temperature and gyroscope registers, the BH1750 one raw
+ * light reading.
+ */
+
+#define SAMPLER_IMU_SIZE   14
+#define SAMPLER_AMB_SIZE   2
+
+#if SAMPLER_NSENSORS > 32
+#  error "CONFIG_BOARD_ESP32_SAMPLER_NSENSORS is limited to 32"
+#endif
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+/* A registered sensor and its ring of samples.  Each record is a struct
+ * sampler_hdr_s followed by 'size' bytes, as read from the device.
+ */
+
+struct sampler_sensor_s
+{
+  FAR const char *devpath;   /* Device read for every sample */
+  struct file     filep;     /* Opened on the first sample */
+  bool            opened;
+  uint32_t        ticks;     /* Period in timer ticks */
+  uint32_t        countdown; /* Ticks left to the next sample */
+  uint64_t        due;       /* Time the pending sample was due (us) */
+  uint32_t        missed;    /* Ticks due while one was still pending */
+  uint32_t        seqno;     /* Sequence number of the next sample */
+  uint16_t        size;      /* Data bytes per sample */
+  uint16_t        reclen;    /* Header and data, rounded up */
+
+  /* Ring, written by the sampler thread and read by the device */
+
+  spinlock_t      lock;
+  sem_t           datasem;
+  unsigned int    head;      /* Next record to write */
+  unsigned int    count;     /* Records held */
+  FAR uint8_t    *ring;
+};
+
+/****************************************************************************
+ * Private Function Prototypes
+ ****************************************************************************/
+
+static ssize_t sampler_read(FAR struct file *filep, FAR char *buffer,
+                            size_t buflen);
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+static struct sampler_sensor_s g_sampler[SAMPLER_NSENSORS];
+static int g_sampler_nsensors;
+
+static FAR struct esp32_tim_dev_s *g_sampler_tim;
+static spinlock_t g_sampler_lock = SP_UNLOCKED;
+static sem_t g_sampler_sem = SEM_INITIALIZER(0);
+static volatile uint32_t g_sampler_pending;  /* One bit per due sensor */
+
+static const struct file_operations g_sampler_fops =
+{
+  .read  = sampler_read,
+};
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: sampler_isr
+ *
+ * Description:
+ *   Timer tick.  Mark the sensors whose period elapsed and wake the
+ *   sampler thread, which does the bus transfers.  A sensor still pending
+ *   from an earlier tick overran: the thread skips a sequence number for
+ *   each tick it missed.
+ *
+ ****************************************************************************/
+
+static int sampler_isr(int irq, FAR void *context, FAR void *arg)
+{
+  FAR struct sampler_sensor_s *s;
+  irqstate_t flags;
+  uint32_t pending = 0;
+  uint64_t now;
+  int i;
+
+  ESP32_TIM_ACKINT(g_sampler_tim);
+
+  now   = esp32_rt_timer_time_us();
+  flags = spin_lock_irqsave(&g_sampler_lock);
+
+  for (i = 0; i < g_sampler_nsensors; i++)
+    {
+      s = &g_sampler[i];
+      if (--s->countdown == 0)
+        {
+          if ((g_sampler_pending & (1u << i)) != 0)
+            {
+              s->missed++;
+            }
+
+          s->countdown = s->ticks;
+          s->due       = now;
+          pending     |= 1u << i;
+        }
+    }
+
+  g_sampler_pending |= pending;
+  spin_unlock_irqrestore(&g_sampler_lock, flags);
+
+  if (pending != 0)
+    {
+      nxsem_post(&g_sampler_sem);
+    }
+
+  /* The alarm has to be re-armed after every match */
+
+  ESP32_TIM_SETALRM(g_sampler_tim, true);
+  return OK;
+}
+
+/****************************************************************************
+ * Name: sampler_take
+ *
+ * Description:
+ *   Read one sample of sensor 's' into its ring, dropping the oldest
+ *   record when the ring is full.  'missed' ticks overran before it.
+ *
+ ****************************************************************************/
+
+static void sampler_take(FAR struct sampler_sensor_s *s, uint64_t due,
+                         uint32_t missed)
+{
+  FAR struct sampler_hdr_s *hdr;
+  irqstate_t flags;
+  unsigned int index;
+  ssize_t nread;
+  int ret;
+
+  s->seqno += missed;
+
+  if (!s->opened)
+    {
+      ret = file_open(&s->filep, s->devpath, O_RDONLY);
+      if (ret < 0)
+        {
+          s->seqno++;
+          return;
+        }
+
+      s->opened = true;
+    }
+
+  /* When the ring is full the oldest record, at 'head', is dropped first
+   * so that the reader does not copy it while it is overwritten.  Only
+   * this thread moves 'head'.
+   */
+
+  flags = spin_lock_irqsave(&s->lock);
+  if (s->count == SAMPLER_NRECORDS)
+    {
+      s->count--;
+    }
+
+  spin_unlock_irqrestore(&s->lock, flags);
+
+  hdr            = (FAR struct sampler_hdr_s *)&s->ring[s->head * s->reclen];
+  hdr->timestamp = esp32_rt_timer_time_us();
+  nread          = file_read(&s->filep, (FAR char *)(hdr + 1), s->size);
+
+  hdr->due       = due;
+  hdr->seqno     = s->seqno++;
+  hdr->len       = nread < 0 ? 0 : (uint16_t)nread;
+  hdr->error     = nread < 0 ? (int16_t)nread : 0;
+
+  flags = spin_lock_irqsave(&s->lock);
+
+  index   = s->head + 1;
+  s->head = index < SAMPLER_NRECORDS ? index : 0;
+  s->count++;
+
+  spin_unlock_irqrestore(&s->lock, flags);
+
+  if (nxsem_get_value(&s->datasem, &ret) == OK && ret <= 0)
+    {
+      nxsem_post(&s->datasem);
+    }
+}
+
+/****************************************************************************
+ * Name: sampler_thread
+ ****************************************************************************/
+
+static int sampler_thread(int argc, FAR char *argv[])
+{
+  irqstate_t flags;
+  uint64_t due[SAMPLER_NSENSORS];
+  uint32_t missed[SAMPLER_NSENSORS];
+  uint32_t pending;
+  int i;
+
+  for (; ; )
+    {
+      nxsem_wait_uninterruptible(&g_sampler_sem);
+
+      flags   = spin_lock_irqsave(&g_sampler_lock);
+      pending = g_sampler_pending;
+      g_sampler_pending = 0;
+
+      for (i = 0; i < g_sampler_nsensors; i++)
+        {
+          due[i]    = g_sampler[i].due;
+          missed[i] = g_sampler[i].missed;
+          g_sampler[i].missed = 0;
+        }
+
+      spin_unlock_irqrestore(&g_sampler_lock, flags);
+
+      for (i = 0; pending != 0; i++, pending >>= 1)
+        {
+          if ((pending & 1) != 0)
+            {
+              sampler_take(&g_sampler[i], due[i], missed[i]);
+            }
+        }
+    }
+
+  return OK;
+}
+
+/****************************************************************************
+ * Name: sampler_read
+ *
+ * Description:
+ *   Return as many whole records as fit in 'buffer', oldest first.  Block
+ *   for the first one unless the file was opened with O_NONBLOCK.
+ *
+ ****************************************************************************/
+
+static ssize_t sampler_read(FAR struct file *filep, FAR char *buffer,
+                            size_t buflen)
+{
+  FAR struct sampler_sensor_s *s = filep->f_inode->i_private;
+  irqstate_t flags;
+  unsigned int tail;
+  size_t nread = 0;
+  int ret;
+
+  if (buflen < s->reclen)
+    {
+      return -EINVAL;
+    }
+
+  flags = spin_lock_irqsave(&s->lock);
+
+  while (s->count == 0)
+    {
+      spin_unlock_irqrestore(&s->lock, flags);
+
+      if ((filep->f_oflags & O_NONBLOCK) != 0)
+        {
+          return -EAGAIN;
+        }
+
+      ret = nxsem_wait(&s->datasem);
+      if (ret < 0)
+        {
+          return ret;
+        }
+
+      flags = spin_lock_irqsave(&s->lock);
+    }
+
+  while (s->count > 0 && nread + s->reclen <= buflen)
+    {
+      tail = (s->head + SAMPLER_NRECORDS - s->count) % SAMPLER_NRECORDS;
+      memcpy(buffer + nread, &s->ring[tail * s->reclen], s->reclen);
+      nread += s->reclen;
+      s->count--;
+    }
+
+  spin_unlock_irqrestore(&s->lock, flags);
+  return nread;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: esp32_sampler_register
+ *
+ * Description:
+ *   Sample the device at 'devpath' every 'period_us' microseconds, a
+ *   multiple of CONFIG_BOARD_ESP32_SAMPLER_TICK_US, reading 'size' bytes
+ *   each time.  The samples are returned by /dev/sample/<name>.
+ *
+ ****************************************************************************/
+
+int esp32_sampler_register(FAR const char *name, FAR const char *devpath,
+                           uint32_t period_us, uint16_t size)
+{
+  FAR struct sampler_sensor_s *s;
+  char path[32];
+  irqstate_t flags;
+  int ret;
+
+  if (g_sampler_nsensors >= SAMPLER_NSENSORS)
+    {
+      return -ENOSPC;
+    }
+
+  if (period_us < SAMPLER_TICK_US || period_us % SAMPLER_TICK_US != 0 ||
+      size == 0)
+    {
+      return -EINVAL;
+    }
+
+  s          = &g_sampler[g_sampler_nsensors];
+  s->devpath = devpath;
+  s->ticks   = period_us / SAMPLER_TICK_US;
+  s->size    = size;
+  s->reclen  = (sizeof(struct sampler_hdr_s) + size + 7) & ~7;
+
+  s->ring = kmm_zalloc(SAMPLER_NRECORDS * s->reclen);
+  if (s->ring == NULL)
+    {
+      return -ENOMEM;
+    }
+
+  spin_lock_init(&s->lock);
+  nxsem_init(&s->datasem, 0, 0);
+
+  snprintf(path, sizeof(path), "/dev/sample/%s", name);
+  ret = register_driver(path, &g_sampler_fops, 0444, s);
+  if (ret < 0)
+    {
+      syslog(LOG_ERR, "ERROR: Failed to register %s: %d\n", path, ret);
+      nxsem_destroy(&s->datasem);
+      kmm_free(s->ring);
+      return ret;
+    }
+
+  /* Publish the sensor to the timer interrupt last */
+
+  flags        = spin_lock_irqsave(&g_sampler_lock);
+  s->countdown = s->ticks;
+  g_sampler_nsensors++;
+  spin_unlock_irqrestore(&g_sampler_lock, flags);
+
+  return OK;
+}
+
+/****************************************************************************
+ * Name: esp32_sampler_initialize
+ *
+ * Description:
+ *   Start the sampler thread and its hardware timer, then register the
+ *   board sensors enabled in the configuration.
+ *
+ ****************************************************************************/
+
+int esp32_sampler_initialize(void)
+{
+  int pid;
+  int ret;
+
+  pid = kthread_create("sampler", CONFIG_BOARD_ESP32_SAMPLER_PRIORITY,
+                       CONFIG_BOARD_ESP32_SAMPLER_STACKSIZE,
+                       sampler_thread, NULL);
+  if (pid < 0)
+    {
+      return pid;
+    }
+
+  g_sampler_tim = esp32_tim_init(SAMPLER_TIMER);
+  if (g_sampler_tim == NULL)
+    {
+      syslog(LOG_ERR, "ERROR: Failed to get the sampler timer\n");
+      return -EBUSY;
+    }
+
+  ESP32_TIM_SETPRE(g_sampler_tim, SAMPLER_PRESCALER);
+  ESP32_TIM_SETMODE(g_sampler_tim, ESP32_TIM_MODE_UP);
+  ESP32_TIM_CLEAR(g_sampler_tim);
+  ESP32_TIM_SETALRVL(g_sampler_tim, SAMPLER_TICK_US);
+  ESP32_TIM_SETARLD(g_sampler_tim, true);
+  ESP32_TIM_SETALRM(g_sampler_tim, true);
+
+  ret = ESP32_TIM_SETISR(g_sampler_tim, sampler_isr, NULL);
+  if (ret < 0)
+    {
+      esp32_tim_deinit(g_sampler_tim);
+      return ret;
+    }
+
+  ESP32_TIM_ENABLEINT(g_sampler_tim);
+  ESP32_TIM_START(g_sampler_tim);
+
+#if defined(CONFIG_BOARD_ESP32_SAMPLER_IMU_US) && \
+    CONFIG_BOARD_ESP32_SAMPLER_IMU_US > 0
+  ret = esp32_sampler_register("imu", "/dev/imu",
+                               CONFIG_BOARD_ESP32_SAMPLER_IMU_US,
+                               SAMPLER_IMU_SIZE);
+  if (ret < 0)
+    {
+      return ret;
+    }
+#endif
+
+#if defined(CONFIG_BOARD_ESP32_SAMPLER_AMB_US) && \
+    CONFIG_BOARD_ESP32_SAMPLER_AMB_US > 0
+  ret = esp32_sampler_register("amb", "/dev/amb",
+                               CONFIG_BOARD_ESP32_SAMPLER_AMB_US,
+                               SAMPLER_AMB_SIZE);
+  if (ret < 0)
+    {
+      return ret;
+    }
+#endif
+
+  return OK;
+}
+
+#endif /* CONFIG_BOARD_ESP32_SAMPLER */
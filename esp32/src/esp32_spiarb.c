@@ -0,0 +1,850 @@
+/****************************************************************************
+ * boards/xtensa/esp32/esp32-devkitc/src/esp32_spiarb.c
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <sys/types.h>
+#include <sys/param.h>
+#include <sys/stat.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <debug.h>
+
+#include <nuttx/arch.h>
+#include <nuttx/clock.h>
+#include <nuttx/irq.h>
+#include <nuttx/kmalloc.h>
+#include <nuttx/sched.h>
+#include <nuttx/spinlock.h>
+#include <nuttx/fs/fs.h>
+#include <nuttx/fs/procfs.h>
+#include <nuttx/spi/spi.h>
+
+#include "esp32-devkitc.h"
+
+#ifdef CONFIG_BOARD_ESP32_SPIARB
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define SPIARB_CHUNK    CONFIG_BOARD_ESP32_SPIARB_CHUNK
+#define SPIARB_NBUSES   2     /* SPI2 and SPI3 */
+#define SPIARB_NDEVS    4
+#define SPIARB_LINELEN  64
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+struct spiarb_stat_s
+{
+  uint32_t devid;        /* Device the statistics belong to */
+  uint32_t nacquire;     /* Bus sessions */
+  uint32_t nyield;       /* Transfers interrupted to let a waiter in */
+  clock_t  waittotal;    /* Cycles spent waiting for the bus */
+  clock_t  waitmax;      /* Longest wait, in cycles */
+};
+
+struct spiarb_s
+{
+  FAR struct spi_dev_s *dev;         /* The shared bus */
+  FAR const struct spi_ops_s *ops;   /* Operations of the bus driver */
+  struct spi_ops_s shimops;          /* Operations installed on the bus */
+  spinlock_t lock;                   /* Protects the waiter fields */
+  int        nwaiters;               /* Threads in spiarb_lock() */
+  int        hiprio;                 /* Highest priority of the waiters */
+
+  /* Current bus session, only touched by the owner */
+
+  int        ownerprio;              /* Priority of the owner */
+  clock_t    waited;                 /* Cycles the owner waited */
+  bool       accounted;              /* 'waited' added to the stats */
+  bool       selected;               /* A device is selected */
+  uint32_t   devid;                  /* Last selected device */
+#ifdef CONFIG_BOARD_ESP32_PCOUNT
+  uint64_t   pcstart;                /* Time the device was selected */
+  size_t     pcbytes;                /* Bytes moved since then */
+#endif
+  uint32_t   frequency;              /* Configuration set by the owner */
+  enum spi_mode_e mode;
+  int        nbits;
+
+  /* Configuration last programmed in the controller, zero if unknown */
+
+  uint32_t   hwfrequency;
+  uint32_t   hwactual;               /* Frequency actually obtained */
+  int        hwmode;                 /* enum spi_mode_e + 1 */
+  int        hwnbits;
+
+  struct spiarb_stat_s stats[SPIARB_NDEVS];
+};
+
+struct spiarb_file_s
+{
+  struct procfs_file_s base;       /* Base open file structure */
+  char line[SPIARB_LINELEN];       /* Pre-allocated buffer for lines */
+};
+
+/****************************************************************************
+ * Private Function Prototypes
+ ****************************************************************************/
+
+static int      spiarb_lock(FAR struct spi_dev_s *dev, bool lock);
+static void     spiarb_select(FAR struct spi_dev_s *dev, uint32_t devid,
+                              bool selected);
+static uint32_t spiarb_setfrequency(FAR struct spi_dev_s *dev,
+                                    uint32_t frequency);
+static void     spiarb_setmode(FAR struct spi_dev_s *dev,
+                               enum spi_mode_e mode);
+static void     spiarb_setbits(FAR struct spi_dev_s *dev, int nbits);
+static uint32_t spiarb_send(FAR struct spi_dev_s *dev, uint32_t wd);
+#ifdef CONFIG_SPI_EXCHANGE
+static void     spiarb_exchange(FAR struct spi_dev_s *dev,
+                                FAR const void *txbuffer,
+                                FAR void *rxbuffer, size_t nwords);
+#else
+static void     spiarb_sndblock(FAR struct spi_dev_s *dev,
+                                FAR const void *buffer, size_t nwords);
+static void     spiarb_recvblock(FAR struct spi_dev_s *dev,
+                                 FAR void *buffer, size_t nwords);
+#endif
+
+#ifdef CONFIG_FS_PROCFS_REGISTER
+static int      spiarb_open(FAR struct file *filep,
+                            FAR const char *relpath, int oflags,
+                            mode_t mode);
+static int      spiarb_close(FAR struct file *filep);
+static ssize_t  spiarb_read(FAR struct file *filep, FAR char *buffer,
+                            size_t buflen);
+static int      spiarb_dup(FAR const struct file *oldp,
+                           FAR struct file *newp);
+static int      spiarb_stat(FAR const char *relpath, FAR struct stat *buf);
+#endif
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+static struct spiarb_s g_spiarb[SPIARB_NBUSES];
+
+#ifdef CONFIG_FS_PROCFS_REGISTER
+static const struct procfs_operations g_spiarb_operations =
+{
+  .open  = spiarb_open,
+  .close = spiarb_close,
+  .read  = spiarb_read,
+  .dup   = spiarb_dup,
+  .stat  = spiarb_stat,
+};
+
+static const struct procfs_entry_s g_spiarb_entry =
+{
+  "spiarb", &g_spiarb_operations, PROCFS_FILE_TYPE
+};
+#endif
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: spiarb_getstat
+ *
+ * Description:
+ *   Return the statistics entry of 'devid', claiming a free one if needed.
+ *   Devices beyond SPIARB_NDEVS share the last entry.
+ *
+ ****************************************************************************/
+
+static FAR struct spiarb_stat_s *spiarb_getstat(FAR struct spiarb_s *arb,
+                                                uint32_t devid)
+{
+  FAR struct spiarb_stat_s *stat;
+  int i;
+
+  for (i = 0; i < SPIARB_NDEVS - 1; i++)
+    {
+      stat = &arb->stats[i];
+      if (stat->nacquire == 0)
+        {
+          stat->devid = devid;
+        }
+
+      if (stat->devid == devid)
+        {
+          return stat;
+        }
+    }
+
+  return &arb->stats[SPIARB_NDEVS - 1];
+}
+
+/****************************************************************************
+ * Name: spiarb_get
+ *
+ * Description:
+ *   Return the arbiter installed on 'dev'.
+ *
+ ****************************************************************************/
+
+static FAR struct spiarb_s *spiarb_get(FAR struct spi_dev_s *dev)
+{
+  int i;
+
+  for (i = 0; i < SPIARB_NBUSES - 1; i++)
+    {
+      if (g_spiarb[i].dev == dev)
+        {
+          break;
+        }
+    }
+
+  DEBUGASSERT(g_spiarb[i].dev == dev);
+  return &g_spiarb[i];
+}
+
+/****************************************************************************
+ * Name: spiarb_apply
+ *
+ * Description:
+ *   Program the configuration of the owner, skipping what the controller
+ *   already holds.  The mode and the width are only recorded when set and
+ *   applied together here, before the first transfer that needs them.
+ *
+ ****************************************************************************/
+
+static void spiarb_apply(FAR struct spiarb_s *arb)
+{
+  if (arb->frequency != 0 && arb->frequency != arb->hwfrequency)
+    {
+      arb->hwactual    = arb->ops->setfrequency(arb->dev, arb->frequency);
+      arb->hwfrequency = arb->frequency;
+    }
+
+  if (arb->mode + 1 != arb->hwmode)
+    {
+      arb->ops->setmode(arb->dev, arb->mode);
+      arb->hwmode = arb->mode + 1;
+    }
+
+  if (arb->nbits != arb->hwnbits)
+    {
+      arb->ops->setbits(arb->dev, arb->nbits);
+      arb->hwnbits = arb->nbits;
+    }
+}
+
+/****************************************************************************
+ * Name: spiarb_acquire
+ *
+ * Description:
+ *   Take the bus lock of the driver, announcing the priority of the caller
+ *   to the current owner while waiting.
+ *
+ ****************************************************************************/
+
+static int spiarb_acquire(FAR struct spiarb_s *arb)
+{
+  irqstate_t flags;
+  clock_t start;
+  int prio = nxsched_self()->sched_priority;
+  int ret;
+
+  flags = spin_lock_irqsave(&arb->lock);
+  arb->nwaiters++;
+  arb->hiprio = MAX(arb->hiprio, prio);
+  spin_unlock_irqrestore(&arb->lock, flags);
+
+  start = up_perf_gettime();
+  ret   = arb->ops->lock(arb->dev, true);
+
+  /* 'hiprio' is only lowered once nobody waits any more, a late lower
+   * priority waiter can at worst cause an early yield.
+   */
+
+  flags = spin_lock_irqsave(&arb->lock);
+  if (--arb->nwaiters == 0)
+    {
+      arb->hiprio = 0;
+    }
+
+  spin_unlock_irqrestore(&arb->lock, flags);
+
+  arb->ownerprio = prio;
+  arb->waited    = up_perf_gettime() - start;
+  arb->accounted = false;
+  return ret;
+}
+
+/****************************************************************************
+ * Name: spiarb_yield
+ *
+ * Description:
+ *   Between two chunks of a transfer, hand the bus to a waiting thread of
+ *   higher priority, then take it back and restore the configuration and
+ *   the selection of the interrupted device.
+ *
+ *   Only display transfers are split.  The display tolerates a pause with
+ *   its chip select released, a W5500 frame or an SD card block split
+ *   that way would be corrupted.
+ *
+ ****************************************************************************/
+
+static void spiarb_yield(FAR struct spiarb_s *arb)
+{
+  FAR struct spi_dev_s *dev = arb->dev;
+  uint32_t frequency = arb->frequency;
+  enum spi_mode_e mode = arb->mode;
+  uint32_t devid = arb->devid;
+  int nbits = arb->nbits;
+  bool selected = arb->selected;
+
+  if (devid != SPIDEV_DISPLAY(0) || arb->hiprio <= arb->ownerprio)
+    {
+      return;
+    }
+
+  spiarb_getstat(arb, devid)->nyield++;
+
+  if (selected)
+    {
+      arb->ops->select(dev, devid, false);
+    }
+
+  arb->ops->lock(dev, false);
+  spiarb_acquire(arb);
+
+  /* The other device may have reprogrammed the bus */
+
+  arb->frequency = frequency;
+  arb->mode      = mode;
+  arb->nbits     = nbits;
+  arb->devid     = devid;
+  arb->selected  = selected;
+  arb->accounted = true;
+
+  spiarb_apply(arb);
+
+  if (selected)
+    {
+      arb->ops->select(dev, devid, true);
+    }
+}
+
+/****************************************************************************
+ * Name: spiarb_chunkwords
+ ****************************************************************************/
+
+static size_t spiarb_chunkwords(FAR struct spiarb_s *arb,
+                                FAR size_t *wordsize)
+{
+  *wordsize = arb->nbits > 8 ? 2 : 1;
+  return MAX(SPIARB_CHUNK / *wordsize, 1);
+}
+
+/****************************************************************************
+ * Name: spiarb_lock
+ ****************************************************************************/
+
+static int spiarb_lock(FAR struct spi_dev_s *dev, bool lock)
+{
+  FAR struct spiarb_s *arb = spiarb_get(dev);
+
+  if (lock)
+    {
+      return spiarb_acquire(arb);
+    }
+
+  arb->selected = false;
+  return arb->ops->lock(dev, false);
+}
+
+/****************************************************************************
+ * Name: spiarb_pcount
+ *
+ * Description:
+ *   Account the bytes moved while 'devid' was selected to its driver
+ *   counters in /proc/board.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32_PCOUNT
+static void spiarb_pcount(FAR struct spiarb_s *arb, uint32_t devid)
+{
+  int id;
+
+  switch (devid)
+    {
+      case SPIDEV_ETHERNET(0):
+        id = PCOUNT_W5500;
+        break;
+
+      case SPIDEV_MMCSD(0):
+        id = PCOUNT_MMCSD;
+        break;
+
+      case SPIDEV_DISPLAY(0):
+        id = PCOUNT_DISPLAY;
+        break;
+
+      default:
+        return;
+    }
+
+  esp32_pcount_end(id, arb->pcstart, arb->pcbytes, OK);
+}
+#endif
+
+/****************************************************************************
+ * Name: spiarb_select
+ ****************************************************************************/
+
+static void spiarb_select(FAR struct spi_dev_s *dev, uint32_t devid,
+                          bool selected)
+{
+  FAR struct spiarb_s *arb = spiarb_get(dev);
+  FAR struct spiarb_stat_s *stat;
+
+  if (selected && !arb->accounted)
+    {
+      stat = spiarb_getstat(arb, devid);
+      stat->nacquire++;
+      stat->waittotal += arb->waited;
+      stat->waitmax    = MAX(stat->waitmax, arb->waited);
+      arb->accounted   = true;
+    }
+
+  if (selected)
+    {
+      spiarb_apply(arb);
+    }
+
+#ifdef CONFIG_BOARD_ESP32_PCOUNT
+  if (selected && !arb->selected)
+    {
+      arb->pcstart = esp32_pcount_begin();
+      arb->pcbytes = 0;
+    }
+  else if (!selected && arb->selected)
+    {
+      spiarb_pcount(arb, devid);
+    }
+#endif
+
+  arb->devid    = devid;
+  arb->selected = selected;
+  arb->ops->select(dev, devid, selected);
+
+#ifdef CONFIG_BOARD_ESP32_BTRACE
+  if (selected)
+    {
+      esp32_btrace_begin(devid == SPIDEV_DISPLAY(0) ?
+                         BTRACE_LCD : BTRACE_SPI, devid);
+    }
+  else
+    {
+      esp32_btrace_end(devid == SPIDEV_DISPLAY(0) ?
+                       BTRACE_LCD : BTRACE_SPI, devid);
+    }
+#endif
+}
+
+/****************************************************************************
+ * Name: spiarb_setfrequency / spiarb_setmode / spiarb_setbits
+ *
+ * Description:
+ *   Record the configuration of the owner, see spiarb_apply().  The
+ *   frequency is applied at once since the caller wants the frequency
+ *   actually obtained, unless the controller already runs at it.
+ *
+ ****************************************************************************/
+
+static uint32_t spiarb_setfrequency(FAR struct spi_dev_s *dev,
+                                    uint32_t frequency)
+{
+  FAR struct spiarb_s *arb = spiarb_get(dev);
+
+  arb->frequency = frequency;
+  spiarb_apply(arb);
+  return arb->hwactual;
+}
+
+static void spiarb_setmode(FAR struct spi_dev_s *dev, enum spi_mode_e mode)
+{
+  spiarb_get(dev)->mode = mode;
+}
+
+static void spiarb_setbits(FAR struct spi_dev_s *dev, int nbits)
+{
+  spiarb_get(dev)->nbits = nbits;
+}
+
+/****************************************************************************
+ * Name: spiarb_send
+ ****************************************************************************/
+
+static uint32_t spiarb_send(FAR struct spi_dev_s *dev, uint32_t wd)
+{
+  FAR struct spiarb_s *arb = spiarb_get(dev);
+
+  spiarb_apply(arb);
+#ifdef CONFIG_BOARD_ESP32_PCOUNT
+  arb->pcbytes += arb->nbits > 8 ? 2 : 1;
+#endif
+  return arb->ops->send(dev, wd);
+}
+
+#ifdef CONFIG_SPI_EXCHANGE
+
+/****************************************************************************
+ * Name: spiarb_exchange
+ ****************************************************************************/
+
+static void spiarb_exchange(FAR struct spi_dev_s *dev,
+                            FAR const void *txbuffer, FAR void *rxbuffer,
+                            size_t nwords)
+{
+  FAR struct spiarb_s *arb = spiarb_get(dev);
+  FAR const uint8_t *tx = txbuffer;
+  FAR uint8_t *rx = rxbuffer;
+  size_t wordsize;
+  size_t chunk = spiarb_chunkwords(arb, &wordsize);
+  size_t n;
+
+  spiarb_apply(arb);
+#ifdef CONFIG_BOARD_ESP32_PCOUNT
+  arb->pcbytes += nwords * wordsize;
+#endif
+
+  for (; ; )
+    {
+      n = MIN(nwords, chunk);
+      arb->ops->exchange(dev, tx, rx, n);
+
+      nwords -= n;
+      if (nwords == 0)
+        {
+          break;
+        }
+
+      tx = tx != NULL ? tx + n * wordsize : NULL;
+      rx = rx != NULL ? rx + n * wordsize : NULL;
+      spiarb_yield(arb);
+    }
+}
+
+#else
+
+/****************************************************************************
+ * Name: spiarb_sndblock
+ ****************************************************************************/
+
+static void spiarb_sndblock(FAR struct spi_dev_s *dev,
+                            FAR const void *buffer, size_t nwords)
+{
+  FAR struct spiarb_s *arb = spiarb_get(dev);
+  FAR const uint8_t *tx = buffer;
+  size_t wordsize;
+  size_t chunk = spiarb_chunkwords(arb, &wordsize);
+  size_t n;
+
+  spiarb_apply(arb);
+#ifdef CONFIG_BOARD_ESP32_PCOUNT
+  arb->pcbytes += nwords * wordsize;
+#endif
+
+  for (; ; )
+    {
+      n = MIN(nwords, chunk);
+      arb->ops->sndblock(dev, tx, n);
+
+      nwords -= n;
+      if (nwords == 0)
+        {
+          break;
+        }
+
+      tx += n * wordsize;
+      spiarb_yield(arb);
+    }
+}
+
+/****************************************************************************
+ * Name: spiarb_recvblock
+ ****************************************************************************/
+
+static void spiarb_recvblock(FAR struct spi_dev_s *dev, FAR void *buffer,
+                             size_t nwords)
+{
+  FAR struct spiarb_s *arb = spiarb_get(dev);
+  FAR uint8_t *rx = buffer;
+  size_t wordsize;
+  size_t chunk = spiarb_chunkwords(arb, &wordsize);
+  size_t n;
+
+  spiarb_apply(arb);
+#ifdef CONFIG_BOARD_ESP32_PCOUNT
+  arb->pcbytes += nwords * wordsize;
+#endif
+
+  for (; ; )
+    {
+      n = MIN(nwords, chunk);
+      arb->ops->recvblock(dev, rx, n);
+
+      nwords -= n;
+      if (nwords == 0)
+        {
+          break;
+        }
+
+      rx += n * wordsize;
+      spiarb_yield(arb);
+    }
+}
+
+#endif /* CONFIG_SPI_EXCHANGE */
+
+#ifdef CONFIG_FS_PROCFS_REGISTER
+
+/****************************************************************************
+ * Name: spiarb_usec
+ ****************************************************************************/
+
+static uint32_t spiarb_usec(clock_t cycles)
+{
+  struct timespec ts;
+
+  up_perf_convert(cycles, &ts);
+  return ts.tv_sec * USEC_PER_SEC + ts.tv_nsec / NSEC_PER_USEC;
+}
+
+/****************************************************************************
+ * Name: spiarb_open
+ ****************************************************************************/
+
+static int spiarb_open(FAR struct file *filep, FAR const char *relpath,
+                       int oflags, mode_t mode)
+{
+  FAR struct spiarb_file_s *priv;
+
+  /* This is a read-only file */
+
+  if ((oflags & O_WRONLY) != 0 || (oflags & O_RDONLY) == 0)
+    {
+      return -EACCES;
+    }
+
+  priv = kmm_zalloc(sizeof(struct spiarb_file_s));
+  if (priv == NULL)
+    {
+      return -ENOMEM;
+    }
+
+  filep->f_priv = priv;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: spiarb_close
+ ****************************************************************************/
+
+static int spiarb_close(FAR struct file *filep)
+{
+  kmm_free(filep->f_priv);
+  filep->f_priv = NULL;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: spiarb_read
+ ****************************************************************************/
+
+static ssize_t spiarb_read(FAR struct file *filep, FAR char *buffer,
+                           size_t buflen)
+{
+  FAR struct spiarb_file_s *priv = filep->f_priv;
+  FAR struct spiarb_stat_s *stat;
+  off_t offset = filep->f_pos;
+  size_t totalsize = 0;
+  size_t linesize;
+  size_t copysize;
+  int bus;
+  int i;
+
+  DEBUGASSERT(priv != NULL);
+
+  linesize = procfs_snprintf(priv->line, SPIARB_LINELEN,
+                             "%-3s %-8s %8s %8s %10s %8s\n", "BUS", "DEVID",
+                             "ACQUIRE", "YIELD", "WAIT(us)", "MAX(us)");
+  copysize = procfs_memcpy(priv->line, linesize, buffer, buflen, &offset);
+  totalsize += copysize;
+
+  for (i = 0; i < SPIARB_NBUSES * SPIARB_NDEVS && totalsize < buflen; i++)
+    {
+      bus  = i / SPIARB_NDEVS;
+      stat = &g_spiarb[bus].stats[i % SPIARB_NDEVS];
+      if (stat->nacquire == 0)
+        {
+          continue;
+        }
+
+      linesize = procfs_snprintf(priv->line, SPIARB_LINELEN,
+                                 "%-3d %08" PRIx32 " %8" PRIu32 " %8" PRIu32
+                                 " %10" PRIu32 " %8" PRIu32 "\n",
+                                 bus, stat->devid, stat->nacquire,
+                                 stat->nyield, spiarb_usec(stat->waittotal),
+                                 spiarb_usec(stat->waitmax));
+      copysize = procfs_memcpy(priv->line, linesize, buffer + totalsize,
+                               buflen - totalsize, &offset);
+      totalsize += copysize;
+    }
+
+  filep->f_pos += totalsize;
+  return totalsize;
+}
+
+/****************************************************************************
+ * Name: spiarb_dup
+ ****************************************************************************/
+
+static int spiarb_dup(FAR const struct file *oldp, FAR struct file *newp)
+{
+  FAR struct spiarb_file_s *newpriv;
+
+  newpriv = kmm_zalloc(sizeof(struct spiarb_file_s));
+  if (newpriv == NULL)
+    {
+      return -ENOMEM;
+    }
+
+  memcpy(newpriv, oldp->f_priv, sizeof(struct spiarb_file_s));
+  newp->f_priv = newpriv;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: spiarb_stat
+ ****************************************************************************/
+
+static int spiarb_stat(FAR const char *relpath, FAR struct stat *buf)
+{
+  memset(buf, 0, sizeof(struct stat));
+  buf->st_mode = S_IFREG | S_IROTH | S_IRGRP | S_IRUSR;
+  return OK;
+}
+
+#endif /* CONFIG_FS_PROCFS_REGISTER */
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: esp32_spiarb_install
+ *
+ * Description:
+ *   Put the arbiter in front of the bus 'dev'.  The SPI driver returns the
+ *   same instance to every user of the port, so the W5500 and the display
+ *   both go through the arbiter whichever installs it first.  Must be
+ *   called while no transfer is in progress.
+ *
+ * Returned Value:
+ *   Zero (OK) is returned on success; -ENODEV if 'dev' is NULL, -EBUSY if
+ *   SPIARB_NBUSES buses are already arbitrated.
+ *
+ ****************************************************************************/
+
+int esp32_spiarb_install(FAR struct spi_dev_s *dev)
+{
+  FAR struct spiarb_s *arb = NULL;
+  irqstate_t flags;
+  int i;
+
+  if (dev == NULL)
+    {
+      return -ENODEV;
+    }
+
+  flags = enter_critical_section();
+
+  for (i = 0; i < SPIARB_NBUSES; i++)
+    {
+      if (g_spiarb[i].dev == dev)
+        {
+          leave_critical_section(flags);
+          return OK;
+        }
+
+      if (g_spiarb[i].dev == NULL && arb == NULL)
+        {
+          arb = &g_spiarb[i];
+        }
+    }
+
+  if (arb == NULL)
+    {
+      leave_critical_section(flags);
+      return -EBUSY;
+    }
+
+  arb->dev       = dev;
+  arb->ops       = dev->ops;
+  arb->shimops   = *dev->ops;
+  arb->nbits     = 8;
+
+  arb->shimops.lock         = spiarb_lock;
+  arb->shimops.select       = spiarb_select;
+  arb->shimops.setfrequency = spiarb_setfrequency;
+  arb->shimops.setmode      = spiarb_setmode;
+  arb->shimops.setbits      = spiarb_setbits;
+  arb->shimops.send         = spiarb_send;
+#ifdef CONFIG_SPI_EXCHANGE
+  arb->shimops.exchange     = spiarb_exchange;
+#else
+  arb->shimops.sndblock     = spiarb_sndblock;
+  arb->shimops.recvblock    = spiarb_recvblock;
+#endif
+
+  dev->ops = &arb->shimops;
+
+  leave_critical_section(flags);
+
+#ifdef CONFIG_FS_PROCFS_REGISTER
+  if (arb == &g_spiarb[0])
+    {
+      return procfs_register(&g_spiarb_entry);
+    }
+#endif
+
+  return OK;
+}
+
+#endif /* CONFIG_BOARD_ESP32_SPIARB */
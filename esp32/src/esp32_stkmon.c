@@ -0,0 +1,610 @@
+/****************************************************************************
+ * boards/xtensa/esp32/esp32-devkitc/src/esp32_stkmon.c
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <sys/types.h>
+#include <sys/param.h>
+#include <sys/stat.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <debug.h>
+
+#include <nuttx/arch.h>
+#include <nuttx/clock.h>
+#include <nuttx/compiler.h>
+#include <nuttx/crc32.h>
+#include <nuttx/irq.h>
+#include <nuttx/kmalloc.h>
+#include <nuttx/sched.h>
+#include <nuttx/spinlock.h>
+#include <nuttx/wqueue.h>
+#include <nuttx/fs/fs.h>
+#include <nuttx/fs/procfs.h>
+
+#include "esp32-devkitc.h"
+
+#ifdef CONFIG_BOARD_ESP32_STKMON
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#if CONFIG_TASK_NAME_SIZE == 0
+#  error "The stack monitor needs CONFIG_TASK_NAME_SIZE > 0"
+#endif
+
+#ifndef CONFIG_SMP_NCPUS
+#  define CONFIG_SMP_NCPUS 1
+#endif
+
+#define STKMON_MAGIC     0x53544b4d /* "STKM" */
+#define STKMON_NAMELEN   16
+#define STKMON_NENTRIES  CONFIG_BOARD_ESP32_STKMON_NENTRIES
+#define STKMON_PERIOD    MSEC2TICK(CONFIG_BOARD_ESP32_STKMON_PERIOD_MS)
+#define STKMON_MARGIN    CONFIG_BOARD_ESP32_STKMON_MARGIN
+#define STKMON_LINELEN   96
+#define STKMON_NOOPTION  0xff
+
+/* Recommended sizes are rounded up to the stack alignment of both ABIs */
+
+#define STKMON_ALIGN(n)  (((n) + 15) & ~15)
+
+/* RTC slow memory that the startup code leaves untouched, so that the
+ * peaks survive software and watchdog resets, including the ones caused
+ * by a stack overflow.  The CRC rejects it after a power-on reset.
+ */
+
+#define STKMON_NOINIT    locate_data(".rtc_noinit")
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+/* One stack, by thread name.  Threads sharing a name share the entry. */
+
+struct stkmon_entry_s
+{
+  char     name[STKMON_NAMELEN];
+  uint32_t size;             /* Largest stack size during this boot */
+  uint32_t bootpeak;         /* Highest use during this boot */
+  uint32_t peak;             /* Highest use over all boots */
+  uint8_t  option;           /* Index in g_stkmon_options[] */
+  uint8_t  reserved[3];
+};
+
+struct stkmon_rtc_s
+{
+  uint32_t magic;            /* STKMON_MAGIC if valid */
+  uint32_t crc;              /* CRC-32 of the rest */
+  uint32_t nboots;           /* Boots since the table was cleared */
+  uint32_t nentries;
+  struct stkmon_entry_s entries[STKMON_NENTRIES];
+};
+
+/* Kconfig option that sets the size of the stacks matching 'pattern' */
+
+struct stkmon_option_s
+{
+  FAR const char *pattern;   /* Thread name, a trailing '*' matches any end */
+  FAR const char *option;
+};
+
+/* A thread stack recorded during the scheduler walk, scanned after it */
+
+struct stkmon_snap_s
+{
+  FAR struct tcb_s *tcb;
+  FAR void *base;            /* Lowest address of the stack */
+  size_t   size;
+  pid_t    pid;
+  char     name[STKMON_NAMELEN];
+};
+
+struct stkmon_snapshot_s
+{
+  int      nsnaps;
+  uint32_t nlost;            /* Threads that did not fit */
+  struct stkmon_snap_s snaps[STKMON_NENTRIES];
+};
+
+struct stkmon_file_s
+{
+  struct procfs_file_s base;       /* Base open file structure */
+  char line[STKMON_LINELEN];       /* Pre-allocated buffer for lines */
+};
+
+/****************************************************************************
+ * Private Function Prototypes
+ ****************************************************************************/
+
+static int     stkmon_open(FAR struct file *filep, FAR const char *relpath,
+                           int oflags, mode_t mode);
+static int     stkmon_close(FAR struct file *filep);
+static ssize_t stkmon_read(FAR struct file *filep, FAR char *buffer,
+                           size_t buflen);
+static int     stkmon_dup(FAR const struct file *oldp,
+                          FAR struct file *newp);
+static int     stkmon_stat(FAR const char *relpath, FAR struct stat *buf);
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+static struct stkmon_rtc_s g_stkmon STKMON_NOINIT;
+
+/* The first entry is for the idle threads, found by PID */
+
+static const struct stkmon_option_s g_stkmon_options[] =
+{
+  { NULL,        "IDLETHREAD_STACKSIZE" },
+  { "nsh_main",  "INIT_STACKSIZE" },
+  { "init",      "INIT_STACKSIZE" },
+  { "hpwork",    "SCHED_HPWORKSTACKSIZE" },
+  { "lpwork*",   "SCHED_LPWORKSTACKSIZE" },
+  { "irq*",      "ARCH_INTERRUPTSTACK" },
+  { "initstep",  "BOARD_ESP32_INITSTEPS_STACKSIZE" },
+  { "canudp_*",  "BOARD_ESP32_CANUDP_STACKSIZE" },
+  { "blog",      "BOARD_ESP32_BLOG_STACKSIZE" },
+};
+
+static spinlock_t g_stkmon_lock = SP_UNLOCKED;
+static struct work_s g_stkmon_work;
+static struct stkmon_snapshot_s g_stkmon_snapshot;
+static uint32_t g_stkmon_nlost;    /* Threads the table had no room for */
+
+static const struct procfs_operations g_stkmon_operations =
+{
+  .open  = stkmon_open,
+  .close = stkmon_close,
+  .read  = stkmon_read,
+  .dup   = stkmon_dup,
+  .stat  = stkmon_stat,
+};
+
+static const struct procfs_entry_s g_stkmon_entry =
+{
+  "stkmon", &g_stkmon_operations, PROCFS_FILE_TYPE
+};
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: stkmon_crc
+ ****************************************************************************/
+
+static uint32_t stkmon_crc(void)
+{
+  return crc32((FAR const uint8_t *)&g_stkmon.nboots,
+               sizeof(g_stkmon) - offsetof(struct stkmon_rtc_s, nboots));
+}
+
+/****************************************************************************
+ * Name: stkmon_option
+ ****************************************************************************/
+
+static uint8_t stkmon_option(FAR const char *name, bool idle)
+{
+  FAR const char *pattern;
+  size_t len;
+  int i;
+
+  if (idle)
+    {
+      return 0;
+    }
+
+  for (i = 1; i < nitems(g_stkmon_options); i++)
+    {
+      pattern = g_stkmon_options[i].pattern;
+      len     = strlen(pattern);
+
+      if (pattern[len - 1] == '*' ? strncmp(pattern, name, len - 1) == 0 :
+                                    strcmp(pattern, name) == 0)
+        {
+          return i;
+        }
+    }
+
+  return STKMON_NOOPTION;
+}
+
+/****************************************************************************
+ * Name: stkmon_update
+ *
+ * Description:
+ *   Account one stack sample.  Called with the lock held.
+ *
+ ****************************************************************************/
+
+static void stkmon_update(FAR const char *name, size_t size, size_t used,
+                          bool idle)
+{
+  FAR struct stkmon_entry_s *entry;
+  uint32_t i;
+
+  for (i = 0; i < g_stkmon.nentries; i++)
+    {
+      if (strncmp(g_stkmon.entries[i].name, name, STKMON_NAMELEN - 1) == 0)
+        {
+          break;
+        }
+    }
+
+  if (i == g_stkmon.nentries)
+    {
+      if (i == STKMON_NENTRIES)
+        {
+          g_stkmon_nlost++;
+          return;
+        }
+
+      entry = &g_stkmon.entries[g_stkmon.nentries++];
+      memset(entry, 0, sizeof(*entry));
+      strlcpy(entry->name, name, STKMON_NAMELEN);
+    }
+
+  entry           = &g_stkmon.entries[i];
+  entry->size     = MAX(entry->size, size);
+  entry->bootpeak = MAX(entry->bootpeak, used);
+  entry->peak     = MAX(entry->peak, used);
+  entry->option   = stkmon_option(name, idle);
+}
+
+/****************************************************************************
+ * Name: stkmon_collect
+ *
+ * Description:
+ *   nxsched_foreach() callback recording where the stack of one thread
+ *   is.  The walk runs in a critical section, so it only copies.
+ *
+ ****************************************************************************/
+
+static void stkmon_collect(FAR struct tcb_s *tcb, FAR void *arg)
+{
+  FAR struct stkmon_snapshot_s *snapshot = arg;
+  FAR struct stkmon_snap_s *snap;
+
+  if (snapshot->nsnaps == STKMON_NENTRIES)
+    {
+      snapshot->nlost++;
+      return;
+    }
+
+  snap       = &snapshot->snaps[snapshot->nsnaps++];
+  snap->tcb  = tcb;
+  snap->base = tcb->stack_base_ptr;
+  snap->size = tcb->adj_stack_size;
+  snap->pid  = tcb->pid;
+  strlcpy(snap->name, tcb->name, STKMON_NAMELEN);
+}
+
+/****************************************************************************
+ * Name: stkmon_check
+ *
+ * Description:
+ *   Return the bytes in use on the stack of the thread of a snapshot, or
+ *   -ESRCH if it exited or moved to another stack since.  The critical
+ *   section keeps the thread from exiting during the scan, which only
+ *   covers its own stack.
+ *
+ ****************************************************************************/
+
+static ssize_t stkmon_check(FAR const struct stkmon_snap_s *snap)
+{
+  irqstate_t flags;
+  ssize_t used = -ESRCH;
+
+  flags = enter_critical_section();
+
+  if (nxsched_get_tcb(snap->pid) == snap->tcb &&
+      snap->tcb->stack_base_ptr == snap->base)
+    {
+      used = up_check_tcbstack(snap->tcb);
+    }
+
+  leave_critical_section(flags);
+  return used;
+}
+
+#if CONFIG_ARCH_INTERRUPTSTACK > 15
+
+/****************************************************************************
+ * Name: stkmon_intstacks
+ *
+ * Description:
+ *   Sample the interrupt stack of every CPU.
+ *
+ ****************************************************************************/
+
+static void stkmon_intstacks(void)
+{
+  char name[STKMON_NAMELEN];
+  irqstate_t flags;
+  size_t used;
+  int cpu;
+
+  for (cpu = 0; cpu < CONFIG_SMP_NCPUS; cpu++)
+    {
+      used = up_check_intstack(cpu);
+      snprintf(name, sizeof(name), "irq%d", cpu);
+
+      flags = spin_lock_irqsave(&g_stkmon_lock);
+      stkmon_update(name, CONFIG_ARCH_INTERRUPTSTACK, used, false);
+      spin_unlock_irqrestore(&g_stkmon_lock, flags);
+    }
+}
+
+#endif /* CONFIG_ARCH_INTERRUPTSTACK > 15 */
+
+/****************************************************************************
+ * Name: stkmon_sample
+ *
+ * Description:
+ *   Sample every thread stack and every interrupt stack, then seal the
+ *   table for the next boot.  The stacks are only located in the
+ *   scheduler walk and scanned one at a time after it, so that no
+ *   critical section spans more than one stack.  A thread that exited in
+ *   between is skipped.
+ *
+ ****************************************************************************/
+
+static void stkmon_sample(FAR void *arg)
+{
+  FAR struct stkmon_snapshot_s *snapshot = &g_stkmon_snapshot;
+  FAR struct stkmon_snap_s *snap;
+  irqstate_t flags;
+  ssize_t used;
+  int i;
+
+  snapshot->nsnaps = 0;
+  snapshot->nlost  = 0;
+  nxsched_foreach(stkmon_collect, snapshot);
+
+  for (i = 0; i < snapshot->nsnaps; i++)
+    {
+      snap = &snapshot->snaps[i];
+      used = stkmon_check(snap);
+      if (used < 0)
+        {
+          continue;
+        }
+
+      flags = spin_lock_irqsave(&g_stkmon_lock);
+      stkmon_update(snap->name, snap->size, used,
+                    snap->pid < CONFIG_SMP_NCPUS);
+      spin_unlock_irqrestore(&g_stkmon_lock, flags);
+    }
+
+#if CONFIG_ARCH_INTERRUPTSTACK > 15
+  stkmon_intstacks();
+#endif
+
+  flags = spin_lock_irqsave(&g_stkmon_lock);
+
+  g_stkmon_nlost += snapshot->nlost;
+  g_stkmon.crc    = stkmon_crc();
+
+  spin_unlock_irqrestore(&g_stkmon_lock, flags);
+
+  work_queue(LPWORK, &g_stkmon_work, stkmon_sample, NULL, STKMON_PERIOD);
+}
+
+/****************************************************************************
+ * Name: stkmon_open
+ ****************************************************************************/
+
+static int stkmon_open(FAR struct file *filep, FAR const char *relpath,
+                       int oflags, mode_t mode)
+{
+  FAR struct stkmon_file_s *priv;
+
+  /* This is a read-only file */
+
+  if ((oflags & O_WRONLY) != 0 || (oflags & O_RDONLY) == 0)
+    {
+      return -EACCES;
+    }
+
+  priv = kmm_zalloc(sizeof(struct stkmon_file_s));
+  if (priv == NULL)
+    {
+      return -ENOMEM;
+    }
+
+  filep->f_priv = priv;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: stkmon_close
+ ****************************************************************************/
+
+static int stkmon_close(FAR struct file *filep)
+{
+  kmm_free(filep->f_priv);
+  filep->f_priv = NULL;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: stkmon_read
+ *
+ * Description:
+ *   Report the size, the peak use of this boot and of all boots, and the
+ *   recommended size of every stack, with the option that sets it.
+ *   Stacks marked '!' are smaller than recommended.
+ *
+ ****************************************************************************/
+
+static ssize_t stkmon_read(FAR struct file *filep, FAR char *buffer,
+                           size_t buflen)
+{
+  FAR struct stkmon_file_s *priv = filep->f_priv;
+  struct stkmon_entry_s entry;
+  off_t offset = filep->f_pos;
+  size_t totalsize = 0;
+  size_t linesize;
+  size_t copysize;
+  irqstate_t flags;
+  uint32_t nentries;
+  uint32_t nboots;
+  uint32_t nlost;
+  uint32_t total = 0;
+  uint32_t totalrec = 0;
+  uint32_t rec;
+  uint32_t i;
+
+  DEBUGASSERT(priv != NULL);
+
+  flags    = spin_lock_irqsave(&g_stkmon_lock);
+  nentries = g_stkmon.nentries;
+  nboots   = g_stkmon.nboots;
+  nlost    = g_stkmon_nlost;
+  spin_unlock_irqrestore(&g_stkmon_lock, flags);
+
+  linesize = procfs_snprintf(priv->line, STKMON_LINELEN,
+                             "Boots: %" PRIu32 " Margin: %d%%\n"
+                             "%-15s %6s %6s %6s %6s  %s\n",
+                             nboots, STKMON_MARGIN, "NAME", "SIZE",
+                             "USED", "PEAK", "RECOMM", "OPTION");
+  copysize = procfs_memcpy(priv->line, linesize, buffer, buflen, &offset);
+  totalsize += copysize;
+
+  for (i = 0; i < nentries && totalsize < buflen; i++)
+    {
+      flags = spin_lock_irqsave(&g_stkmon_lock);
+      entry = g_stkmon.entries[i];
+      spin_unlock_irqrestore(&g_stkmon_lock, flags);
+
+      rec       = STKMON_ALIGN(entry.peak * (100 + STKMON_MARGIN) / 100);
+      total    += entry.size;
+      totalrec += rec;
+
+      linesize = procfs_snprintf(priv->line, STKMON_LINELEN,
+                                 "%-15s %6" PRIu32 " %6" PRIu32
+                                 " %6" PRIu32 " %6" PRIu32 "%c %s\n",
+                                 entry.name, entry.size, entry.bootpeak,
+                                 entry.peak, rec,
+                                 rec > entry.size ? '!' : ' ',
+                                 entry.option < nitems(g_stkmon_options) ?
+                                 g_stkmon_options[entry.option].option :
+                                 "-");
+      copysize = procfs_memcpy(priv->line, linesize, buffer + totalsize,
+                               buflen - totalsize, &offset);
+      totalsize += copysize;
+    }
+
+  if (totalsize < buflen)
+    {
+      linesize = procfs_snprintf(priv->line, STKMON_LINELEN,
+                                 "%-15s %6" PRIu32 " %20" PRIu32 "\n"
+                                 "Untracked: %" PRIu32 "\n",
+                                 "Total", total, totalrec, nlost);
+      copysize = procfs_memcpy(priv->line, linesize, buffer + totalsize,
+                               buflen - totalsize, &offset);
+      totalsize += copysize;
+    }
+
+  filep->f_pos += totalsize;
+  return totalsize;
+}
+
+/****************************************************************************
+ * Name: stkmon_dup
+ ****************************************************************************/
+
+static int stkmon_dup(FAR const struct file *oldp, FAR struct file *newp)
+{
+  FAR struct stkmon_file_s *newpriv;
+
+  newpriv = kmm_zalloc(sizeof(struct stkmon_file_s));
+  if (newpriv == NULL)
+    {
+      return -ENOMEM;
+    }
+
+  memcpy(newpriv, oldp->f_priv, sizeof(struct stkmon_file_s));
+  newp->f_priv = newpriv;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: stkmon_stat
+ ****************************************************************************/
+
+static int stkmon_stat(FAR const char *relpath, FAR struct stat *buf)
+{
+  memset(buf, 0, sizeof(struct stat));
+  buf->st_mode = S_IFREG | S_IROTH | S_IRGRP | S_IRUSR;
+  return OK;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: esp32_stkmon_initialize
+ *
+ * Description:
+ *   Take over the peaks left in RTC memory by the previous boots, register
+ *   /proc/stkmon and start sampling.
+ *
+ ****************************************************************************/
+
+int esp32_stkmon_initialize(void)
+{
+  uint32_t i;
+
+  if (g_stkmon.magic != STKMON_MAGIC ||
+      g_stkmon.nentries > STKMON_NENTRIES ||
+      g_stkmon.crc != stkmon_crc())
+    {
+      memset(&g_stkmon, 0, sizeof(g_stkmon));
+      g_stkmon.magic = STKMON_MAGIC;
+    }
+
+  for (i = 0; i < g_stkmon.nentries; i++)
+    {
+      g_stkmon.entries[i].size     = 0;
+      g_stkmon.entries[i].bootpeak = 0;
+    }
+
+  g_stkmon.nboots++;
+  g_stkmon.crc = stkmon_crc();
+
+  stkmon_sample(NULL);
+  return procfs_register(&g_stkmon_entry);
+}
+
+#endif /* CONFIG_BOARD_ESP32_STKMON */
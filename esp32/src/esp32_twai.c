@@ -45,6 +45,49 @@
 
 #define TWAI_PORT0 0
 
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+#if defined(CONFIG_BOARD_ESP32_IRQROUTE) || defined(CONFIG_BOARD_ESP32_PCOUNT)
+static FAR const struct can_ops_s *g_twai_ops;  /* Operations of the driver */
+static struct can_ops_s g_twai_boardops;        /* Operations registered */
+#endif
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32_IRQROUTE
+static int esp32_twai_setup_call(FAR void *arg)
+{
+  return g_twai_ops->co_setup(arg);
+}
+
+/* The driver allocates its CPU interrupt on the CPU running co_setup(),
+ * which is the one of the thread opening /dev/can0.
+ */
+
+static int esp32_twai_routed_setup(FAR struct can_dev_s *dev)
+{
+  return esp32_irqroute_call(IRQROUTE_TWAI, esp32_twai_setup_call, dev);
+}
+#endif
+
+#ifdef CONFIG_BOARD_ESP32_PCOUNT
+static int esp32_twai_counted_send(FAR struct can_dev_s *dev,
+                                   FAR struct can_msg_s *msg)
+{
+  uint64_t start = esp32_pcount_begin();
+  int ret;
+
+  ret = g_twai_ops->co_send(dev, msg);
+  esp32_pcount_end(PCOUNT_TWAI, start, can_dlc2bytes(msg->cm_hdr.ch_dlc),
+                   ret);
+  return ret;
+}
+#endif
+
 /****************************************************************************
  * Public Functions
  ****************************************************************************/
@@ -74,6 +117,18 @@ int esp32_twai_setup(void)
       return -ENODEV;
     }
 
+#if defined(CONFIG_BOARD_ESP32_IRQROUTE) || defined(CONFIG_BOARD_ESP32_PCOUNT)
+  g_twai_ops      = twai->cd_ops;
+  g_twai_boardops = *twai->cd_ops;
+#ifdef CONFIG_BOARD_ESP32_IRQROUTE
+  g_twai_boardops.co_setup = esp32_twai_routed_setup;
+#endif
+#ifdef CONFIG_BOARD_ESP32_PCOUNT
+  g_twai_boardops.co_send  = esp32_twai_counted_send;
+#endif
+  twai->cd_ops    = &g_twai_boardops;
+#endif
+
   /* Register the TWAI0 driver at "/dev/can0" */
 
   ret = can_register("/dev/can0", twai);
@@ -74,6 +74,9 @@ struct esp32_lower_s
   const struct w5500_lower_s lower;    /* Low-level MCU interface */
   xcpt_t                     handler;  /* W5500 interrupt handler */
   void                      *arg;      /* Argument that accompanies IRQ */
+#ifdef CONFIG_BOARD_ESP32_IRQROUTE
+  bool                       routed;   /* Handler attached and routed */
+#endif
 };
 
 /****************************************************************************
@@ -126,6 +129,9 @@ static int up_attach(const struct w5500_lower_s *lower, xcpt_t handler,
 
   priv->handler = handler;
   priv->arg     = arg;
+#ifdef CONFIG_BOARD_ESP32_IRQROUTE
+  priv->routed  = false;
+#endif
   return OK;
 }
 
@@ -143,7 +149,22 @@ static void up_enable(const struct w5500_lower_s *lower, bool enable)
   DEBUGASSERT(priv->handler);
   if (enable)
     {
+#ifdef CONFIG_BOARD_ESP32_IRQROUTE
+      /* The driver re-enables the interrupt after each one it services.
+       * Attach and route it once, later enables only unmask the pin.
+       */
+
+      if (priv->routed)
+        {
+          esp32_gpioirqenable(irq, RISING);
+          return;
+        }
+
+      ret = esp32_irqroute_attach(IRQROUTE_W5500, irq, priv->handler,
+                                  priv->arg);
+#else
       ret = irq_attach(irq, priv->handler, priv->arg);
+#endif
       if (ret < 0)
         {
           syslog(LOG_ERR, "ERROR: irq_attach() failed: %d\n", ret);
@@ -151,7 +172,12 @@ static void up_enable(const struct w5500_lower_s *lower, bool enable)
 
       /* IRQ on rising edge */
 
+#ifdef CONFIG_BOARD_ESP32_IRQROUTE
+      esp32_irqroute_gpioenable(IRQROUTE_W5500, irq, RISING);
+      priv->routed = ret >= 0;
+#else
       esp32_gpioirqenable(irq, RISING);
+#endif
     }
   else
     {
@@ -207,6 +233,17 @@ void up_netinitialize(void)
       return;
     }
 
+#ifdef CONFIG_BOARD_ESP32_SPIARB
+  /* The display shares the port, let the W5500 preempt its transfers */
+
+  ret = esp32_spiarb_install(spi);
+  if (ret < 0)
+    {
+      nerr("ERROR: Failed to arbitrate SPI port %d: %d\n",
+           W5500_SPI_PORTNO, ret);
+    }
+#endif
+
   /* Bind the SPI port to the W5500 driver */
 
   ret = w5500_initialize(spi, &g_enclower.lower, W5500_DEVNO);
@@ -0,0 +1,283 @@
+/****************************************************************************
+ * boards/xtensa/esp32/esp32-devkitc/src/esp32_warmboot.c
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <sys/types.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <debug.h>
+
+#include <nuttx/compiler.h>
+#include <nuttx/crc32.h>
+#include <nuttx/spinlock.h>
+
+#include "esp32-devkitc.h"
+
+#ifdef CONFIG_BOARD_ESP32_WARMBOOT
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define WARMBOOT_MAGIC    0x57424f54 /* "WBOT" */
+#define WARMBOOT_VERSION  1
+#define WARMBOOT_SIZE     CONFIG_BOARD_ESP32_WARMBOOT_SIZE
+
+#define WARMBOOT_ALIGN(n) (((n) + 3) & ~3)
+
+/* RTC slow memory that the startup code leaves untouched, so that it
+ * survives software and watchdog resets.  Its content is random after a
+ * power-on reset, which the CRC rejects.
+ */
+
+#define WARMBOOT_NOINIT   locate_data(".rtc_noinit")
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+struct warmboot_s
+{
+  uint32_t magic;                /* WARMBOOT_MAGIC if committed */
+  uint16_t version;              /* WARMBOOT_VERSION */
+  uint16_t len;                  /* Bytes used in data[] */
+  uint32_t crc;                  /* CRC-32 of data[0..len) */
+  uint8_t  data[WARMBOOT_SIZE];  /* Sequence of records */
+};
+
+/* Each record is followed by its payload, padded to 4 bytes */
+
+struct warmboot_rec_s
+{
+  uint16_t id;
+  uint16_t len;
+};
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+/* Snapshot left by the previous boot, rewritten on a clean reset */
+
+static struct warmboot_s g_warmboot WARMBOOT_NOINIT;
+
+/* Records collected during this boot */
+
+static uint8_t g_warmboot_stage[WARMBOOT_SIZE];
+static size_t g_warmboot_stagelen;
+static bool g_warmboot_valid;
+static spinlock_t g_warmboot_lock = SP_UNLOCKED;
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: warmboot_find
+ *
+ * Description:
+ *   Return the offset of the record 'id' in 'data', or -ENOENT.
+ *
+ ****************************************************************************/
+
+static int warmboot_find(FAR const uint8_t *data, size_t len, uint16_t id)
+{
+  FAR const struct warmboot_rec_s *rec;
+  size_t offset = 0;
+
+  while (offset + sizeof(struct warmboot_rec_s) <= len)
+    {
+      rec = (FAR const struct warmboot_rec_s *)&data[offset];
+      if (offset + sizeof(struct warmboot_rec_s) + rec->len > len)
+        {
+          break;
+        }
+
+      if (rec->id == id)
+        {
+          return offset;
+        }
+
+      offset += sizeof(struct warmboot_rec_s) + WARMBOOT_ALIGN(rec->len);
+    }
+
+  return -ENOENT;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: esp32_warmboot_initialize
+ *
+ * Description:
+ *   Validate the snapshot left by the previous boot.  It is consumed: a
+ *   crash before the next clean reset makes the following boot cold.
+ *   Called from esp32_board_initialize(), before the bringup.
+ *
+ ****************************************************************************/
+
+void esp32_warmboot_initialize(void)
+{
+  g_warmboot_valid = g_warmboot.magic == WARMBOOT_MAGIC &&
+                     g_warmboot.version == WARMBOOT_VERSION &&
+                     g_warmboot.len <= WARMBOOT_SIZE &&
+                     g_warmboot.crc == crc32(g_warmboot.data,
+                                             g_warmboot.len);
+
+  g_warmboot.magic = 0;
+}
+
+/****************************************************************************
+ * Name: esp32_warmboot_get
+ *
+ * Description:
+ *   Look up a record saved by the previous boot.
+ *
+ * Input Parameters:
+ *   id  - Record identifier, WARMBOOT_ID_*
+ *   len - Location to return the length of the record
+ *
+ * Returned Value:
+ *   The record, or NULL after a cold boot or if it was not saved.
+ *
+ ****************************************************************************/
+
+FAR const void *esp32_warmboot_get(uint16_t id, FAR size_t *len)
+{
+  FAR const struct warmboot_rec_s *rec;
+  int offset;
+
+  if (!g_warmboot_valid)
+    {
+      return NULL;
+    }
+
+  offset = warmboot_find(g_warmboot.data, g_warmboot.len, id);
+  if (offset < 0)
+    {
+      return NULL;
+    }
+
+  rec  = (FAR const struct warmboot_rec_s *)&g_warmboot.data[offset];
+  *len = rec->len;
+  return rec + 1;
+}
+
+/****************************************************************************
+ * Name: esp32_warmboot_put
+ *
+ * Description:
+ *   Save a record for the next boot, replacing any record with the same
+ *   id saved during this boot.  Records only reach RTC memory when the
+ *   board is reset with esp32_warmboot_commit().
+ *
+ * Returned Value:
+ *   Zero (OK) is returned on success; -ENOSPC if the record does not fit
+ *   in CONFIG_BOARD_ESP32_WARMBOOT_SIZE.
+ *
+ ****************************************************************************/
+
+int esp32_warmboot_put(uint16_t id, FAR const void *data, size_t len)
+{
+  FAR struct warmboot_rec_s *rec;
+  irqstate_t flags;
+  size_t recsize;
+  int offset;
+  int ret = OK;
+
+  flags = spin_lock_irqsave(&g_warmboot_lock);
+
+  offset = warmboot_find(g_warmboot_stage, g_warmboot_stagelen, id);
+  if (offset >= 0)
+    {
+      rec     = (FAR struct warmboot_rec_s *)&g_warmboot_stage[offset];
+      recsize = sizeof(struct warmboot_rec_s) + WARMBOOT_ALIGN(rec->len);
+
+      memmove(&g_warmboot_stage[offset], &g_warmboot_stage[offset + recsize],
+              g_warmboot_stagelen - offset - recsize);
+      g_warmboot_stagelen -= recsize;
+    }
+
+  recsize = sizeof(struct warmboot_rec_s) + WARMBOOT_ALIGN(len);
+  if (len > UINT16_MAX || g_warmboot_stagelen + recsize > WARMBOOT_SIZE)
+    {
+      ret = -ENOSPC;
+    }
+  else
+    {
+      rec      = (FAR struct warmboot_rec_s *)
+                 &g_warmboot_stage[g_warmboot_stagelen];
+      rec->id  = id;
+      rec->len = len;
+      memcpy(rec + 1, data, len);
+      g_warmboot_stagelen += recsize;
+    }
+
+  spin_unlock_irqrestore(&g_warmboot_lock, flags);
+  return ret;
+}
+
+/****************************************************************************
+ * Name: esp32_warmboot_commit
+ *
+ * Description:
+ *   Write the records saved during this boot to RTC memory, so that the
+ *   next boot can use them.  Called from board_reset() on clean resets.
+ *
+ ****************************************************************************/
+
+void esp32_warmboot_commit(void)
+{
+  irqstate_t flags;
+
+  flags = spin_lock_irqsave(&g_warmboot_lock);
+
+  memcpy(g_warmboot.data, g_warmboot_stage, g_warmboot_stagelen);
+  g_warmboot.len     = g_warmboot_stagelen;
+  g_warmboot.version = WARMBOOT_VERSION;
+  g_warmboot.crc     = crc32(g_warmboot.data, g_warmboot.len);
+  g_warmboot.magic   = WARMBOOT_MAGIC;
+
+  spin_unlock_irqrestore(&g_warmboot_lock, flags);
+}
+
+/****************************************************************************
+ * Name: esp32_warmboot_invalidate
+ *
+ * Description:
+ *   Make the next boot a cold one, e.g. after an assertion.
+ *
+ ****************************************************************************/
+
+void esp32_warmboot_invalidate(void)
+{
+  g_warmboot.magic = 0;
+}
+
+#endif /* CONFIG_BOARD_ESP32_WARMBOOT */
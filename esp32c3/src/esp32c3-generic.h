@@ -26,6 +26,8 @@
  ****************************************************************************/
 
 #include <nuttx/config.h>
+#include <nuttx/compiler.h>
+#include <stdint.h>
 
 /****************************************************************************
  * Pre-processor Definitions
@@ -44,10 +46,44 @@
 #  define RMT_OUTPUT_PIN    8
 #endif
 
+/* Bringup steps */
+
+#define INITSTEP_BIT(n)     (UINT32_C(1) << (n))
+
+#define INITSTEP_BACKGROUND (1 << 0) /* NSH does not wait for the step */
+
+/* Boot profiling marks, see esp_bootprof_mark() */
+
+#define BOOTPROF_BOARD_INIT   0 /* esp_board_initialize() entered */
+#define BOOTPROF_LATE_INIT    1 /* board_late_initialize() entered */
+#define BOOTPROF_BRINGUP_DONE 2 /* Foreground bringup steps complete */
+#define BOOTPROF_NSH_START    3 /* NSH called board_app_initialize() */
+#define BOOTPROF_NMARKS       4
+
+/* CPU frequency levels, see esp_dfs_request() */
+
+#define DFS_LEVEL_80M         0
+#define DFS_LEVEL_160M        1
+#define DFS_NLEVELS           2
+
 /****************************************************************************
  * Public Types
  ****************************************************************************/
 
+#ifndef __ASSEMBLY__
+
+/* One step of the board bringup, see esp_initsteps_run() */
+
+struct esp_initstep_s
+{
+  FAR const char *name;      /* Name used in diagnostics */
+  CODE int (*init)(void);    /* NULL if compiled out */
+  uint32_t deps;             /* INITSTEP_BIT() of the steps it waits for */
+  uint8_t flags;             /* INITSTEP_* flags */
+};
+
+#endif /* __ASSEMBLY__ */
+
 /****************************************************************************
  * Public Data
  ****************************************************************************/
@@ -81,6 +117,93 @@
 
 int esp_bringup(void);
 
+/****************************************************************************
+ * Name: esp_initsteps_run
+ *
+ * Description:
+ *   Run a table of bringup steps, concurrently where their dependencies
+ *   allow it if CONFIG_BOARD_ESP32C3_INITSTEPS_PARALLEL is selected.
+ *
+ * Input Parameters:
+ *   steps  - The step table, in dependency order
+ *   nsteps - Number of entries in the table (32 at most)
+ *
+ * Returned Value:
+ *   Zero (OK) is returned on success; A negated errno value is returned
+ *   to indicate the nature of any failure.
+ *
+ ****************************************************************************/
+
+int esp_initsteps_run(FAR const struct esp_initstep_s *steps, int nsteps);
+
+/****************************************************************************
+ * Name: esp_bootprof_initialize
+ *
+ * Description:
+ *   Register /proc/boardinit, which reports the time at which each boot
+ *   phase was reached and the duration, return code and heap usage of
+ *   every bringup step.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32C3_BOOTPROF
+int esp_bootprof_initialize(void);
+#endif
+
+/****************************************************************************
+ * Name: esp_bootprof_mark
+ *
+ * Description:
+ *   Record the time at which the boot phase BOOTPROF_<mark> was reached.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32C3_BOOTPROF
+void esp_bootprof_mark(int mark);
+#endif
+
+/****************************************************************************
+ * Name: esp_bootprof_begin / esp_bootprof_end
+ *
+ * Description:
+ *   Time a bringup step.  esp_bootprof_begin() returns the handle to
+ *   pass to esp_bootprof_end() together with the result of the step.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32C3_BOOTPROF
+int esp_bootprof_begin(FAR const char *name);
+void esp_bootprof_end(int handle, int ret);
+#endif
+
+/****************************************************************************
+ * Name: esp_dfs_initialize
+ *
+ * Description:
+ *   Start the CPU frequency governor.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32C3_DFS
+int esp_dfs_initialize(void);
+#endif
+
+/****************************************************************************
+ * Name: esp_dfs_request / esp_dfs_release / esp_dfs_hold
+ *
+ * Description:
+ *   Keep the CPU at DFS_LEVEL_* 'level' or above until the matching
+ *   release, or for the next 'ms' milliseconds.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32C3_DFS
+void esp_dfs_request(int level);
+void esp_dfs_release(int level);
+void esp_dfs_hold(int level, unsigned int ms);
+int esp_dfs_freq(FAR uint32_t *nswitch);
+#endif
+
 /****************************************************************************
  * Name: board_twai_setup
  *
@@ -115,5 +238,88 @@ int board_twai_setup(void);
 int esp_gpio_init(void);
 #endif
 
+/****************************************************************************
+ * Name: esp_stkmon_initialize
+ *
+ * Description:
+ *   Start sampling the stacks and register /proc/stkmon, which shows their
+ *   peak use over the boots kept in RTC memory and a recommended size.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32C3_STKMON
+int esp_stkmon_initialize(void);
+#endif
+
+/****************************************************************************
+ * Name: esp_twdt_initialize
+ *
+ * Description:
+ *   Start the task watchdog on CONFIG_BOARD_ESP32C3_TWDT_DEVPATH and
+ *   report the stall that reset the previous boot, if any.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32C3_TWDT
+int esp_twdt_initialize(void);
+#endif
+
+/****************************************************************************
+ * Name: esp_twdt_register / esp_twdt_unregister / esp_twdt_feed
+ *
+ * Description:
+ *   Watch the calling thread, which must check in with esp_twdt_feed() at
+ *   least every 'timeout_ms' milliseconds.  A missed deadline resets the
+ *   board, with the thread name and backtrace saved for the next boot.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32C3_TWDT
+int esp_twdt_register(FAR const char *name, unsigned int timeout_ms);
+void esp_twdt_unregister(int id);
+void esp_twdt_feed(int id);
+#endif
+
+/****************************************************************************
+ * Name: esp_crashdump_initialize
+ *
+ * Description:
+ *   Open the crash dump partition and register /dev/crashdump, which
+ *   returns the dump saved by board_crashdump() before the last reset.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32C3_CRASHDUMP
+int esp_crashdump_initialize(void);
+#endif
+
+/****************************************************************************
+ * Name: esp_rtcsync_initialize
+ *
+ * Description:
+ *   Start disciplining the RTC from an SNTP server, with the frequency
+ *   correction kept in RTC memory across resets and deep sleep.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32C3_RTCSYNC
+int esp_rtcsync_initialize(void);
+#endif
+
+/****************************************************************************
+ * Name: esp_delay_initialize / esp_delay_us / esp_delay_ms
+ *
+ * Description:
+ *   Delays timed by the HR timer instead of CONFIG_BOARD_LOOPSPERMSEC.  Long
+ *   delays sleep, short ones and the last tick of long ones spin.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32C3_DELAY
+int esp_delay_initialize(void);
+void esp_delay_us(uint32_t us);
+void esp_delay_ms(uint32_t ms);
+#endif
+
 #endif /* __ASSEMBLY__ */
 #endif /* __BOARDS_RISCV_ESP32C3_ESP32C3_GENERIC_SRC_ESP32C3_GENERIC_H */
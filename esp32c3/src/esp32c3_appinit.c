@@ -67,6 +67,10 @@
 
 int board_app_initialize(uintptr_t arg)
 {
+#ifdef CONFIG_BOARD_ESP32C3_BOOTPROF
+  esp_bootprof_mark(BOOTPROF_NSH_START);
+#endif
+
 #ifdef CONFIG_BOARD_LATE_INITIALIZE
   /* Board initialization already performed by board_late_initialize() */
 
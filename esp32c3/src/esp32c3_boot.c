@@ -25,6 +25,7 @@
 #include <nuttx/config.h>
 
 #include "riscv_internal.h"
+#include "esp32c3-generic.h"
 
 /****************************************************************************
  * Pre-processor Definitions
@@ -57,6 +58,9 @@
 
 void esp_board_initialize(void)
 {
+#ifdef CONFIG_BOARD_ESP32C3_BOOTPROF
+  esp_bootprof_mark(BOOTPROF_BOARD_INIT);
+#endif
 }
 
 /****************************************************************************
@@ -82,6 +86,10 @@ void esp_board_initialize(void)
 #ifdef CONFIG_BOARD_LATE_INITIALIZE
 void board_late_initialize(void)
 {
+#ifdef CONFIG_BOARD_ESP32C3_BOOTPROF
+  esp_bootprof_mark(BOOTPROF_LATE_INIT);
+#endif
+
   /* Perform board-specific initialization */
 
   esp_bringup();
@@ -89,215 +89,342 @@
  * Pre-processor Definitions
  ****************************************************************************/
 
+#define STEP(n)  INITSTEP_BIT(n)
+
 /****************************************************************************
- * Public Functions
+ * Private Types
  ****************************************************************************/
 
+/* Bringup steps, in dependency order */
+
+enum esp_step_e
+{
+  STEP_PROCFS = 0,
+  STEP_TMPFS,
+  STEP_MWDT0,
+  STEP_MWDT1,
+  STEP_RWDT,
+  STEP_XTWDT,
+  STEP_TIMER0,
+  STEP_TIMER1,
+  STEP_SPIDEV,
+  STEP_SPIFLASH,
+  STEP_COEX,
+  STEP_WLAN,
+  STEP_SPISLAVE,
+  STEP_ONESHOT,
+  STEP_RMT,
+  STEP_RTC,
+  STEP_TWAI,
+  STEP_GPIO,
+  STEP_BUTTONS,
+  STEP_LEDC,
+  STEP_DFS,
+  STEP_STKMON,
+  STEP_TWDT,
+  STEP_CRASHDUMP,
+  STEP_RTCSYNC,
+  STEP_DELAY,
+  STEP_NSTEPS
+};
+
 /****************************************************************************
- * Name: esp_bringup
- *
- * Description:
- *   Perform architecture-specific initialization.
- *
- *   CONFIG_BOARD_LATE_INITIALIZE=y :
- *     Called from board_late_initialize().
- *
- *   CONFIG_BOARD_LATE_INITIALIZE=y && CONFIG_BOARDCTL=y :
- *     Called from the NSH library via board_app_initialize().
- *
- * Input Parameters:
- *   None.
- *
- * Returned Value:
- *   Zero (OK) is returned on success; A negated errno value is returned on
- *   any failure.
- *
+ * Private Function Prototypes
  ****************************************************************************/
 
-int esp_bringup(void)
+#ifdef CONFIG_FS_PROCFS
+static int esp_init_procfs(void);
+#endif
+#ifdef CONFIG_FS_TMPFS
+static int esp_init_tmpfs(void);
+#endif
+#ifdef CONFIG_ESPRESSIF_MWDT0
+static int esp_init_mwdt0(void);
+#endif
+#ifdef CONFIG_ESPRESSIF_MWDT1
+static int esp_init_mwdt1(void);
+#endif
+#ifdef CONFIG_ESPRESSIF_RWDT
+static int esp_init_rwdt(void);
+#endif
+#ifdef CONFIG_ESPRESSIF_XTWDT
+static int esp_init_xtwdt(void);
+#endif
+#ifdef CONFIG_TIMER
+static int esp_init_timer0(void);
+#  ifndef CONFIG_ONESHOT
+static int esp_init_timer1(void);
+#  endif
+#endif
+#if defined(CONFIG_ESPRESSIF_SPI) && defined(CONFIG_SPI_DRIVER)
+static int esp_init_spidev(void);
+#endif
+#ifdef CONFIG_ESPRESSIF_WIFI_BT_COEXIST
+static int esp_init_coex(void);
+#endif
+#if defined(CONFIG_SPI_SLAVE_DRIVER) && defined(CONFIG_ESPRESSIF_SPI2)
+static int esp_init_spislave(void);
+#endif
+#ifdef CONFIG_ESP_RMT
+static int esp_init_rmt(void);
+#endif
+#if defined(CONFIG_INPUT_BUTTONS) && defined(CONFIG_INPUT_BUTTONS_LOWER)
+static int esp_init_buttons(void);
+#endif
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+static const struct esp_initstep_s g_bringup_steps[STEP_NSTEPS] =
 {
-  int ret = OK;
+#ifdef CONFIG_FS_PROCFS
+  [STEP_PROCFS]   = { "procfs", esp_init_procfs, 0, 0 },
+#endif
+#ifdef CONFIG_FS_TMPFS
+  [STEP_TMPFS]    = { "tmpfs", esp_init_tmpfs, 0, 0 },
+#endif
+#ifdef CONFIG_ESPRESSIF_MWDT0
+  [STEP_MWDT0]    = { "WDT MWDT0", esp_init_mwdt0, 0, 0 },
+#endif
+#ifdef CONFIG_ESPRESSIF_MWDT1
+  [STEP_MWDT1]    = { "WDT MWDT1", esp_init_mwdt1, 0, 0 },
+#endif
+#ifdef CONFIG_ESPRESSIF_RWDT
+  [STEP_RWDT]     = { "WDT RWDT", esp_init_rwdt, 0, 0 },
+#endif
+#ifdef CONFIG_ESPRESSIF_XTWDT
+  [STEP_XTWDT]    = { "WDT XTWDT", esp_init_xtwdt, 0, 0 },
+#endif
+#ifdef CONFIG_TIMER
+  [STEP_TIMER0]   = { "Timer 0", esp_init_timer0, 0, 0 },
+#  ifndef CONFIG_ONESHOT
+  [STEP_TIMER1]   = { "Timer 1", esp_init_timer1, 0, 0 },
+#  endif
+#endif
+#if defined(CONFIG_ESPRESSIF_SPI) && defined(CONFIG_SPI_DRIVER)
+  [STEP_SPIDEV]   = { "spidev 2", esp_init_spidev, 0, 0 },
+#endif
+#ifdef CONFIG_ESPRESSIF_SPIFLASH
+  [STEP_SPIFLASH] = { "SPI Flash", board_spiflash_init, 0, 0 },
+#endif
+#ifdef CONFIG_ESPRESSIF_WIFI_BT_COEXIST
+  [STEP_COEX]     = { "coexistence", esp_init_coex, 0, 0 },
+#endif
+#ifdef CONFIG_ESPRESSIF_WIFI
+  [STEP_WLAN]     =
+  {
+    "wireless subsystem", board_wlan_init,
+    STEP(STEP_SPIFLASH) | STEP(STEP_COEX), INITSTEP_BACKGROUND
+  },
+#endif
+#if defined(CONFIG_SPI_SLAVE_DRIVER) && defined(CONFIG_ESPRESSIF_SPI2)
+  [STEP_SPISLAVE] = { "SPI2 Slave driver", esp_init_spislave, 0, 0 },
+#endif
+#ifdef CONFIG_ONESHOT
+  [STEP_ONESHOT]  = { "Oneshot Timer", esp_oneshot_initialize, 0, 0 },
+#endif
+#ifdef CONFIG_ESP_RMT
+  [STEP_RMT]      = { "RMT", esp_init_rmt, 0, 0 },
+#endif
+#ifdef CONFIG_RTC_DRIVER
+  [STEP_RTC]      = { "RTC driver", esp_rtc_driverinit, 0, 0 },
+#endif
+#ifdef CONFIG_ESPRESSIF_TWAI
+  [STEP_TWAI]     = { "TWAI", board_twai_setup, 0, 0 },
+#endif
+#ifdef CONFIG_DEV_GPIO
+  [STEP_GPIO]     = { "GPIO Driver", esp_gpio_init, 0, 0 },
+#endif
+#if defined(CONFIG_INPUT_BUTTONS) && defined(CONFIG_INPUT_BUTTONS_LOWER)
+  [STEP_BUTTONS]  = { "button driver", esp_init_buttons, 0, 0 },
+#endif
+#ifdef CONFIG_ESPRESSIF_LEDC
+  [STEP_LEDC]     = { "LEDC", board_ledc_setup, 0, 0 },
+#endif
+#ifdef CONFIG_BOARD_ESP32C3_DFS
+  [STEP_DFS]      = { "DFS governor", esp_dfs_initialize, 0, 0 },
+#endif
+#ifdef CONFIG_BOARD_ESP32C3_STKMON
+  [STEP_STKMON]   = { "stack monitor", esp_stkmon_initialize, 0, 0 },
+#endif
+#ifdef CONFIG_BOARD_ESP32C3_TWDT
+  [STEP_TWDT]     =
+  {
+    "task watchdog", esp_twdt_initialize, STEP(STEP_MWDT0), 0
+  },
+#endif
+#ifdef CONFIG_BOARD_ESP32C3_CRASHDUMP
+  [STEP_CRASHDUMP] =
+  {
+    "crash dump", esp_crashdump_initialize, STEP(STEP_SPIFLASH), 0
+  },
+#endif
+#ifdef CONFIG_BOARD_ESP32C3_RTCSYNC
+  [STEP_RTCSYNC]  =
+  {
+    "RTC sync", esp_rtcsync_initialize, STEP(STEP_RTC), 0
+  },
+#endif
+#ifdef CONFIG_BOARD_ESP32C3_DELAY
+  [STEP_DELAY]    = { "delays", esp_delay_initialize, 0, 0 },
+#endif
+};
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
 
 #ifdef CONFIG_FS_PROCFS
+static int esp_init_procfs(void)
+{
   /* Mount the procfs file system */
 
-  ret = nx_mount(NULL, "/proc", "procfs", 0, NULL);
-  if (ret < 0)
-    {
-      _err("Failed to mount procfs at /proc: %d\n", ret);
-    }
+  return nx_mount(NULL, "/proc", "procfs", 0, NULL);
+}
 #endif
 
 #ifdef CONFIG_FS_TMPFS
+static int esp_init_tmpfs(void)
+{
   /* Mount the tmpfs file system */
 
-  ret = nx_mount(NULL, CONFIG_LIBC_TMPDIR, "tmpfs", 0, NULL);
-  if (ret < 0)
-    {
-      _err("Failed to mount tmpfs at %s: %d\n", CONFIG_LIBC_TMPDIR, ret);
-    }
+  return nx_mount(NULL, CONFIG_LIBC_TMPDIR, "tmpfs", 0, NULL);
+}
 #endif
 
 #ifdef CONFIG_ESPRESSIF_MWDT0
-  ret = esp_wdt_initialize("/dev/watchdog0", ESP_WDT_MWDT0);
-  if (ret < 0)
-    {
-      _err("Failed to initialize WDT: %d\n", ret);
-    }
+static int esp_init_mwdt0(void)
+{
+  return esp_wdt_initialize("/dev/watchdog0", ESP_WDT_MWDT0);
+}
 #endif
 
 #ifdef CONFIG_ESPRESSIF_MWDT1
-  ret = esp_wdt_initialize("/dev/watchdog1", ESP_WDT_MWDT1);
-  if (ret < 0)
-    {
-      _err("Failed to initialize WDT: %d\n", ret);
-    }
+static int esp_init_mwdt1(void)
+{
+  return esp_wdt_initialize("/dev/watchdog1", ESP_WDT_MWDT1);
+}
 #endif
 
 #ifdef CONFIG_ESPRESSIF_RWDT
-  ret = esp_wdt_initialize("/dev/watchdog2", ESP_WDT_RWDT);
-  if (ret < 0)
-    {
-      _err("Failed to initialize WDT: %d\n", ret);
-    }
+static int esp_init_rwdt(void)
+{
+  return esp_wdt_initialize("/dev/watchdog2", ESP_WDT_RWDT);
+}
 #endif
 
 #ifdef CONFIG_ESPRESSIF_XTWDT
-  ret = esp_wdt_initialize("/dev/watchdog3", ESP_WDT_XTAL32K);
-  if (ret < 0)
-    {
-      _err("Failed to initialize WDT: %d\n", ret);
-    }
+static int esp_init_xtwdt(void)
+{
+  return esp_wdt_initialize("/dev/watchdog3", ESP_WDT_XTAL32K);
+}
 #endif
 
 #ifdef CONFIG_TIMER
-  ret = esp_timer_initialize(0);
-  if (ret < 0)
-    {
-      _err("Failed to initialize Timer 0: %d\n", ret);
-    }
+static int esp_init_timer0(void)
+{
+  return esp_timer_initialize(0);
+}
 
-#ifndef CONFIG_ONESHOT
-  ret = esp_timer_initialize(1);
-  if (ret < 0)
-    {
-      _err("Failed to initialize Timer 1: %d\n", ret);
-    }
-#endif
+#  ifndef CONFIG_ONESHOT
+static int esp_init_timer1(void)
+{
+  return esp_timer_initialize(1);
+}
+#  endif
 #endif
 
 #if defined(CONFIG_ESPRESSIF_SPI) && defined(CONFIG_SPI_DRIVER)
-  ret = board_spidev_initialize(ESPRESSIF_SPI2);
-  if (ret < 0)
-    {
-      syslog(LOG_ERR, "ERROR: Failed to init spidev 2: %d\n", ret);
-    }
-#endif
-
-#ifdef CONFIG_ESPRESSIF_SPIFLASH
-  ret = board_spiflash_init();
-  if (ret)
-    {
-      syslog(LOG_ERR, "ERROR: Failed to initialize SPI Flash\n");
-    }
+static int esp_init_spidev(void)
+{
+  return board_spidev_initialize(ESPRESSIF_SPI2);
+}
 #endif
 
 #ifdef CONFIG_ESPRESSIF_WIFI_BT_COEXIST
+static int esp_init_coex(void)
+{
   esp_coex_adapter_register(&g_coex_adapter_funcs);
   coex_pre_init();
-#endif
-
-#ifdef CONFIG_ESPRESSIF_WIFI
-  ret = board_wlan_init();
-  if (ret < 0)
-    {
-      syslog(LOG_ERR, "ERROR: Failed to initialize wireless subsystem=%d\n",
-             ret);
-    }
+  return OK;
+}
 #endif
 
 #if defined(CONFIG_SPI_SLAVE_DRIVER) && defined(CONFIG_ESPRESSIF_SPI2)
-  ret = board_spislavedev_initialize(ESPRESSIF_SPI2);
-  if (ret < 0)
-    {
-      syslog(LOG_ERR, "Failed to initialize SPI%d Slave driver: %d\n",
-             ESPRESSIF_SPI2, ret);
-    }
-#endif
-
-#ifdef CONFIG_ONESHOT
-  ret = esp_oneshot_initialize();
-  if (ret < 0)
-    {
-      _err("Failed to initialize Oneshot Timer: %d\n", ret);
-    }
+static int esp_init_spislave(void)
+{
+  return board_spislavedev_initialize(ESPRESSIF_SPI2);
+}
 #endif
 
 #ifdef CONFIG_ESP_RMT
+static int esp_init_rmt(void)
+{
+  int ret;
+
   ret = board_rmt_txinitialize(RMT_TXCHANNEL, RMT_OUTPUT_PIN);
   if (ret < 0)
     {
-      syslog(LOG_ERR, "ERROR: board_rmt_txinitialize() failed: %d\n", ret);
+      return ret;
     }
 
-  ret = board_rmt_rxinitialize(RMT_RXCHANNEL, RMT_INPUT_PIN);
-  if (ret < 0)
-    {
-      syslog(LOG_ERR, "ERROR: board_rmt_txinitialize() failed: %d\n", ret);
-    }
+  return board_rmt_rxinitialize(RMT_RXCHANNEL, RMT_INPUT_PIN);
+}
 #endif
 
-#ifdef CONFIG_RTC_DRIVER
-  /* Initialize the RTC driver */
+#if defined(CONFIG_INPUT_BUTTONS) && defined(CONFIG_INPUT_BUTTONS_LOWER)
+static int esp_init_buttons(void)
+{
+  /* Register the BUTTON driver */
 
-  ret = esp_rtc_driverinit();
-  if (ret < 0)
-    {
-      _err("Failed to initialize the RTC driver: %d\n", ret);
-    }
+  return btn_lower_initialize("/dev/buttons");
+}
 #endif
 
-#ifdef CONFIG_ESPRESSIF_TWAI
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
 
-  /* Initialize TWAI and register the TWAI driver. */
+/****************************************************************************
+ * Name: esp_bringup
+ *
+ * Description:
+ *   Perform architecture-specific initialization.
+ *
+ *   CONFIG_BOARD_LATE_INITIALIZE=y :
+ *     Called from board_late_initialize().
+ *
+ *   CONFIG_BOARD_LATE_INITIALIZE=y && CONFIG_BOARDCTL=y :
+ *     Called from the NSH library via board_app_initialize().
+ *
+ * Input Parameters:
+ *   None.
+ *
+ * Returned Value:
+ *   Zero (OK) is returned on success; A negated errno value is returned on
+ *   any failure.
+ *
+ ****************************************************************************/
 
-  ret = board_twai_setup();
-  if (ret < 0)
-    {
-      syslog(LOG_ERR, "ERROR: board_twai_setup failed: %d\n", ret);
-    }
-#endif
+int esp_bringup(void)
+{
+  int ret;
 
-#ifdef CONFIG_DEV_GPIO
-  ret = esp_gpio_init();
+#ifdef CONFIG_BOARD_ESP32C3_BOOTPROF
+  ret = esp_bootprof_initialize();
   if (ret < 0)
     {
-      ierr("Failed to initialize GPIO Driver: %d\n", ret);
+      syslog(LOG_ERR, "ERROR: Failed to register /proc/boardinit: %d\n",
+             ret);
     }
 #endif
 
-#if defined(CONFIG_INPUT_BUTTONS) && defined(CONFIG_INPUT_BUTTONS_LOWER)
-  /* Register the BUTTON driver */
+  ret = esp_initsteps_run(g_bringup_steps, STEP_NSTEPS);
 
-  ret = btn_lower_initialize("/dev/buttons");
-  if (ret < 0)
-    {
-      ierr("ERROR: btn_lower_initialize() failed: %d\n", ret);
-    }
+#ifdef CONFIG_BOARD_ESP32C3_BOOTPROF
+  esp_bootprof_mark(BOOTPROF_BRINGUP_DONE);
 #endif
 
-#ifdef CONFIG_ESPRESSIF_LEDC
-  ret = board_ledc_setup();
-  if (ret < 0)
-    {
-      syslog(LOG_ERR, "ERROR: board_ledc_setup() failed: %d\n", ret);
-    }
-#endif /* CONFIG_ESPRESSIF_LEDC */
-
-  /* If we got here then perhaps not all initialization was successful, but
-   * at least enough succeeded to bring-up NSH with perhaps reduced
-   * capabilities.
-   */
-
   return ret;
 }
@@ -50,6 +50,45 @@
 #include "esp32c3-generic.h"
 #include <arch/board/board.h>
 
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#if defined(CONFIG_ARCH_IRQBUTTONS) && defined(CONFIG_BOARD_ESP32C3_DFS)
+#  if CONFIG_BOARD_ESP32C3_DFS_BUTTON_HOLD_MS > 0
+#    define BUTTON_DFS_HOLD 1
+#  endif
+#endif
+
+#ifdef BUTTON_DFS_HOLD
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+static xcpt_t g_button_handler;
+static void  *g_button_arg;
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: button_dfs_interrupt
+ *
+ * Description:
+ *   Keep the CPU at full speed for a while after a press, then run the
+ *   handler registered with board_button_irq().
+ *
+ ****************************************************************************/
+
+static int button_dfs_interrupt(int irq, void *context, void *arg)
+{
+  esp_dfs_hold(DFS_LEVEL_160M, CONFIG_BOARD_ESP32C3_DFS_BUTTON_HOLD_MS);
+  return g_button_handler(irq, context, g_button_arg);
+}
+#endif
+
 /****************************************************************************
  * Public Functions
  ****************************************************************************/
@@ -103,7 +142,11 @@ uint32_t board_buttons(void)
 
   for (i = 0; i < 10; i++)
     {
-      up_mdelay(1); /* TODO */
+#ifdef CONFIG_BOARD_ESP32C3_DELAY
+      esp_delay_ms(1);
+#else
+      up_mdelay(1);
+#endif
 
       bool b1 = esp_gpioread(BUTTON_BOOT);
 
@@ -175,7 +218,14 @@ int board_button_irq(int id, xcpt_t irqhandler, void *arg)
 
       gpioinfo("Attach %p\n", irqhandler);
 
+#ifdef BUTTON_DFS_HOLD
+      g_button_handler = irqhandler;
+      g_button_arg     = arg;
+
+      ret = irq_attach(irq, button_dfs_interrupt, NULL);
+#else
       ret = irq_attach(irq, irqhandler, arg);
+#endif
       if (ret < 0)
         {
           syslog(LOG_ERR, "ERROR: irq_attach() failed: %d\n", ret);
@@ -0,0 +1,611 @@
+/****************************************************************************
+ * boards/risc-v/esp32c3/esp32c3-generic/src/esp32c3_crashdump.c
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/* Layout of the partition, little endian:
+ *
+ *   struct crashdump_hdr_s, written last so that a partial dump is invalid
+ *   Records, each a struct crashdump_rec_s followed by its payload padded
+ *   to 4 bytes:
+ *     CRASHDUMP_INFO   struct crashdump_info_s
+ *     CRASHDUMP_REGS   Register context of the failing thread, as saved
+ *                      by the exception handler
+ *     CRASHDUMP_TASK   struct crashdump_task_s, then 'slice' bytes of its
+ *                      stack from 'sp' up
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <sys/types.h>
+#include <sys/param.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <syslog.h>
+#include <debug.h>
+
+#include <nuttx/arch.h>
+#include <nuttx/board.h>
+#include <nuttx/compiler.h>
+#include <nuttx/clock.h>
+#include <nuttx/crc32.h>
+#include <nuttx/irq.h>
+#include <nuttx/sched.h>
+#include <nuttx/fs/fs.h>
+#include <nuttx/mtd/mtd.h>
+
+#include "espressif/esp_spiflash_mtd.h"
+#include "esp32c3-generic.h"
+
+#ifdef CONFIG_BOARD_ESP32C3_CRASHDUMP
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define CRASHDUMP_MAGIC    0x44435845 /* "EXCD" */
+#define CRASHDUMP_VERSION  1
+#define CRASHDUMP_OFFSET   CONFIG_BOARD_ESP32C3_CRASHDUMP_OFFSET
+#define CRASHDUMP_SIZE     CONFIG_BOARD_ESP32C3_CRASHDUMP_SIZE
+#define CRASHDUMP_SLICE    CONFIG_BOARD_ESP32C3_CRASHDUMP_SLICE
+
+#define CRASHDUMP_ALIGN(n) (((n) + 3) & ~3)
+
+/* The panic path writes through the ROM routines a staged buffer at a
+ * time, erasing the flash sectors as it reaches them.
+ */
+
+#define CRASHDUMP_SECTOR   4096
+#define CRASHDUMP_BUFSIZE  256
+#define CRASHDUMP_IRAM     locate_code(".iram1")
+
+/* Record types */
+
+#define CRASHDUMP_INFO     1
+#define CRASHDUMP_REGS     2
+#define CRASHDUMP_TASK     3
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+struct crashdump_hdr_s
+{
+  uint32_t magic;            /* CRASHDUMP_MAGIC if valid */
+  uint32_t version;          /* CRASHDUMP_VERSION */
+  uint32_t len;              /* Bytes of records after the header */
+  uint32_t crc;              /* CRC-32 of the records */
+};
+
+struct crashdump_rec_s
+{
+  uint16_t type;             /* CRASHDUMP_* */
+  uint16_t reserved;
+  uint32_t len;              /* Payload bytes, without the padding */
+};
+
+struct crashdump_info_s
+{
+  uint32_t uptime;           /* Time of the crash since boot (ms) */
+  int32_t  pid;              /* Failing thread */
+  int32_t  lineno;           /* Line of the assertion, if any */
+  uint32_t cpu;              /* CPU that failed */
+  uint32_t sp;               /* Its stack pointer */
+  char     name[32];         /* Failing thread name */
+  char     file[64];         /* File of the assertion, tail kept */
+  char     msg[64];          /* Assertion message */
+};
+
+struct crashdump_task_s
+{
+  int32_t  pid;
+  uint8_t  state;            /* TSTATE_* */
+  uint8_t  prio;
+  uint16_t reserved;
+  uint32_t stackbase;        /* Lowest address of the stack */
+  uint32_t stacksize;
+  uint32_t sp;               /* Saved stack pointer */
+  uint32_t slice;            /* Stack bytes that follow */
+  char     name[16];
+};
+
+struct crashdump_s
+{
+  FAR struct mtd_dev_s *mtd; /* Partition, outside of the panic path */
+  size_t   size;             /* Size of the saved dump, 0 if none */
+  uint32_t offset;           /* Write position */
+  uint32_t crc;              /* CRC-32 of the records so far */
+  uint32_t flushed;          /* Bytes written to flash */
+  uint32_t erased;           /* Bytes of the partition erased */
+  uint32_t buflen;           /* Bytes staged in 'buf' */
+  bool     busy;             /* A dump is being written */
+  bool     failed;           /* A flash operation failed */
+  uint32_t buf[CRASHDUMP_BUFSIZE / 4]; /* Staging, word aligned in DRAM */
+};
+
+/* The thread that failed, for the task walk */
+
+struct crashdump_fault_s
+{
+  FAR struct tcb_s *tcb;
+  uintptr_t sp;
+};
+
+/****************************************************************************
+ * Private Function Prototypes
+ ****************************************************************************/
+
+/* ROM functions */
+
+extern int esp_rom_spiflash_erase_sector(uint32_t sector);
+extern int esp_rom_spiflash_write(uint32_t addr, const uint32_t *src,
+                                  int32_t len);
+extern uint32_t Cache_Suspend_ICache(void);
+extern void Cache_Resume_ICache(uint32_t autoload);
+
+static ssize_t crashdump_read(FAR struct file *filep, FAR char *buffer,
+                              size_t buflen);
+static ssize_t crashdump_write(FAR struct file *filep,
+                               FAR const char *buffer, size_t buflen);
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+static struct crashdump_s g_crashdump;
+
+static const struct file_operations g_crashdump_fops =
+{
+  .read  = crashdump_read,
+  .write = crashdump_write,
+};
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: crashdump_flash
+ *
+ * Description:
+ *   Erase the sector at 'addr' when 'src' is NULL, else write 'len' bytes
+ *   of 'src' there.  The SPI flash driver takes a lock and may sleep,
+ *   which the panic handler cannot do, so this goes straight to the ROM
+ *   routines.  The cache is suspended meanwhile, hence IRAM and a DRAM
+ *   'src'.
+ *
+ ****************************************************************************/
+
+static int CRASHDUMP_IRAM crashdump_flash(uint32_t addr,
+                                          FAR const uint32_t *src,
+                                          uint32_t len)
+{
+  uint32_t autoload;
+  int ret;
+
+  autoload = Cache_Suspend_ICache();
+
+  if (src == NULL)
+    {
+      ret = esp_rom_spiflash_erase_sector(addr / CRASHDUMP_SECTOR);
+    }
+  else
+    {
+      ret = esp_rom_spiflash_write(addr, src, len);
+    }
+
+  Cache_Resume_ICache(autoload);
+  return ret;
+}
+
+/****************************************************************************
+ * Name: crashdump_flush
+ *
+ * Description:
+ *   Write the staged bytes after the last flushed ones, erasing the
+ *   sectors they reach first.  Records are padded to 4 bytes, as the ROM
+ *   writes words.
+ *
+ ****************************************************************************/
+
+static void crashdump_flush(void)
+{
+  FAR struct crashdump_s *dump = &g_crashdump;
+  uint32_t len = CRASHDUMP_ALIGN(dump->buflen);
+  uint32_t end = dump->flushed + len;
+
+  while (!dump->failed && dump->erased < end)
+    {
+      dump->failed = crashdump_flash(CRASHDUMP_OFFSET + dump->erased,
+                                     NULL, 0) != 0;
+      dump->erased += CRASHDUMP_SECTOR;
+    }
+
+  if (!dump->failed && len > 0)
+    {
+      dump->failed = crashdump_flash(CRASHDUMP_OFFSET + dump->flushed,
+                                     dump->buf, len) != 0;
+    }
+
+  dump->flushed = end;
+  dump->buflen  = 0;
+}
+
+/****************************************************************************
+ * Name: crashdump_put
+ *
+ * Description:
+ *   Append 'len' bytes to the dump.  Whatever does not fit is dropped.
+ *
+ ****************************************************************************/
+
+static void crashdump_put(FAR const void *data, size_t len)
+{
+  FAR struct crashdump_s *dump = &g_crashdump;
+  FAR const uint8_t *src = data;
+  size_t n;
+
+  len = MIN(len, CRASHDUMP_SIZE - dump->offset);
+  dump->crc     = crc32part(src, len, dump->crc);
+  dump->offset += len;
+
+  while (len > 0)
+    {
+      n = MIN(len, CRASHDUMP_BUFSIZE - dump->buflen);
+      memcpy((FAR uint8_t *)dump->buf + dump->buflen, src, n);
+      dump->buflen += n;
+      src          += n;
+      len          -= n;
+
+      if (dump->buflen == CRASHDUMP_BUFSIZE)
+        {
+          crashdump_flush();
+        }
+    }
+}
+
+/****************************************************************************
+ * Name: crashdump_record
+ *
+ * Description:
+ *   Append the header of a record with 'len' bytes of payload, clipped to
+ *   the room left in the partition.  Return the clipped length, which is
+ *   what the header holds.  That much payload follows with
+ *   crashdump_put(), then crashdump_pad().
+ *
+ ****************************************************************************/
+
+static size_t crashdump_record(int type, size_t len)
+{
+  FAR struct crashdump_s *dump = &g_crashdump;
+  struct crashdump_rec_s rec;
+  size_t end;
+
+  end = MIN(dump->offset + sizeof(rec), CRASHDUMP_SIZE);
+
+  rec.type     = type;
+  rec.reserved = 0;
+  rec.len      = MIN(len, CRASHDUMP_SIZE - end);
+  crashdump_put(&rec, sizeof(rec));
+
+  return rec.len;
+}
+
+static void crashdump_pad(size_t len)
+{
+  static const uint8_t zeros[3];
+
+  crashdump_put(zeros, CRASHDUMP_ALIGN(len) - len);
+}
+
+/****************************************************************************
+ * Name: crashdump_task
+ *
+ * Description:
+ *   nxsched_foreach() callback saving a thread and the top of its stack.
+ *
+ ****************************************************************************/
+
+static void crashdump_task(FAR struct tcb_s *tcb, FAR void *arg)
+{
+  FAR struct crashdump_fault_s *fault = arg;
+  struct crashdump_task_s task;
+  uintptr_t base = (uintptr_t)tcb->stack_base_ptr;
+  uintptr_t sp;
+  size_t len;
+
+  memset(&task, 0, sizeof(task));
+
+  if (tcb == fault->tcb)
+    {
+      sp = fault->sp;
+    }
+  else
+    {
+      sp = up_getusrsp(tcb->xcp.regs);
+    }
+
+  task.pid       = tcb->pid;
+  task.state     = tcb->task_state;
+  task.prio      = tcb->sched_priority;
+  task.stackbase = base;
+  task.stacksize = tcb->adj_stack_size;
+  task.sp        = sp;
+
+  /* Stacks grow down, the live part is from the stack pointer up */
+
+  if (sp >= base && sp < base + tcb->adj_stack_size)
+    {
+      task.slice = MIN(base + tcb->adj_stack_size - sp, CRASHDUMP_SLICE);
+    }
+
+#if CONFIG_TASK_NAME_SIZE > 0
+  strlcpy(task.name, tcb->name, sizeof(task.name));
+#endif
+
+  /* Near the end of the partition only part of the stack fits */
+
+  len        = crashdump_record(CRASHDUMP_TASK, sizeof(task) + task.slice);
+  task.slice = len > sizeof(task) ? len - sizeof(task) : 0;
+
+  crashdump_put(&task, MIN(len, sizeof(task)));
+  crashdump_put((FAR const void *)sp, task.slice);
+  crashdump_pad(len);
+}
+
+/****************************************************************************
+ * Name: crashdump_header
+ *
+ * Description:
+ *   Read the header of the saved dump and check the CRC of its records.
+ *   Return the size of the dump, or zero if there is none.
+ *
+ ****************************************************************************/
+
+static size_t crashdump_header(FAR struct crashdump_hdr_s *hdr)
+{
+  FAR struct crashdump_s *dump = &g_crashdump;
+  FAR uint8_t *buf = (FAR uint8_t *)dump->buf;
+  uint32_t crc = 0;
+  size_t pos;
+  size_t n;
+
+  if (MTD_READ(dump->mtd, 0, sizeof(*hdr), (FAR uint8_t *)hdr) !=
+      sizeof(*hdr))
+    {
+      return 0;
+    }
+
+  if (hdr->magic != CRASHDUMP_MAGIC ||
+      hdr->version != CRASHDUMP_VERSION ||
+      hdr->len > CRASHDUMP_SIZE - sizeof(*hdr))
+    {
+      return 0;
+    }
+
+  for (pos = 0; pos < hdr->len; pos += n)
+    {
+      n = MIN(hdr->len - pos, CRASHDUMP_BUFSIZE);
+      if (MTD_READ(dump->mtd, sizeof(*hdr) + pos, n, buf) != (ssize_t)n)
+        {
+          return 0;
+        }
+
+      crc = crc32part(buf, n, crc);
+    }
+
+  if (crc != hdr->crc)
+    {
+      syslog(LOG_WARNING, "WARNING: Crash dump CRC mismatch, ignored\n");
+      return 0;
+    }
+
+  return sizeof(*hdr) + hdr->len;
+}
+
+/****************************************************************************
+ * Name: crashdump_read
+ *
+ * Description:
+ *   Return the saved dump, header included, or nothing.
+ *
+ ****************************************************************************/
+
+static ssize_t crashdump_read(FAR struct file *filep, FAR char *buffer,
+                              size_t buflen)
+{
+  FAR struct crashdump_s *dump = &g_crashdump;
+  ssize_t nread;
+
+  if (filep->f_pos >= dump->size)
+    {
+      return 0;
+    }
+
+  buflen = MIN(buflen, dump->size - filep->f_pos);
+
+  nread = MTD_READ(dump->mtd, filep->f_pos, buflen, (FAR uint8_t *)buffer);
+  if (nread > 0)
+    {
+      filep->f_pos += nread;
+    }
+
+  return nread;
+}
+
+/****************************************************************************
+ * Name: crashdump_write
+ *
+ * Description:
+ *   Any write discards the saved dump, erasing its header is enough.
+ *
+ ****************************************************************************/
+
+static ssize_t crashdump_write(FAR struct file *filep,
+                               FAR const char *buffer, size_t buflen)
+{
+  FAR struct crashdump_s *dump = &g_crashdump;
+  int ret;
+
+  ret = MTD_ERASE(dump->mtd, 0, 1);
+  if (ret < 0)
+    {
+      return ret;
+    }
+
+  dump->size = 0;
+  return buflen;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: esp_crashdump_initialize
+ *
+ * Description:
+ *   Open the crash dump partition, check and report the dump of the
+ *   previous boot and register /dev/crashdump to retrieve it.
+ *
+ ****************************************************************************/
+
+int esp_crashdump_initialize(void)
+{
+  FAR struct crashdump_s *dump = &g_crashdump;
+  struct crashdump_hdr_s hdr;
+
+  dump->mtd = esp_spiflash_alloc_mtdpart(CRASHDUMP_OFFSET, CRASHDUMP_SIZE);
+  if (dump->mtd == NULL)
+    {
+      syslog(LOG_ERR, "ERROR: Failed to open the crash dump partition\n");
+      return -ENODEV;
+    }
+
+  dump->size = crashdump_header(&hdr);
+  if (dump->size > 0)
+    {
+      syslog(LOG_WARNING, "WARNING: Crash dump of %zu bytes in "
+             "/dev/crashdump\n", dump->size);
+    }
+
+  return register_driver("/dev/crashdump", &g_crashdump_fops, 0666, NULL);
+}
+
+/****************************************************************************
+ * Name: board_crashdump
+ *
+ * Description:
+ *   Called by the assertion and panic handlers.  Save the failing thread,
+ *   its registers and the top of every stack to flash, replacing the
+ *   previous dump.  Runs with the system stopped, so the flash is written
+ *   synchronously through the ROM routines, and the sectors are erased
+ *   only as far as the dump goes.
+ *
+ ****************************************************************************/
+
+void board_crashdump(uintptr_t sp, FAR struct tcb_s *tcb,
+                     FAR const char *filename, int lineno,
+                     FAR const char *msg, FAR void *regs)
+{
+  FAR struct crashdump_s *dump = &g_crashdump;
+  struct crashdump_fault_s fault;
+  struct crashdump_info_s info;
+  struct crashdump_hdr_s hdr;
+  size_t len;
+
+  /* Nothing to write to, or a fault while dumping */
+
+  if (dump->mtd == NULL || dump->busy)
+    {
+      return;
+    }
+
+  dump->busy    = true;
+  dump->offset  = sizeof(hdr);
+  dump->crc     = 0;
+  dump->flushed = sizeof(hdr);
+  dump->erased  = 0;
+  dump->buflen  = 0;
+  dump->failed  = false;
+
+  memset(&info, 0, sizeof(info));
+  info.uptime = TICK2MSEC(clock_systime_ticks());
+  info.pid    = tcb != NULL ? tcb->pid : -1;
+  info.lineno = lineno;
+  info.cpu    = up_cpu_index();
+  info.sp     = sp;
+
+#if CONFIG_TASK_NAME_SIZE > 0
+  if (tcb != NULL)
+    {
+      strlcpy(info.name, tcb->name, sizeof(info.name));
+    }
+#endif
+
+  if (filename != NULL)
+    {
+      strlcpy(info.file, filename + MAX((int)strlen(filename) -
+                                        (int)sizeof(info.file) + 1, 0),
+              sizeof(info.file));
+    }
+
+  if (msg != NULL)
+    {
+      strlcpy(info.msg, msg, sizeof(info.msg));
+    }
+
+  len = crashdump_record(CRASHDUMP_INFO, sizeof(info));
+  crashdump_put(&info, len);
+
+  if (regs != NULL)
+    {
+      len = crashdump_record(CRASHDUMP_REGS, XCPTCONTEXT_SIZE);
+      crashdump_put(regs, len);
+      crashdump_pad(len);
+    }
+
+  fault.tcb = tcb;
+  fault.sp  = sp;
+  nxsched_foreach(crashdump_task, &fault);
+
+  crashdump_flush();
+  if (dump->failed)
+    {
+      return;
+    }
+
+  /* Seal the dump, through the staging buffer in DRAM */
+
+  hdr.magic   = CRASHDUMP_MAGIC;
+  hdr.version = CRASHDUMP_VERSION;
+  hdr.len     = dump->offset - sizeof(hdr);
+  hdr.crc     = dump->crc;
+
+  memcpy(dump->buf, &hdr, sizeof(hdr));
+  crashdump_flash(CRASHDUMP_OFFSET, dump->buf, sizeof(hdr));
+}
+
+#endif /* CONFIG_BOARD_ESP32C3_CRASHDUMP */
@@ -0,0 +1,135 @@
+/****************************************************************************
+ * boards/risc-v/esp32c3/esp32c3-generic/src/esp32c3_delay.c
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <sys/types.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <nuttx/arch.h>
+#include <nuttx/clock.h>
+#include <nuttx/init.h>
+#include <nuttx/sched.h>
+#include <nuttx/signal.h>
+
+#include "espressif/esp_hr_timer.h"
+#include "esp32c3-generic.h"
+
+#ifdef CONFIG_BOARD_ESP32C3_DELAY
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+/* The HR timer cannot be read before it is initialized */
+
+static bool g_delay_ready;
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: delay_can_sleep
+ ****************************************************************************/
+
+static bool delay_can_sleep(void)
+{
+  return OSINIT_OS_READY() && !up_interrupt_context() && !sched_idletask();
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: esp_delay_initialize
+ *
+ * Description:
+ *   Start the HR timer, the system timer of the chip, and switch the
+ *   board delays over to it.
+ *
+ ****************************************************************************/
+
+int esp_delay_initialize(void)
+{
+  int ret;
+
+  ret = esp_hr_timer_init();
+  if (ret < 0)
+    {
+      return ret;
+    }
+
+  g_delay_ready = true;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: esp_delay_us
+ *
+ * Description:
+ *   Wait for at least 'us' microseconds by the HR timer, which counts the
+ *   crystal whatever CPU frequency DFS picked.  Delays of two ticks or
+ *   more sleep for all but the last tick, the rest is spent spinning on
+ *   the timer, so the delay ends within a few microseconds of the
+ *   deadline.  Interrupt handlers and the idle thread always spin.
+ *
+ ****************************************************************************/
+
+void esp_delay_us(uint32_t us)
+{
+  uint64_t deadline;
+
+  if (!g_delay_ready)
+    {
+      up_udelay(us);
+      return;
+    }
+
+  deadline = esp_hr_timer_time_us() + us;
+
+  /* A sleep of n ticks may end up to a tick early, never late */
+
+  if (us >= 2 * USEC_PER_TICK && delay_can_sleep())
+    {
+      nxsig_usleep(us - USEC_PER_TICK);
+    }
+
+  while (esp_hr_timer_time_us() < deadline)
+    {
+    }
+}
+
+/****************************************************************************
+ * Name: esp_delay_ms
+ ****************************************************************************/
+
+void esp_delay_ms(uint32_t ms)
+{
+  esp_delay_us(ms * USEC_PER_MSEC);
+}
+
+#endif /* CONFIG_BOARD_ESP32C3_DELAY */
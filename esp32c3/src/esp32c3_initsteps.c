@@ -0,0 +1,284 @@
+/****************************************************************************
+ * boards/risc-v/esp32c3/esp32c3-generic/src/esp32c3_initsteps.c
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <sys/types.h>
+#include <assert.h>
+#include <syslog.h>
+#include <debug.h>
+
+#include <nuttx/kthread.h>
+#include <nuttx/mutex.h>
+#include <nuttx/semaphore.h>
+
+#include "esp32c3-generic.h"
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+struct initsteps_s
+{
+  FAR const struct esp_initstep_s *steps;
+  int      nsteps;
+  uint32_t all;        /* Every step of the table */
+  uint32_t foreground; /* Steps the caller waits for */
+  uint32_t claimed;    /* Steps taken by a thread */
+  uint32_t done;       /* Steps completed or compiled out */
+  int      nwaiters;   /* Threads blocked on wakesem */
+  mutex_t  lock;
+  sem_t    wakesem;
+};
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+static struct initsteps_s g_initsteps =
+{
+  .lock    = NXMUTEX_INITIALIZER,
+  .wakesem = SEM_INITIALIZER(0),
+};
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: initsteps_exec
+ ****************************************************************************/
+
+static void initsteps_exec(FAR const struct esp_initstep_s *step)
+{
+  int ret;
+#ifdef CONFIG_BOARD_ESP32C3_BOOTPROF
+  int handle = esp_bootprof_begin(step->name);
+#endif
+
+  ret = step->init();
+
+#ifdef CONFIG_BOARD_ESP32C3_BOOTPROF
+  esp_bootprof_end(handle, ret);
+#endif
+
+  if (ret < 0)
+    {
+      syslog(LOG_ERR, "ERROR: Failed to initialize %s: %d\n",
+             step->name, ret);
+    }
+}
+
+#ifdef CONFIG_BOARD_ESP32C3_INITSTEPS_PARALLEL
+
+/****************************************************************************
+ * Name: initsteps_pick
+ *
+ * Description:
+ *   Return the first unclaimed step in 'allowed' whose dependencies are
+ *   all complete, or -1 if there is none.  Called with the lock held.
+ *
+ ****************************************************************************/
+
+static int initsteps_pick(FAR struct initsteps_s *s, uint32_t allowed)
+{
+  uint32_t bit;
+  int i;
+
+  for (i = 0; i < s->nsteps; i++)
+    {
+      bit = INITSTEP_BIT(i);
+      if ((allowed & bit) != 0 && (s->claimed & bit) == 0 &&
+          (s->steps[i].deps & ~s->done) == 0)
+        {
+          return i;
+        }
+    }
+
+  return -1;
+}
+
+/****************************************************************************
+ * Name: initsteps_work
+ *
+ * Description:
+ *   Run steps from 'allowed' as they become ready until every step in
+ *   'until' has completed.
+ *
+ ****************************************************************************/
+
+static void initsteps_work(FAR struct initsteps_s *s, uint32_t allowed,
+                           uint32_t until)
+{
+  int i;
+
+  nxmutex_lock(&s->lock);
+
+  while ((s->done & until) != until)
+    {
+      i = initsteps_pick(s, allowed);
+      if (i < 0)
+        {
+          s->nwaiters++;
+          nxmutex_unlock(&s->lock);
+          nxsem_wait_uninterruptible(&s->wakesem);
+          nxmutex_lock(&s->lock);
+          continue;
+        }
+
+      s->claimed |= INITSTEP_BIT(i);
+      nxmutex_unlock(&s->lock);
+
+      initsteps_exec(&s->steps[i]);
+
+      nxmutex_lock(&s->lock);
+      s->done |= INITSTEP_BIT(i);
+
+      /* The completion may have made other steps ready, or finished the
+       * wait of the caller: wake every waiter to re-evaluate.
+       */
+
+      while (s->nwaiters > 0)
+        {
+          s->nwaiters--;
+          nxsem_post(&s->wakesem);
+        }
+    }
+
+  nxmutex_unlock(&s->lock);
+}
+
+/****************************************************************************
+ * Name: initsteps_worker
+ ****************************************************************************/
+
+static int initsteps_worker(int argc, FAR char *argv[])
+{
+  FAR struct initsteps_s *s = &g_initsteps;
+
+  initsteps_work(s, s->all, s->all);
+  return OK;
+}
+
+#endif /* CONFIG_BOARD_ESP32C3_INITSTEPS_PARALLEL */
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: esp_initsteps_run
+ *
+ * Description:
+ *   Run a table of bringup steps.  Each step lists in 'deps' the steps
+ *   that must have completed before it may start, and only steps earlier
+ *   in the table may be listed.  Steps with a NULL init function are
+ *   treated as already complete.
+ *
+ *   With CONFIG_BOARD_ESP32C3_INITSTEPS_PARALLEL the caller and a set of
+ *   worker threads run independent steps concurrently, and the caller
+ *   returns as soon as all steps not flagged INITSTEP_BACKGROUND are
+ *   done.  Otherwise every step runs in table order on the caller.
+ *
+ * Returned Value:
+ *   Zero (OK) is returned on success; A negated errno value is returned
+ *   to indicate the nature of any failure.  Failures of individual steps
+ *   are logged and do not stop the others.
+ *
+ ****************************************************************************/
+
+int esp_initsteps_run(FAR const struct esp_initstep_s *steps, int nsteps)
+{
+  FAR struct initsteps_s *s = &g_initsteps;
+  int i;
+#ifdef CONFIG_BOARD_ESP32C3_INITSTEPS_PARALLEL
+  int pid;
+#endif
+
+  DEBUGASSERT(steps != NULL && nsteps > 0 && nsteps <= 32);
+  DEBUGASSERT(s->steps == NULL);
+
+  s->steps  = steps;
+  s->nsteps = nsteps;
+
+  for (i = 0; i < nsteps; i++)
+    {
+      /* Dependencies on later steps could never be satisfied */
+
+      DEBUGASSERT((steps[i].deps & ~(INITSTEP_BIT(i) - 1)) == 0);
+
+      s->all |= INITSTEP_BIT(i);
+
+      if (steps[i].init == NULL)
+        {
+          s->claimed |= INITSTEP_BIT(i);
+          s->done    |= INITSTEP_BIT(i);
+        }
+      else if ((steps[i].flags & INITSTEP_BACKGROUND) == 0)
+        {
+          s->foreground |= INITSTEP_BIT(i);
+        }
+    }
+
+#ifdef CONFIG_BOARD_ESP32C3_INITSTEPS_PARALLEL
+  for (i = 0; i < CONFIG_BOARD_ESP32C3_INITSTEPS_NWORKERS; i++)
+    {
+      pid = kthread_create("initstep",
+                           CONFIG_BOARD_ESP32C3_INITSTEPS_PRIORITY,
+                           CONFIG_BOARD_ESP32C3_INITSTEPS_STACKSIZE,
+                           initsteps_worker, NULL);
+      if (pid < 0)
+        {
+          /* The caller and the workers already started still cover the
+           * foreground steps.  Background steps need at least one worker.
+           */
+
+          syslog(LOG_ERR, "ERROR: Failed to start bringup worker: %d\n",
+                 pid);
+          break;
+        }
+    }
+
+  if (i == 0)
+    {
+      s->foreground = s->all;
+    }
+
+  /* Help with the steps that NSH depends on, then let it start */
+
+  initsteps_work(s, s->foreground, s->foreground);
+#else
+  for (i = 0; i < nsteps; i++)
+    {
+      if (steps[i].init != NULL)
+        {
+          initsteps_exec(&steps[i]);
+        }
+    }
+
+  s->done = s->all;
+#endif
+
+  return OK;
+}
@@ -0,0 +1,631 @@
+/****************************************************************************
+ * boards/risc-v/esp32c3/esp32c3-generic/src/esp32c3_twdt.c
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <sys/types.h>
+#include <sys/param.h>
+#include <sys/stat.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <sched.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <syslog.h>
+#include <debug.h>
+
+#include <nuttx/clock.h>
+#include <nuttx/compiler.h>
+#include <nuttx/crc32.h>
+#include <nuttx/kmalloc.h>
+#include <nuttx/kthread.h>
+#include <nuttx/sched.h>
+#include <nuttx/signal.h>
+#include <nuttx/spinlock.h>
+#include <nuttx/wqueue.h>
+#include <nuttx/fs/fs.h>
+#include <nuttx/fs/procfs.h>
+#include <nuttx/timers/watchdog.h>
+
+#include "esp32c3-generic.h"
+
+#ifdef CONFIG_BOARD_ESP32C3_TWDT
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define TWDT_MAGIC       0x54574454 /* "TWDT" */
+#define TWDT_NAMELEN     16
+#define TWDT_NSLOTS      CONFIG_BOARD_ESP32C3_TWDT_NSLOTS
+#define TWDT_NFRAMES     16
+#define TWDT_CHECK_US    (CONFIG_BOARD_ESP32C3_TWDT_CHECK_MS * 1000)
+#define TWDT_WQ_TIMEOUT  CONFIG_BOARD_ESP32C3_TWDT_WQ_TIMEOUT_MS
+#define TWDT_LINELEN     64
+
+/* RTC slow memory that the startup code leaves untouched, so that the
+ * stall record survives the watchdog reset.  The CRC rejects it after a
+ * power-on reset.
+ */
+
+#define TWDT_NOINIT      locate_data(".rtc_noinit")
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+struct twdt_slot_s
+{
+  char     name[TWDT_NAMELEN];
+  pid_t    pid;              /* Thread checking in, for the backtrace */
+  clock_t  timeout;          /* Longest time between check-ins (ticks) */
+  clock_t  lastfeed;         /* Time of the last check-in */
+  bool     inuse;
+};
+
+/* What the previous boot saw before the hardware watchdog reset it */
+
+struct twdt_stall_s
+{
+  uint32_t  magic;           /* TWDT_MAGIC if valid */
+  uint32_t  crc;             /* CRC-32 of the rest */
+  char      name[TWDT_NAMELEN];
+  int32_t   pid;
+  uint32_t  uptime;          /* Time of the stall since boot (ms) */
+  uint32_t  overdue;         /* Time past the deadline (ms) */
+  uint32_t  nframes;
+  uintptr_t frames[TWDT_NFRAMES];
+};
+
+struct twdt_s
+{
+  spinlock_t lock;
+  struct file wdog;          /* The hardware watchdog */
+  bool       fired;          /* A deadline was missed, the feeding stopped */
+  struct twdt_slot_s slots[TWDT_NSLOTS];
+
+  /* Probes checking that the work queues run */
+
+#ifdef CONFIG_SCHED_HPWORK
+  struct work_s hpprobe;
+  int           hpslot;
+#endif
+#ifdef CONFIG_SCHED_LPWORK
+  struct work_s lpprobe;
+  int           lpslot;
+#endif
+};
+
+struct twdt_file_s
+{
+  struct procfs_file_s base;       /* Base open file structure */
+  char line[TWDT_LINELEN];         /* Pre-allocated buffer for lines */
+};
+
+/****************************************************************************
+ * Private Function Prototypes
+ ****************************************************************************/
+
+static int     twdt_open(FAR struct file *filep, FAR const char *relpath,
+                         int oflags, mode_t mode);
+static int     twdt_close(FAR struct file *filep);
+static ssize_t twdt_read(FAR struct file *filep, FAR char *buffer,
+                         size_t buflen);
+static int     twdt_dup(FAR const struct file *oldp,
+                        FAR struct file *newp);
+static int     twdt_stat(FAR const char *relpath, FAR struct stat *buf);
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+static struct twdt_s g_twdt =
+{
+  .lock = SP_UNLOCKED,
+};
+
+/* Written when a deadline is missed, read back on the next boot */
+
+static struct twdt_stall_s g_twdt_rtc TWDT_NOINIT;
+
+/* Stall of the previous boot, if any */
+
+static struct twdt_stall_s g_twdt_last;
+
+static const struct procfs_operations g_twdt_operations =
+{
+  .open  = twdt_open,
+  .close = twdt_close,
+  .read  = twdt_read,
+  .dup   = twdt_dup,
+  .stat  = twdt_stat,
+};
+
+static const struct procfs_entry_s g_twdt_entry =
+{
+  "twdt", &g_twdt_operations, PROCFS_FILE_TYPE
+};
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: twdt_crc
+ ****************************************************************************/
+
+static uint32_t twdt_crc(FAR const struct twdt_stall_s *stall)
+{
+  return crc32((FAR const uint8_t *)stall->name,
+               sizeof(*stall) - offsetof(struct twdt_stall_s, name));
+}
+
+/****************************************************************************
+ * Name: twdt_probe
+ *
+ * Description:
+ *   Work queue probe.  It checks in for the queue it runs on.
+ *
+ ****************************************************************************/
+
+#if defined(CONFIG_SCHED_HPWORK) || defined(CONFIG_SCHED_LPWORK)
+static void twdt_probe(FAR void *arg)
+{
+  int id = (int)(intptr_t)arg;
+
+  g_twdt.slots[id].pid = nxsched_gettid();
+  esp_twdt_feed(id);
+}
+#endif
+
+/****************************************************************************
+ * Name: twdt_fire
+ *
+ * Description:
+ *   Save the thread that missed its deadline and its backtrace in RTC
+ *   memory.  The caller then stops feeding the hardware watchdog.
+ *
+ ****************************************************************************/
+
+static void twdt_fire(FAR const struct twdt_slot_s *slot, clock_t now)
+{
+  FAR struct twdt_stall_s *stall = &g_twdt_rtc;
+  int i;
+
+  memset(stall, 0, sizeof(*stall));
+  strlcpy(stall->name, slot->name, TWDT_NAMELEN);
+  stall->pid     = slot->pid;
+  stall->uptime  = TICK2MSEC(now);
+  stall->overdue = TICK2MSEC(now - slot->lastfeed - slot->timeout);
+
+#ifdef CONFIG_SCHED_BACKTRACE
+  if (slot->pid > 0)
+    {
+      int n = sched_backtrace(slot->pid, (FAR void **)stall->frames,
+                              TWDT_NFRAMES, 0);
+      stall->nframes = MAX(n, 0);
+    }
+#endif
+
+  stall->crc   = twdt_crc(stall);
+  stall->magic = TWDT_MAGIC;
+
+  syslog(LOG_EMERG, "Task watchdog: %s (%" PRId32 ") is %" PRIu32
+         " ms overdue, resetting\n", stall->name, stall->pid,
+         stall->overdue);
+
+  for (i = 0; i < (int)stall->nframes; i++)
+    {
+      syslog(LOG_EMERG, "  #%d %p\n", i, (FAR void *)stall->frames[i]);
+    }
+}
+
+/****************************************************************************
+ * Name: twdt_thread
+ *
+ * Description:
+ *   Check the deadlines and feed the hardware watchdog while they are all
+ *   met.  It runs at high priority so that a busy thread below it cannot
+ *   hide a stalled one.
+ *
+ ****************************************************************************/
+
+static int twdt_thread(int argc, FAR char *argv[])
+{
+  FAR struct twdt_s *twdt = &g_twdt;
+  struct twdt_slot_s slot;
+  irqstate_t flags;
+  clock_t now;
+  bool stalled;
+  int i;
+
+  for (; ; )
+    {
+      nxsig_usleep(TWDT_CHECK_US);
+
+#ifdef CONFIG_SCHED_HPWORK
+      if (twdt->hpslot >= 0 && work_available(&twdt->hpprobe))
+        {
+          work_queue(HPWORK, &twdt->hpprobe, twdt_probe,
+                     (FAR void *)(intptr_t)twdt->hpslot, 0);
+        }
+#endif
+
+#ifdef CONFIG_SCHED_LPWORK
+      if (twdt->lpslot >= 0 && work_available(&twdt->lpprobe))
+        {
+          work_queue(LPWORK, &twdt->lpprobe, twdt_probe,
+                     (FAR void *)(intptr_t)twdt->lpslot, 0);
+        }
+#endif
+
+      if (twdt->fired)
+        {
+          continue;
+        }
+
+      stalled = false;
+      now     = clock_systime_ticks();
+
+      flags = spin_lock_irqsave(&twdt->lock);
+
+      for (i = 0; i < TWDT_NSLOTS; i++)
+        {
+          if (twdt->slots[i].inuse &&
+              now - twdt->slots[i].lastfeed > twdt->slots[i].timeout)
+            {
+              slot    = twdt->slots[i];
+              stalled = true;
+              break;
+            }
+        }
+
+      spin_unlock_irqrestore(&twdt->lock, flags);
+
+      if (stalled)
+        {
+          twdt->fired = true;
+          twdt_fire(&slot, now);
+        }
+      else
+        {
+          file_ioctl(&twdt->wdog, WDIOC_KEEPALIVE, 0);
+        }
+    }
+
+  return OK;
+}
+
+/****************************************************************************
+ * Name: twdt_open
+ ****************************************************************************/
+
+static int twdt_open(FAR struct file *filep, FAR const char *relpath,
+                     int oflags, mode_t mode)
+{
+  FAR struct twdt_file_s *priv;
+
+  /* This is a read-only file */
+
+  if ((oflags & O_WRONLY) != 0 || (oflags & O_RDONLY) == 0)
+    {
+      return -EACCES;
+    }
+
+  priv = kmm_zalloc(sizeof(struct twdt_file_s));
+  if (priv == NULL)
+    {
+      return -ENOMEM;
+    }
+
+  filep->f_priv = priv;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: twdt_close
+ ****************************************************************************/
+
+static int twdt_close(FAR struct file *filep)
+{
+  kmm_free(filep->f_priv);
+  filep->f_priv = NULL;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: twdt_read
+ *
+ * Description:
+ *   Report the watched threads with the time since they checked in, then
+ *   the stall that reset the previous boot, if any.
+ *
+ ****************************************************************************/
+
+static ssize_t twdt_read(FAR struct file *filep, FAR char *buffer,
+                         size_t buflen)
+{
+  FAR struct twdt_file_s *priv = filep->f_priv;
+  FAR struct twdt_stall_s *last = &g_twdt_last;
+  struct twdt_slot_s slot;
+  off_t offset = filep->f_pos;
+  size_t totalsize = 0;
+  size_t linesize;
+  size_t copysize;
+  irqstate_t flags;
+  clock_t now;
+  int i;
+
+  DEBUGASSERT(priv != NULL);
+
+  linesize = procfs_snprintf(priv->line, TWDT_LINELEN,
+                             "%-15s %5s %10s %10s\n",
+                             "NAME", "PID", "TIMEOUT", "AGE(ms)");
+  copysize = procfs_memcpy(priv->line, linesize, buffer, buflen, &offset);
+  totalsize += copysize;
+
+  now = clock_systime_ticks();
+
+  for (i = 0; i < TWDT_NSLOTS && totalsize < buflen; i++)
+    {
+      flags = spin_lock_irqsave(&g_twdt.lock);
+      slot  = g_twdt.slots[i];
+      spin_unlock_irqrestore(&g_twdt.lock, flags);
+
+      if (!slot.inuse)
+        {
+          continue;
+        }
+
+      linesize = procfs_snprintf(priv->line, TWDT_LINELEN,
+                                 "%-15s %5d %10lu %10lu\n",
+                                 slot.name, (int)slot.pid,
+                                 (unsigned long)TICK2MSEC(slot.timeout),
+                                 (unsigned long)
+                                 TICK2MSEC(now - slot.lastfeed));
+      copysize = procfs_memcpy(priv->line, linesize, buffer + totalsize,
+                               buflen - totalsize, &offset);
+      totalsize += copysize;
+    }
+
+  if (last->magic == TWDT_MAGIC && totalsize < buflen)
+    {
+      linesize = procfs_snprintf(priv->line, TWDT_LINELEN,
+                                 "Last stall: %s (%" PRId32 ") %" PRIu32
+                                 " ms overdue at %" PRIu32 " ms\n",
+                                 last->name, last->pid, last->overdue,
+                                 last->uptime);
+      copysize = procfs_memcpy(priv->line, linesize, buffer + totalsize,
+                               buflen - totalsize, &offset);
+      totalsize += copysize;
+
+      for (i = 0; i < (int)last->nframes && totalsize < buflen; i++)
+        {
+          linesize = procfs_snprintf(priv->line, TWDT_LINELEN,
+                                     "  #%d %p\n", i,
+                                     (FAR void *)last->frames[i]);
+          copysize = procfs_memcpy(priv->line, linesize,
+                                   buffer + totalsize, buflen - totalsize,
+                                   &offset);
+          totalsize += copysize;
+        }
+    }
+
+  filep->f_pos += totalsize;
+  return totalsize;
+}
+
+/****************************************************************************
+ * Name: twdt_dup
+ ****************************************************************************/
+
+static int twdt_dup(FAR const struct file *oldp, FAR struct file *newp)
+{
+  FAR struct twdt_file_s *newpriv;
+
+  newpriv = kmm_zalloc(sizeof(struct twdt_file_s));
+  if (newpriv == NULL)
+    {
+      return -ENOMEM;
+    }
+
+  memcpy(newpriv, oldp->f_priv, sizeof(struct twdt_file_s));
+  newp->f_priv = newpriv;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: twdt_stat
+ ****************************************************************************/
+
+static int twdt_stat(FAR const char *relpath, FAR struct stat *buf)
+{
+  memset(buf, 0, sizeof(struct stat));
+  buf->st_mode = S_IFREG | S_IROTH | S_IRGRP | S_IRUSR;
+  return OK;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: esp_twdt_initialize
+ *
+ * Description:
+ *   Report the stall that reset the previous boot, start the hardware
+ *   watchdog and the thread feeding it, and register /proc/twdt.  The
+ *   work queues are watched from the start.
+ *
+ ****************************************************************************/
+
+int esp_twdt_initialize(void)
+{
+  FAR struct twdt_s *twdt = &g_twdt;
+  FAR struct twdt_stall_s *last = &g_twdt_last;
+  int ret;
+  int i;
+
+  if (g_twdt_rtc.magic == TWDT_MAGIC &&
+      g_twdt_rtc.nframes <= TWDT_NFRAMES &&
+      g_twdt_rtc.crc == twdt_crc(&g_twdt_rtc))
+    {
+      *last = g_twdt_rtc;
+
+      syslog(LOG_WARNING, "WARNING: Reset by the task watchdog: %s (%"
+             PRId32 ") %" PRIu32 " ms overdue at %" PRIu32 " ms\n",
+             last->name, last->pid, last->overdue, last->uptime);
+
+      for (i = 0; i < (int)last->nframes; i++)
+        {
+          syslog(LOG_WARNING, "  #%d %p\n", i, (FAR void *)last->frames[i]);
+        }
+    }
+
+  g_twdt_rtc.magic = 0;
+
+  ret = file_open(&twdt->wdog, CONFIG_BOARD_ESP32C3_TWDT_DEVPATH, O_RDONLY);
+  if (ret < 0)
+    {
+      syslog(LOG_ERR, "ERROR: Failed to open %s: %d\n",
+             CONFIG_BOARD_ESP32C3_TWDT_DEVPATH, ret);
+      return ret;
+    }
+
+  ret = file_ioctl(&twdt->wdog, WDIOC_SETTIMEOUT,
+                   CONFIG_BOARD_ESP32C3_TWDT_HWTIMEOUT_MS);
+  if (ret >= 0)
+    {
+      ret = file_ioctl(&twdt->wdog, WDIOC_START, 0);
+    }
+
+  if (ret < 0)
+    {
+      syslog(LOG_ERR, "ERROR: Failed to start the watchdog: %d\n", ret);
+      file_close(&twdt->wdog);
+      return ret;
+    }
+
+#ifdef CONFIG_SCHED_HPWORK
+  twdt->hpslot = esp_twdt_register("hpwork", TWDT_WQ_TIMEOUT);
+#endif
+#ifdef CONFIG_SCHED_LPWORK
+  twdt->lpslot = esp_twdt_register("lpwork", TWDT_WQ_TIMEOUT);
+#endif
+
+  ret = kthread_create("twdt", CONFIG_BOARD_ESP32C3_TWDT_PRIORITY,
+                       CONFIG_BOARD_ESP32C3_TWDT_STACKSIZE,
+                       twdt_thread, NULL);
+  if (ret < 0)
+    {
+      syslog(LOG_ERR, "ERROR: Failed to start the task watchdog: %d\n",
+             ret);
+      file_ioctl(&twdt->wdog, WDIOC_STOP, 0);
+      file_close(&twdt->wdog);
+      return ret;
+    }
+
+  ret = procfs_register(&g_twdt_entry);
+  if (ret < 0)
+    {
+      syslog(LOG_ERR, "ERROR: Failed to register /proc/twdt: %d\n", ret);
+    }
+
+  return OK;
+}
+
+/****************************************************************************
+ * Name: esp_twdt_register
+ *
+ * Description:
+ *   Watch the calling thread.  It must call esp_twdt_feed() at least
+ *   every 'timeout_ms' milliseconds, or the board is reset with its name
+ *   and backtrace saved for the next boot.
+ *
+ * Returned Value:
+ *   The id to pass to esp_twdt_feed(), or -ENOSPC.
+ *
+ ****************************************************************************/
+
+int esp_twdt_register(FAR const char *name, unsigned int timeout_ms)
+{
+  FAR struct twdt_slot_s *slot;
+  irqstate_t flags;
+  int id;
+
+  flags = spin_lock_irqsave(&g_twdt.lock);
+
+  for (id = 0; id < TWDT_NSLOTS; id++)
+    {
+      slot = &g_twdt.slots[id];
+      if (!slot->inuse)
+        {
+          strlcpy(slot->name, name, TWDT_NAMELEN);
+          slot->pid      = nxsched_gettid();
+          slot->timeout  = MSEC2TICK(timeout_ms);
+          slot->lastfeed = clock_systime_ticks();
+          slot->inuse    = true;
+          break;
+        }
+    }
+
+  spin_unlock_irqrestore(&g_twdt.lock, flags);
+  return id < TWDT_NSLOTS ? id : -ENOSPC;
+}
+
+/****************************************************************************
+ * Name: esp_twdt_unregister
+ ****************************************************************************/
+
+void esp_twdt_unregister(int id)
+{
+  irqstate_t flags;
+
+  DEBUGASSERT(id >= 0 && id < TWDT_NSLOTS);
+
+  flags = spin_lock_irqsave(&g_twdt.lock);
+  g_twdt.slots[id].inuse = false;
+  spin_unlock_irqrestore(&g_twdt.lock, flags);
+}
+
+/****************************************************************************
+ * Name: esp_twdt_feed
+ *
+ * Description:
+ *   Check in for the watched thread 'id'.  Callable from interrupt
+ *   handlers.
+ *
+ ****************************************************************************/
+
+void esp_twdt_feed(int id)
+{
+  DEBUGASSERT(id >= 0 && id < TWDT_NSLOTS);
+
+  g_twdt.slots[id].lastfeed = clock_systime_ticks();
+}
+
+#endif /* CONFIG_BOARD_ESP32C3_TWDT */
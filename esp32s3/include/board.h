@@ -21,6 +21,16 @@
 #ifndef __BOARDS_XTENSA_ESP32S3_ESP32S3_EYE_INCLUDE_BOARD_H
 #define __BOARDS_XTENSA_ESP32S3_ESP32S3_EYE_INCLUDE_BOARD_H
 
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#if defined(CONFIG_BOARD_ESP32S3_HRTIME) && !defined(__ASSEMBLY__)
+#  include <nuttx/compiler.h>
+#  include <stdint.h>
+#  include <sys/boardctl.h>
+#endif
+
 /****************************************************************************
  * Pre-processor Definitions
  ****************************************************************************/
@@ -43,4 +53,81 @@
 
 #define BOARD_NLEDS             1
 
+/* High resolution time *****************************************************/
+
+/* boardctl(BOARDIOC_HRTIME_PAGE, (uintptr_t)&page) returns the address of
+ * the struct hrtime_page_s below.  Reading it needs no system call.  The
+ * board commands have the same numbers as on the ESP32, the ones only
+ * this board has come last.
+ */
+
+#define BOARDIOC_HRTIME_PAGE    (BOARDIOC_USER + 0)
+
+#define HRTIME_VERSION          1
+
+/* Thread placement *********************************************************/
+
+/* boardctl(BOARDIOC_AFFINITY_APPLY, 0) applies the thread placement plan to
+ * the threads running at that time and returns how many it placed.
+ */
+
+#define BOARDIOC_AFFINITY_APPLY (BOARDIOC_USER + 1)
+
+/* Light sleep **************************************************************/
+
+/* boardctl(BOARDIOC_UI_DEADLINE, usec) reports that the UI loop has nothing
+ * to do for the next 'usec' microseconds, see esp32s3_lsleep_deadline().
+ */
+
+#define BOARDIOC_UI_DEADLINE    (BOARDIOC_USER + 2)
+
+/****************************************************************************
+ * Public Types
+ ****************************************************************************/
+
+#if defined(CONFIG_BOARD_ESP32S3_HRTIME) && !defined(__ASSEMBLY__)
+
+/* Board time page.  read_us() is the RT timer, a monotonic microsecond
+ * count from the crystal that is cheaper than clock_gettime().
+ * read_cycles() is the cycle counter of the calling CPU, not synchronized
+ * between the CPUs, and its rate changes with BOARD_ESP32S3_DFS: read
+ * cycle_hz under 'seq' like the wall clock fields.  Those are refreshed
+ * from the RTC in the background, read them with hrtime_realtime_us().
+ */
+
+struct hrtime_page_s
+{
+  volatile uint32_t seq;             /* Odd while the page is updated */
+  uint32_t version;                  /* HRTIME_VERSION */
+  volatile uint32_t cycle_hz;        /* Rate of read_cycles() now */
+  volatile int32_t rtc_ppm;          /* RTC rate error vs read_us() */
+  volatile int64_t realtime_offset;  /* Wall clock minus read_us() (us) */
+  CODE uint64_t (*read_us)(void);
+  CODE uint32_t (*read_cycles)(void);
+};
+
+/****************************************************************************
+ * Inline Functions
+ ****************************************************************************/
+
+/* Microseconds since the epoch, by the RTC */
+
+static inline int64_t
+hrtime_realtime_us(FAR const struct hrtime_page_s *page)
+{
+  uint32_t seq;
+  int64_t us;
+
+  do
+    {
+      seq = page->seq;
+      us  = (int64_t)page->read_us() + page->realtime_offset;
+    }
+  while ((seq & 1) != 0 || seq != page->seq);
+
+  return us;
+}
+
+#endif /* CONFIG_BOARD_ESP32S3_HRTIME && !__ASSEMBLY__ */
+
 #endif /* __BOARDS_XTENSA_ESP32S3_ESP32S3_EYE_INCLUDE_BOARD_H */
@@ -20,8 +20,348 @@
 
 #pragma once
 
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+#include <nuttx/compiler.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef CONFIG_BOARDCTL_IOCTL
+#  include <sys/boardctl.h>
+#endif
+
+#ifdef CONFIG_BOARD_ESP32S3_PCOUNT
+#  include <sys/types.h>
+#endif
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+/* Bringup steps */
+
+#define INITSTEP_BIT(n)       (UINT32_C(1) << (n))
+
+#define INITSTEP_BACKGROUND   (1 << 0) /* NSH does not wait for the step */
+
+/* Boot profiling marks, see esp32s3_bootprof_mark() */
+
+#define BOOTPROF_BOARD_INIT   0 /* esp32s3_board_initialize() entered */
+#define BOOTPROF_LATE_INIT    1 /* board_late_initialize() entered */
+#define BOOTPROF_BRINGUP_DONE 2 /* Foreground bringup steps complete */
+#define BOOTPROF_NSH_START    3 /* NSH called board_app_initialize() */
+#define BOOTPROF_NMARKS       4
+
+/* Allocation capabilities, see esp32s3_caps_malloc() */
+
+#define HEAPCAP_INTERNAL      (1 << 0) /* Internal SRAM, low latency */
+#define HEAPCAP_DMA           (1 << 1) /* Usable by the GDMA */
+#define HEAPCAP_EXTERNAL      (1 << 2) /* PSRAM preferred, for bulk data */
+#define HEAPCAP_EXEC          (1 << 3) /* Executable */
+
+/* CPU frequency levels, see esp32s3_dfs_request() */
+
+#define DFS_LEVEL_80M         0
+#define DFS_LEVEL_160M        1
+#define DFS_LEVEL_240M        2
+#define DFS_NLEVELS           3
+
+/* Drivers with counters in /proc/board, see esp32s3_pcount_end() */
+
+#define PCOUNT_DISPLAY        0 /* ST7789 SPI traffic */
+#define PCOUNT_NIDS           1
+
+/****************************************************************************
+ * Public Types
+ ****************************************************************************/
+
+/* One step of the board bringup, see esp32s3_initsteps_run() */
+
+struct esp32s3_initstep_s
+{
+  FAR const char *name;      /* Name used in diagnostics */
+  CODE int (*init)(void);    /* NULL if compiled out */
+  uint32_t deps;             /* INITSTEP_BIT() of the steps it waits for */
+  uint8_t flags;             /* INITSTEP_* flags */
+};
+
 /****************************************************************************
  * Public Function Prototypes
  ****************************************************************************/
 
 int esp32s3_bringup(void);
+
+/****************************************************************************
+ * Name: esp32s3_initsteps_run
+ *
+ * Description:
+ *   Run a table of bringup steps, concurrently where their dependencies
+ *   allow it if CONFIG_BOARD_ESP32S3_INITSTEPS_PARALLEL is selected.
+ *
+ * Input Parameters:
+ *   steps  - The step table, in dependency order
+ *   nsteps - Number of entries in the table (32 at most)
+ *
+ * Returned Value:
+ *   Zero (OK) is returned on success; A negated errno value is returned
+ *   to indicate the nature of any failure.
+ *
+ ****************************************************************************/
+
+int esp32s3_initsteps_run(FAR const struct esp32s3_initstep_s *steps,
+                          int nsteps);
+
+/****************************************************************************
+ * Name: esp32s3_bootprof_initialize
+ *
+ * Description:
+ *   Register /proc/boardinit, which reports the time at which each boot
+ *   phase was reached and the duration, return code and heap usage of
+ *   every bringup step.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32S3_BOOTPROF
+int esp32s3_bootprof_initialize(void);
+#endif
+
+/****************************************************************************
+ * Name: esp32s3_bootprof_mark
+ *
+ * Description:
+ *   Record the time at which the boot phase BOOTPROF_<mark> was reached.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32S3_BOOTPROF
+void esp32s3_bootprof_mark(int mark);
+#endif
+
+/****************************************************************************
+ * Name: esp32s3_bootprof_begin / esp32s3_bootprof_end
+ *
+ * Description:
+ *   Time a bringup step.  esp32s3_bootprof_begin() returns the handle to
+ *   pass to esp32s3_bootprof_end() together with the result of the step.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32S3_BOOTPROF
+int esp32s3_bootprof_begin(FAR const char *name);
+void esp32s3_bootprof_end(int handle, int ret);
+#endif
+
+/****************************************************************************
+ * Name: esp32s3_heapcaps_initialize
+ *
+ * Description:
+ *   Set up the internal and PSRAM pools used by esp32s3_caps_malloc() and
+ *   register /proc/heapcaps.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32S3_HEAPCAPS
+int esp32s3_heapcaps_initialize(void);
+#endif
+
+/****************************************************************************
+ * Name: esp32s3_caps_malloc / esp32s3_caps_free
+ *
+ * Description:
+ *   Allocate memory placed according to the HEAPCAP_* flags in 'caps',
+ *   and release it.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32S3_HEAPCAPS
+FAR void *esp32s3_caps_malloc(size_t size, uint32_t caps);
+void esp32s3_caps_free(FAR void *mem);
+#endif
+
+/****************************************************************************
+ * Name: esp32s3_affinity_apply
+ *
+ * Description:
+ *   Pin the threads named in CONFIG_BOARD_ESP32S3_AFFINITY_PLAN to their
+ *   CPU and set their priority.
+ *
+ * Returned Value:
+ *   The number of threads placed, or a negated errno value.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32S3_AFFINITY
+int esp32s3_affinity_apply(void);
+#endif
+
+/****************************************************************************
+ * Name: esp32s3_affinity_initialize
+ *
+ * Description:
+ *   Start the per-CPU jitter probes and register /proc/jitter.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32S3_AFFINITY_JITTER
+int esp32s3_affinity_initialize(void);
+#endif
+
+/****************************************************************************
+ * Name: esp32s3_dfs_initialize
+ *
+ * Description:
+ *   Start the CPU frequency governor.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32S3_DFS
+int esp32s3_dfs_initialize(void);
+#endif
+
+/****************************************************************************
+ * Name: esp32s3_dfs_request / esp32s3_dfs_release / esp32s3_dfs_hold
+ *
+ * Description:
+ *   Keep the CPU frequency at DFS_LEVEL_* 'level' or above, until the
+ *   matching release or for 'ms' milliseconds.  Drivers call them around
+ *   activity that needs CPU time the load average does not show yet.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32S3_DFS
+void esp32s3_dfs_request(int level);
+void esp32s3_dfs_release(int level);
+void esp32s3_dfs_hold(int level, unsigned int ms);
+#endif
+
+/****************************************************************************
+ * Name: esp32s3_dfs_freq
+ *
+ * Description:
+ *   Return the CPU frequency in MHz, and in 'nswitch' if not NULL the
+ *   number of frequency changes since boot.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32S3_DFS
+int esp32s3_dfs_freq(FAR uint32_t *nswitch);
+#endif
+
+/****************************************************************************
+ * Name: esp32s3_lsleep_initialize
+ *
+ * Description:
+ *   Start the light sleep thread and register /proc/lsleep.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32S3_LSLEEP
+int esp32s3_lsleep_initialize(void);
+#endif
+
+/****************************************************************************
+ * Name: esp32s3_lsleep_deadline
+ *
+ * Description:
+ *   Tell the board that the UI has nothing to do for the next 'usec'
+ *   microseconds.  The CPU enters light sleep until shortly before then,
+ *   or until the next timer event, if every other thread is blocked; the
+ *   button and the touch panel wake it early.  Applications reach it with
+ *   boardctl(BOARDIOC_UI_DEADLINE, usec).
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32S3_LSLEEP
+int esp32s3_lsleep_deadline(uint32_t usec);
+#endif
+
+/****************************************************************************
+ * Name: esp32s3_pcount_initialize
+ *
+ * Description:
+ *   Register /proc/board with the counters of every PCOUNT_* driver.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32S3_PCOUNT
+int esp32s3_pcount_initialize(void);
+#endif
+
+/****************************************************************************
+ * Name: esp32s3_pcount_begin / esp32s3_pcount_end
+ *
+ * Description:
+ *   Time a transaction of the PCOUNT_* driver 'id' and account it with
+ *   the 'nbytes' it moved and its result 'ret'.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32S3_PCOUNT
+uint64_t esp32s3_pcount_begin(void);
+void esp32s3_pcount_end(int id, uint64_t start, size_t nbytes, int ret);
+#endif
+
+/****************************************************************************
+ * Name: esp32s3_stkmon_initialize
+ *
+ * Description:
+ *   Start sampling the stacks and register /proc/stkmon, which shows their
+ *   peak use over the boots kept in RTC memory and a recommended size.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32S3_STKMON
+int esp32s3_stkmon_initialize(void);
+#endif
+
+/****************************************************************************
+ * Name: esp32s3_twdt_initialize
+ *
+ * Description:
+ *   Start the task watchdog on CONFIG_BOARD_ESP32S3_TWDT_DEVPATH and
+ *   report the stall that reset the previous boot, if any.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32S3_TWDT
+int esp32s3_twdt_initialize(void);
+#endif
+
+/****************************************************************************
+ * Name: esp32s3_twdt_register / esp32s3_twdt_unregister /
+ *       esp32s3_twdt_feed
+ *
+ * Description:
+ *   Watch the calling thread, which must check in with esp32s3_twdt_feed()
+ *   at least every 'timeout_ms' milliseconds.  A missed deadline resets
+ *   the board, with the thread name and backtrace saved for the next boot.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32S3_TWDT
+int esp32s3_twdt_register(FAR const char *name, unsigned int timeout_ms);
+void esp32s3_twdt_unregister(int id);
+void esp32s3_twdt_feed(int id);
+#endif
+
+/****************************************************************************
+ * Name: esp32s3_hrtime_initialize / esp32s3_hrtime_page /
+ *       esp32s3_hrtime_setfreq
+ *
+ * Description:
+ *   Set up the time page returned by boardctl(BOARDIOC_HRTIME_PAGE) and
+ *   keep its wall clock offset calibrated against the RTC.  The DFS
+ *   governor reports each CPU clock change with esp32s3_hrtime_setfreq().
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32S3_HRTIME
+struct hrtime_page_s;
+
+int esp32s3_hrtime_initialize(void);
+FAR const struct hrtime_page_s *esp32s3_hrtime_page(void);
+void esp32s3_hrtime_setfreq(uint32_t hz);
+#endif
@@ -0,0 +1,590 @@
+/****************************************************************************
+ * boards/xtensa/esp32s3/esp32s3-eye/src/esp32s3_affinity.c
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <syslog.h>
+#include <debug.h>
+
+#include <nuttx/clock.h>
+#include <nuttx/kmalloc.h>
+#include <nuttx/kthread.h>
+#include <nuttx/sched.h>
+#include <nuttx/signal.h>
+#include <nuttx/spinlock.h>
+#include <nuttx/fs/fs.h>
+#include <nuttx/fs/procfs.h>
+
+#ifdef CONFIG_BOARD_ESP32S3_AFFINITY_JITTER
+#  include "esp32s3_rt_timer.h"
+#endif
+
+#include "board.h"
+
+#ifdef CONFIG_BOARD_ESP32S3_AFFINITY
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#if CONFIG_TASK_NAME_SIZE == 0
+#  error "The thread placement plan needs CONFIG_TASK_NAME_SIZE > 0"
+#endif
+
+#define AFFINITY_PLAN      CONFIG_BOARD_ESP32S3_AFFINITY_PLAN
+#define AFFINITY_NENTRIES  16
+#define AFFINITY_NTASKS    32
+#define AFFINITY_ANYCPU    -1
+
+#define JITTER_LINELEN     64
+#define JITTER_PERIOD_US   (CONFIG_BOARD_ESP32S3_AFFINITY_JITTER_PERIOD_MS * \
+                            USEC_PER_MSEC)
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+/* One "name:cpu:prio" entry of the plan */
+
+struct affinity_entry_s
+{
+  FAR const char *name;      /* Thread name, a trailing '*' matches any end */
+  int cpu;                   /* AFFINITY_ANYCPU to leave the affinity */
+  int prio;                  /* Zero to leave the priority */
+};
+
+struct affinity_task_s
+{
+  pid_t pid;
+  char name[CONFIG_TASK_NAME_SIZE + 1];
+};
+
+struct affinity_s
+{
+  int nentries;
+  int ntasks;
+  struct affinity_entry_s entries[AFFINITY_NENTRIES];
+  struct affinity_task_s tasks[AFFINITY_NTASKS];
+  char plan[sizeof(AFFINITY_PLAN)];
+};
+
+#ifdef CONFIG_BOARD_ESP32S3_AFFINITY_JITTER
+/* Wake-up intervals of the probe thread of one CPU */
+
+struct jitter_cpu_s
+{
+  uint32_t nsamples;
+  uint32_t min;              /* Shortest interval in microseconds */
+  uint32_t max;              /* Longest interval in microseconds */
+};
+
+struct jitter_file_s
+{
+  struct procfs_file_s base;       /* Base open file structure */
+  char line[JITTER_LINELEN];       /* Pre-allocated buffer for lines */
+};
+
+/****************************************************************************
+ * Private Function Prototypes
+ ****************************************************************************/
+
+static int     jitter_open(FAR struct file *filep, FAR const char *relpath,
+                           int oflags, mode_t mode);
+static int     jitter_close(FAR struct file *filep);
+static ssize_t jitter_read(FAR struct file *filep, FAR char *buffer,
+                           size_t buflen);
+static int     jitter_dup(FAR const struct file *oldp,
+                          FAR struct file *newp);
+static int     jitter_stat(FAR const char *relpath, FAR struct stat *buf);
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+static struct jitter_cpu_s g_jitter[CONFIG_SMP_NCPUS];
+static spinlock_t g_jitter_lock = SP_UNLOCKED;
+
+static const struct procfs_operations g_jitter_operations =
+{
+  .open  = jitter_open,
+  .close = jitter_close,
+  .read  = jitter_read,
+  .dup   = jitter_dup,
+  .stat  = jitter_stat,
+};
+
+static const struct procfs_entry_s g_jitter_entry =
+{
+  "jitter", &g_jitter_operations, PROCFS_FILE_TYPE
+};
+#endif
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: affinity_parse
+ *
+ * Description:
+ *   Split the plan into entries.  Entries are separated by commas or
+ *   spaces, the priority may be omitted and the CPU may be '*'.
+ *
+ ****************************************************************************/
+
+static void affinity_parse(FAR struct affinity_s *aff)
+{
+  FAR struct affinity_entry_s *entry;
+  FAR char *saveptr;
+  FAR char *name;
+  FAR char *cpu;
+  FAR char *prio;
+
+  strlcpy(aff->plan, AFFINITY_PLAN, sizeof(aff->plan));
+
+  for (name = strtok_r(aff->plan, ", ", &saveptr);
+       name != NULL && aff->nentries < AFFINITY_NENTRIES;
+       name = strtok_r(NULL, ", ", &saveptr))
+    {
+      entry = &aff->entries[aff->nentries];
+
+      cpu = strchr(name, ':');
+      if (cpu == NULL)
+        {
+          syslog(LOG_ERR, "ERROR: No CPU in placement entry %s\n", name);
+          continue;
+        }
+
+      *cpu++ = '\0';
+      prio   = strchr(cpu, ':');
+      if (prio != NULL)
+        {
+          *prio++ = '\0';
+        }
+
+      entry->name = name;
+      entry->cpu  = *cpu == '*' ? AFFINITY_ANYCPU : atoi(cpu);
+      entry->prio = prio != NULL ? atoi(prio) : 0;
+
+      if (entry->cpu >= CONFIG_SMP_NCPUS ||
+          entry->cpu < AFFINITY_ANYCPU ||
+          (entry->prio != 0 && (entry->prio < SCHED_PRIORITY_MIN ||
+                                entry->prio > SCHED_PRIORITY_MAX)))
+        {
+          syslog(LOG_ERR, "ERROR: Bad placement entry %s:%s\n", name, cpu);
+          continue;
+        }
+
+      aff->nentries++;
+    }
+}
+
+/****************************************************************************
+ * Name: affinity_collect
+ *
+ * Description:
+ *   nxsched_foreach() callback taking a snapshot of the running threads.
+ *   The plan is applied outside of the scheduler walk.
+ *
+ ****************************************************************************/
+
+static void affinity_collect(FAR struct tcb_s *tcb, FAR void *arg)
+{
+  FAR struct affinity_s *aff = arg;
+  FAR struct affinity_task_s *task;
+
+  /* The first CONFIG_SMP_NCPUS PIDs are the idle threads */
+
+  if (tcb->pid < CONFIG_SMP_NCPUS || aff->ntasks >= AFFINITY_NTASKS)
+    {
+      return;
+    }
+
+  task      = &aff->tasks[aff->ntasks++];
+  task->pid = tcb->pid;
+  strlcpy(task->name, tcb->name, sizeof(task->name));
+}
+
+/****************************************************************************
+ * Name: affinity_match
+ ****************************************************************************/
+
+static bool affinity_match(FAR const char *pattern, FAR const char *name)
+{
+  size_t len = strlen(pattern);
+
+  if (len > 0 && pattern[len - 1] == '*')
+    {
+      return strncmp(pattern, name, len - 1) == 0;
+    }
+
+  return strcmp(pattern, name) == 0;
+}
+
+/****************************************************************************
+ * Name: affinity_place
+ *
+ * Description:
+ *   Move one thread as its entry says.  A thread that exited since the
+ *   snapshot is silently skipped.
+ *
+ ****************************************************************************/
+
+static int affinity_place(FAR struct affinity_task_s *task,
+                          FAR const struct affinity_entry_s *entry)
+{
+  struct sched_param param;
+  cpu_set_t cpuset;
+  int ret = OK;
+
+  if (entry->cpu != AFFINITY_ANYCPU)
+    {
+      CPU_ZERO(&cpuset);
+      CPU_SET(entry->cpu, &cpuset);
+      ret = nxsched_set_affinity(task->pid, sizeof(cpuset), &cpuset);
+    }
+
+  if (ret >= 0 && entry->prio != 0)
+    {
+      param.sched_priority = entry->prio;
+      ret = nxsched_set_param(task->pid, &param);
+    }
+
+  if (ret < 0 && ret != -ESRCH)
+    {
+      syslog(LOG_ERR, "ERROR: Failed to place %s (%d): %d\n",
+             task->name, task->pid, ret);
+    }
+
+  return ret;
+}
+
+#ifdef CONFIG_BOARD_ESP32S3_AFFINITY_JITTER
+
+/****************************************************************************
+ * Name: jitter_reset
+ ****************************************************************************/
+
+static void jitter_reset(void)
+{
+  irqstate_t flags;
+
+  flags = spin_lock_irqsave(&g_jitter_lock);
+  memset(g_jitter, 0, sizeof(g_jitter));
+  spin_unlock_irqrestore(&g_jitter_lock, flags);
+}
+
+/****************************************************************************
+ * Name: jitter_probe
+ *
+ * Description:
+ *   Sleep for the probe period again and again on one CPU and record the
+ *   shortest and the longest time between two wake-ups, measured with the
+ *   RT timer.  The spread is the scheduling jitter seen on that CPU at
+ *   the probe priority.
+ *
+ ****************************************************************************/
+
+static int jitter_probe(int argc, FAR char *argv[])
+{
+  FAR struct jitter_cpu_s *jit;
+  irqstate_t flags;
+  uint64_t last;
+  uint64_t now;
+  uint32_t interval;
+
+  DEBUGASSERT(argc > 1);
+  jit  = &g_jitter[atoi(argv[1])];
+  last = esp32s3_rt_timer_time_us();
+
+  for (; ; )
+    {
+      nxsig_usleep(JITTER_PERIOD_US);
+
+      now      = esp32s3_rt_timer_time_us();
+      interval = (uint32_t)(now - last);
+      last     = now;
+
+      flags = spin_lock_irqsave(&g_jitter_lock);
+
+      if (jit->nsamples == 0 || interval < jit->min)
+        {
+          jit->min = interval;
+        }
+
+      if (interval > jit->max)
+        {
+          jit->max = interval;
+        }
+
+      jit->nsamples++;
+
+      spin_unlock_irqrestore(&g_jitter_lock, flags);
+    }
+
+  return OK;
+}
+
+/****************************************************************************
+ * Name: jitter_open
+ ****************************************************************************/
+
+static int jitter_open(FAR struct file *filep, FAR const char *relpath,
+                       int oflags, mode_t mode)
+{
+  FAR struct jitter_file_s *priv;
+
+  /* This is a read-only file */
+
+  if ((oflags & O_WRONLY) != 0 || (oflags & O_RDONLY) == 0)
+    {
+      return -EACCES;
+    }
+
+  priv = kmm_zalloc(sizeof(struct jitter_file_s));
+  if (priv == NULL)
+    {
+      return -ENOMEM;
+    }
+
+  filep->f_priv = priv;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: jitter_close
+ ****************************************************************************/
+
+static int jitter_close(FAR struct file *filep)
+{
+  kmm_free(filep->f_priv);
+  filep->f_priv = NULL;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: jitter_read
+ ****************************************************************************/
+
+static ssize_t jitter_read(FAR struct file *filep, FAR char *buffer,
+                           size_t buflen)
+{
+  FAR struct jitter_file_s *priv = filep->f_priv;
+  struct jitter_cpu_s jit[CONFIG_SMP_NCPUS];
+  off_t offset = filep->f_pos;
+  size_t totalsize = 0;
+  size_t linesize;
+  size_t copysize;
+  irqstate_t flags;
+  int i;
+
+  DEBUGASSERT(priv != NULL);
+
+  flags = spin_lock_irqsave(&g_jitter_lock);
+  memcpy(jit, g_jitter, sizeof(jit));
+  spin_unlock_irqrestore(&g_jitter_lock, flags);
+
+  linesize = procfs_snprintf(priv->line, JITTER_LINELEN,
+                             "%-4s %8s %8s %8s %8s\n",
+                             "CPU", "SAMPLES", "MIN_US", "MAX_US",
+                             "JITTER");
+  copysize = procfs_memcpy(priv->line, linesize, buffer, buflen, &offset);
+  totalsize += copysize;
+
+  for (i = 0; i < CONFIG_SMP_NCPUS && totalsize < buflen; i++)
+    {
+      linesize = procfs_snprintf(priv->line, JITTER_LINELEN,
+                                 "%-4d %8" PRIu32 " %8" PRIu32
+                                 " %8" PRIu32 " %8" PRIu32 "\n",
+                                 i, jit[i].nsamples, jit[i].min,
+                                 jit[i].max, jit[i].max - jit[i].min);
+      copysize = procfs_memcpy(priv->line, linesize, buffer + totalsize,
+                               buflen - totalsize, &offset);
+      totalsize += copysize;
+    }
+
+  filep->f_pos += totalsize;
+  return totalsize;
+}
+
+/****************************************************************************
+ * Name: jitter_dup
+ ****************************************************************************/
+
+static int jitter_dup(FAR const struct file *oldp, FAR struct file *newp)
+{
+  FAR struct jitter_file_s *newpriv;
+
+  newpriv = kmm_zalloc(sizeof(struct jitter_file_s));
+  if (newpriv == NULL)
+    {
+      return -ENOMEM;
+    }
+
+  memcpy(newpriv, oldp->f_priv, sizeof(struct jitter_file_s));
+  newp->f_priv = newpriv;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: jitter_stat
+ ****************************************************************************/
+
+static int jitter_stat(FAR const char *relpath, FAR struct stat *buf)
+{
+  memset(buf, 0, sizeof(struct stat));
+  buf->st_mode = S_IFREG | S_IROTH | S_IRGRP | S_IRUSR;
+  return OK;
+}
+
+#endif /* CONFIG_BOARD_ESP32S3_AFFINITY_JITTER */
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32S3_AFFINITY_JITTER
+
+/****************************************************************************
+ * Name: esp32s3_affinity_initialize
+ *
+ * Description:
+ *   Start a jitter probe thread, jitter<n>, pinned to each CPU n and
+ *   register /proc/jitter.
+ *
+ ****************************************************************************/
+
+int esp32s3_affinity_initialize(void)
+{
+  cpu_set_t cpuset;
+  char name[CONFIG_TASK_NAME_SIZE + 1];
+  char arg[4];
+  FAR char *argv[2];
+  int pid;
+  int cpu;
+
+  argv[0] = arg;
+  argv[1] = NULL;
+
+  for (cpu = 0; cpu < CONFIG_SMP_NCPUS; cpu++)
+    {
+      snprintf(name, sizeof(name), "jitter%d", cpu);
+      snprintf(arg, sizeof(arg), "%d", cpu);
+      pid = kthread_create(name,
+                           CONFIG_BOARD_ESP32S3_AFFINITY_JITTER_PRIORITY,
+                           CONFIG_DEFAULT_TASK_STACKSIZE, jitter_probe,
+                           argv);
+      if (pid < 0)
+        {
+          syslog(LOG_ERR, "ERROR: Failed to start jitter probe %d: %d\n",
+                 cpu, pid);
+          return pid;
+        }
+
+      CPU_ZERO(&cpuset);
+      CPU_SET(cpu, &cpuset);
+      nxsched_set_affinity(pid, sizeof(cpuset), &cpuset);
+    }
+
+  /* Drop what was measured before the threads were pinned */
+
+  jitter_reset();
+  return procfs_register(&g_jitter_entry);
+}
+
+#endif /* CONFIG_BOARD_ESP32S3_AFFINITY_JITTER */
+
+/****************************************************************************
+ * Name: esp32s3_affinity_apply
+ *
+ * Description:
+ *   Pin the running threads named in CONFIG_BOARD_ESP32S3_AFFINITY_PLAN to
+ *   their CPU and set their priority.  The first matching entry wins.
+ *   Called at the end of the bringup, again when NSH starts, and by
+ *   applications through boardctl(BOARDIOC_AFFINITY_APPLY) once they have
+ *   started their own threads.  The jitter figures restart from there.
+ *
+ * Returned Value:
+ *   The number of threads placed, or -ENOMEM.
+ *
+ ****************************************************************************/
+
+int esp32s3_affinity_apply(void)
+{
+  FAR struct affinity_s *aff;
+  FAR struct affinity_task_s *task;
+  FAR struct affinity_entry_s *entry;
+  int nplaced = 0;
+  int i;
+  int j;
+
+  aff = kmm_zalloc(sizeof(struct affinity_s));
+  if (aff == NULL)
+    {
+      return -ENOMEM;
+    }
+
+  affinity_parse(aff);
+  nxsched_foreach(affinity_collect, aff);
+
+  for (i = 0; i < aff->ntasks; i++)
+    {
+      task = &aff->tasks[i];
+
+      for (j = 0; j < aff->nentries; j++)
+        {
+          entry = &aff->entries[j];
+          if (affinity_match(entry->name, task->name))
+            {
+              if (affinity_place(task, entry) >= 0)
+                {
+                  nplaced++;
+                }
+
+              break;
+            }
+        }
+    }
+
+  kmm_free(aff);
+
+#ifdef CONFIG_BOARD_ESP32S3_AFFINITY_JITTER
+  jitter_reset();
+#endif
+
+  return nplaced;
+}
+
+#endif /* CONFIG_BOARD_ESP32S3_AFFINITY */
@@ -25,7 +25,9 @@
 #include <nuttx/config.h>
 
 #include <sys/types.h>
+#include <errno.h>
 #include <nuttx/board.h>
+#include <arch/board/board.h>
 
 #include "board.h"
 
@@ -66,8 +68,18 @@
 
 int board_app_initialize(uintptr_t arg)
 {
+#ifdef CONFIG_BOARD_ESP32S3_BOOTPROF
+  esp32s3_bootprof_mark(BOOTPROF_NSH_START);
+#endif
+
 #ifdef CONFIG_BOARD_LATE_INITIALIZE
-  /* Board initialization already performed by board_late_initialize() */
+  /* Board initialization already performed by board_late_initialize(),
+   * place the threads started since.
+   */
+
+#ifdef CONFIG_BOARD_ESP32S3_AFFINITY
+  esp32s3_affinity_apply();
+#endif
 
   return OK;
 #else
@@ -77,4 +89,44 @@ int board_app_initialize(uintptr_t arg)
 #endif
 }
 
+/****************************************************************************
+ * Name: board_ioctl
+ *
+ * Description:
+ *   Handle the board specific boardctl() commands.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARDCTL_IOCTL
+int board_ioctl(unsigned int cmd, uintptr_t arg)
+{
+  switch (cmd)
+    {
+#ifdef CONFIG_BOARD_ESP32S3_LSLEEP
+      case BOARDIOC_UI_DEADLINE:
+        return esp32s3_lsleep_deadline((uint32_t)arg);
+#endif
+
+#ifdef CONFIG_BOARD_ESP32S3_AFFINITY
+      case BOARDIOC_AFFINITY_APPLY:
+        return esp32s3_affinity_apply();
+#endif
+
+#ifdef CONFIG_BOARD_ESP32S3_HRTIME
+      case BOARDIOC_HRTIME_PAGE:
+        if (arg == 0)
+          {
+            return -EINVAL;
+          }
+
+        *(FAR const struct hrtime_page_s **)arg = esp32s3_hrtime_page();
+        return OK;
+#endif
+
+      default:
+        return -ENOTTY;
+    }
+}
+#endif
+
 #endif /* CONFIG_BOARDCTL */
@@ -30,6 +30,8 @@
 #include <nuttx/mm/mm.h>
 #include <arch/board/board.h>
 
+#include "board.h"
+
 /****************************************************************************
  * Pre-processor Definitions
  ****************************************************************************/
@@ -55,6 +57,9 @@
 
 void esp32s3_board_initialize(void)
 {
+#ifdef CONFIG_BOARD_ESP32S3_BOOTPROF
+  esp32s3_bootprof_mark(BOOTPROF_BOARD_INIT);
+#endif
 }
 
 /****************************************************************************
@@ -74,6 +79,10 @@ void esp32s3_board_initialize(void)
 #ifdef CONFIG_BOARD_LATE_INITIALIZE
 void board_late_initialize(void)
 {
+#ifdef CONFIG_BOARD_ESP32S3_BOOTPROF
+  esp32s3_bootprof_mark(BOOTPROF_LATE_INIT);
+#endif
+
   /* Perform board-specific initialization */
 
   esp32s3_bringup();
@@ -57,104 +57,231 @@
 #include <nuttx/input/buttons.h>
 #endif
 
+#ifdef CONFIG_ESP32S3_SPIFLASH
+#include "esp32s3_board_spiflash.h"
+#endif
+
+#include "board.h"
+
 /****************************************************************************
- * Public Functions
+ * Pre-processor Definitions
  ****************************************************************************/
 
+#define STEP(n)  INITSTEP_BIT(n)
+
 /****************************************************************************
- * Name: esp32s3_bringup
- *
- * Description:
- *   Perform architecture-specific initialization
- *
- *   CONFIG_BOARD_LATE_INITIALIZE=y :
- *     Called from board_late_initialize().
- *
- *   CONFIG_BOARD_LATE_INITIALIZE=n && CONFIG_BOARDCTL=y :
- *     Called from the NSH library
- *
+ * Private Types
  ****************************************************************************/
 
-int esp32s3_bringup(void)
+/* Bringup steps, in dependency order */
+
+enum esp32s3_step_e
 {
-  int ret;
+  STEP_HEAPCAPS = 0,
+  STEP_BUZZER,
+  STEP_PROCFS,
+  STEP_TMPFS,
+  STEP_TIMER,
+  STEP_RT_TIMER,
+  STEP_WATCHDOG,
+  STEP_BUTTONS,
+  STEP_SPIFLASH,
+  STEP_FB,
+  STEP_DFS,
+  STEP_LSLEEP,
+  STEP_PCOUNT,
+  STEP_STKMON,
+  STEP_TWDT,
+  STEP_HRTIME,
+  STEP_JITTER,
+  STEP_NSTEPS
+};
+
+/****************************************************************************
+ * Private Function Prototypes
+ ****************************************************************************/
 
 #ifdef CONFIG_BOARD_ESP32S3_BUZZER
+static int esp32s3_init_buzzer(void);
+#endif
+#ifdef CONFIG_FS_PROCFS
+static int esp32s3_init_procfs(void);
+#endif
+#ifdef CONFIG_FS_TMPFS
+static int esp32s3_init_tmpfs(void);
+#endif
+#ifdef CONFIG_INPUT_BUTTONS
+static int esp32s3_init_buttons(void);
+#endif
+#ifdef CONFIG_VIDEO_FB
+static int esp32s3_init_fb(void);
+#endif
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+static const struct esp32s3_initstep_s g_bringup_steps[STEP_NSTEPS] =
+{
+#ifdef CONFIG_BOARD_ESP32S3_HEAPCAPS
+  [STEP_HEAPCAPS] = { "heap pools", esp32s3_heapcaps_initialize, 0, 0 },
+#endif
+#ifdef CONFIG_BOARD_ESP32S3_BUZZER
+  [STEP_BUZZER]   = { "buzzer", esp32s3_init_buzzer, 0, 0 },
+#endif
+#ifdef CONFIG_FS_PROCFS
+  [STEP_PROCFS]   = { "procfs", esp32s3_init_procfs, 0, 0 },
+#endif
+#ifdef CONFIG_FS_TMPFS
+  [STEP_TMPFS]    = { "tmpfs", esp32s3_init_tmpfs, 0, 0 },
+#endif
+#ifdef CONFIG_ESP32S3_TIMER
+  [STEP_TIMER]    = { "timers", board_tim_init, 0, 0 },
+#endif
+#ifdef CONFIG_ESP32S3_RT_TIMER
+  [STEP_RT_TIMER] = { "RT timer", esp32s3_rt_timer_init, 0, 0 },
+#endif
+#ifdef CONFIG_WATCHDOG
+  [STEP_WATCHDOG] = { "watchdog timer", board_wdt_init, 0, 0 },
+#endif
+#ifdef CONFIG_INPUT_BUTTONS
+  [STEP_BUTTONS]  = { "button driver", esp32s3_init_buttons, 0, 0 },
+#endif
+#ifdef CONFIG_ESP32S3_SPIFLASH
+  [STEP_SPIFLASH] =
+  {
+    "SPI Flash", board_spiflash_init, 0, INITSTEP_BACKGROUND
+  },
+#endif
+#ifdef CONFIG_VIDEO_FB
+  /* Not in the background: /dev/fb0 has to exist before NSH can start a
+   * graphics application.
+   */
+
+  [STEP_FB]       = { "framebuffer", esp32s3_init_fb, 0, 0 },
+#endif
+#ifdef CONFIG_BOARD_ESP32S3_DFS
+  [STEP_DFS]      = { "DFS governor", esp32s3_dfs_initialize, 0, 0 },
+#endif
+#ifdef CONFIG_BOARD_ESP32S3_LSLEEP
+  [STEP_LSLEEP]   = { "light sleep", esp32s3_lsleep_initialize, 0, 0 },
+#endif
+#ifdef CONFIG_BOARD_ESP32S3_PCOUNT
+  [STEP_PCOUNT]   =
+  {
+    "driver counters", esp32s3_pcount_initialize, STEP(STEP_RT_TIMER), 0
+  },
+#endif
+#ifdef CONFIG_BOARD_ESP32S3_STKMON
+  [STEP_STKMON]   = { "stack monitor", esp32s3_stkmon_initialize, 0, 0 },
+#endif
+#ifdef CONFIG_BOARD_ESP32S3_TWDT
+  [STEP_TWDT]     =
+  {
+    "task watchdog", esp32s3_twdt_initialize, STEP(STEP_WATCHDOG), 0
+  },
+#endif
+#ifdef CONFIG_BOARD_ESP32S3_HRTIME
+  [STEP_HRTIME]   =
+  {
+    "time page", esp32s3_hrtime_initialize, STEP(STEP_RT_TIMER), 0
+  },
+#endif
+#ifdef CONFIG_BOARD_ESP32S3_AFFINITY_JITTER
+  [STEP_JITTER]   =
+  {
+    "jitter probes", esp32s3_affinity_initialize, STEP(STEP_RT_TIMER), 0
+  },
+#endif
+};
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+#ifdef CONFIG_BOARD_ESP32S3_BUZZER
+static int esp32s3_init_buzzer(void)
+{
   esp32s3_configgpio(CONFIG_BOARD_ESP32S3_BUZZER_PIN, OUTPUT | PULLDOWN);
   esp32s3_gpiowrite(CONFIG_BOARD_ESP32S3_BUZZER_PIN, false);
+  return OK;
+}
 #endif
 
 #ifdef CONFIG_FS_PROCFS
+static int esp32s3_init_procfs(void)
+{
   /* Mount the procfs file system */
 
-  ret = nx_mount(NULL, "/proc", "procfs", 0, NULL);
-  if (ret < 0)
-    {
-      syslog(LOG_ERR, "ERROR: Failed to mount procfs at /proc: %d\n", ret);
-    }
+  return nx_mount(NULL, "/proc", "procfs", 0, NULL);
+}
 #endif
 
 #ifdef CONFIG_FS_TMPFS
+static int esp32s3_init_tmpfs(void)
+{
   /* Mount the tmpfs file system */
 
-  ret = nx_mount(NULL, CONFIG_LIBC_TMPDIR, "tmpfs", 0, NULL);
-  if (ret < 0)
-    {
-      syslog(LOG_ERR, "ERROR: Failed to mount tmpfs at %s: %d\n",
-             CONFIG_LIBC_TMPDIR, ret);
-    }
+  return nx_mount(NULL, CONFIG_LIBC_TMPDIR, "tmpfs", 0, NULL);
+}
 #endif
 
-#ifdef CONFIG_ESP32S3_TIMER
-  /* Configure general purpose timers */
+#ifdef CONFIG_INPUT_BUTTONS
+static int esp32s3_init_buttons(void)
+{
+  /* Register the BUTTON driver */
 
-  ret = board_tim_init();
-  if (ret < 0)
-    {
-      syslog(LOG_ERR, "Failed to initialize timers: %d\n", ret);
-    }
+  return btn_lower_initialize("/dev/buttons");
+}
 #endif
 
-#ifdef CONFIG_ESP32S3_RT_TIMER
-  ret = esp32s3_rt_timer_init();
-  if (ret < 0)
-    {
-      syslog(LOG_ERR, "Failed to initialize RT timer: %d\n", ret);
-    }
+#ifdef CONFIG_VIDEO_FB
+static int esp32s3_init_fb(void)
+{
+  return fb_register(0, 0);
+}
 #endif
 
-#ifdef CONFIG_WATCHDOG
-  /* Configure watchdog timer */
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
 
-  ret = board_wdt_init();
-  if (ret < 0)
-    {
-      syslog(LOG_ERR, "Failed to initialize watchdog timer: %d\n", ret);
-    }
-#endif
+/****************************************************************************
+ * Name: esp32s3_bringup
+ *
+ * Description:
+ *   Perform architecture-specific initialization
+ *
+ *   CONFIG_BOARD_LATE_INITIALIZE=y :
+ *     Called from board_late_initialize().
+ *
+ *   CONFIG_BOARD_LATE_INITIALIZE=n && CONFIG_BOARDCTL=y :
+ *     Called from the NSH library
+ *
+ ****************************************************************************/
 
-#ifdef CONFIG_INPUT_BUTTONS
-  /* Register the BUTTON driver */
+int esp32s3_bringup(void)
+{
+  int ret;
 
-  ret = btn_lower_initialize("/dev/buttons");
+#ifdef CONFIG_BOARD_ESP32S3_BOOTPROF
+  ret = esp32s3_bootprof_initialize();
   if (ret < 0)
     {
-      syslog(LOG_ERR, "Failed to initialize button driver: %d\n", ret);
+      syslog(LOG_ERR, "ERROR: Failed to register /proc/boardinit: %d\n",
+             ret);
     }
 #endif
 
-#ifdef CONFIG_ESP32S3_SPIFLASH
-  ret = board_spiflash_init();
-  if (ret)
-    {
-      syslog(LOG_ERR, "ERROR: Failed to initialize SPI Flash\n");
-    }
+  ret = esp32s3_initsteps_run(g_bringup_steps, STEP_NSTEPS);
+
+#ifdef CONFIG_BOARD_ESP32S3_BOOTPROF
+  esp32s3_bootprof_mark(BOOTPROF_BRINGUP_DONE);
 #endif
 
-#if defined(CONFIG_VIDEO_FB)
-  fb_register(0, 0);
+#ifdef CONFIG_BOARD_ESP32S3_AFFINITY
+  esp32s3_affinity_apply();
 #endif
 
-  UNUSED(ret);
-  return OK;
+  return ret;
 }
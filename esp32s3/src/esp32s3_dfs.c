@@ -0,0 +1,419 @@
+/****************************************************************************
+ * boards/xtensa/esp32s3/esp32s3-eye/src/esp32s3_dfs.c
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <sys/types.h>
+#include <sys/param.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <errno.h>
+#include <debug.h>
+
+#include <nuttx/clock.h>
+#include <nuttx/spinlock.h>
+#include <nuttx/wqueue.h>
+
+#include "soc/rtc.h"
+
+#include "board.h"
+
+#ifdef CONFIG_BOARD_ESP32S3_DFS
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define DFS_PERIOD     MSEC2TICK(CONFIG_BOARD_ESP32S3_DFS_PERIOD_MS)
+#define DFS_UP_LOAD    CONFIG_BOARD_ESP32S3_DFS_UP_LOAD
+#define DFS_DOWN_LOAD  CONFIG_BOARD_ESP32S3_DFS_DOWN_LOAD
+
+#ifndef CONFIG_SMP_NCPUS
+#  define CONFIG_SMP_NCPUS 1
+#endif
+
+#if DFS_DOWN_LOAD >= DFS_UP_LOAD
+#  error "The down load threshold must be below the up load threshold"
+#endif
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+struct dfs_s
+{
+  spinlock_t lock;
+  uint8_t    level;                      /* DFS_LEVEL_* in use */
+  uint16_t   nrequest[DFS_NLEVELS];      /* Minimum level requests */
+  clock_t    holdend[DFS_NLEVELS];       /* End of the level holds */
+  uint32_t   nswitch;                    /* Frequency changes */
+  bool       stopped;                    /* The worker is not queued */
+
+  /* Last CPU load sample of the idle threads */
+
+  clock_t    active[CONFIG_SMP_NCPUS];
+  clock_t    total[CONFIG_SMP_NCPUS];
+
+  struct work_s work;
+};
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+static const uint16_t g_dfs_mhz[DFS_NLEVELS] =
+{
+  [DFS_LEVEL_80M]  = 80,
+  [DFS_LEVEL_160M] = 160,
+  [DFS_LEVEL_240M] = 240,
+};
+
+static struct dfs_s g_dfs =
+{
+  .lock = SP_UNLOCKED,
+};
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: dfs_set
+ *
+ * Description:
+ *   Switch the CPU clock to 'level'.  Called with the lock held.
+ *
+ ****************************************************************************/
+
+static void dfs_set(FAR struct dfs_s *dfs, int level)
+{
+  rtc_cpu_freq_config_t config;
+
+  if (level == dfs->level)
+    {
+      return;
+    }
+
+  if (rtc_clk_cpu_freq_mhz_to_config(g_dfs_mhz[level], &config))
+    {
+      rtc_clk_cpu_freq_set_config_fast(&config);
+      dfs->level = level;
+      dfs->nswitch++;
+
+#ifdef CONFIG_BOARD_ESP32S3_HRTIME
+      esp32s3_hrtime_setfreq(g_dfs_mhz[level] * 1000000);
+#endif
+    }
+}
+
+/****************************************************************************
+ * Name: dfs_floor
+ *
+ * Description:
+ *   Return the lowest level allowed by the pending requests and holds.
+ *   Called with the lock held.
+ *
+ ****************************************************************************/
+
+static int dfs_floor(FAR struct dfs_s *dfs, clock_t now)
+{
+  int level;
+
+  for (level = DFS_NLEVELS - 1; level > 0; level--)
+    {
+      if (dfs->nrequest[level] > 0 ||
+          (sclock_t)(dfs->holdend[level] - now) > 0)
+        {
+          break;
+        }
+    }
+
+  return level;
+}
+
+/****************************************************************************
+ * Name: dfs_load
+ *
+ * Description:
+ *   Return the busy percentage of the busiest CPU since the last sample,
+ *   from the time its idle thread ran.
+ *
+ ****************************************************************************/
+
+static int dfs_load(FAR struct dfs_s *dfs)
+{
+  struct cpuload_s cpuload;
+  clock_t active;
+  clock_t total;
+  int busy = 0;
+  int cpu;
+
+  for (cpu = 0; cpu < CONFIG_SMP_NCPUS; cpu++)
+    {
+      /* The idle thread of each CPU has the PID of the CPU */
+
+      if (clock_cpuload(cpu, &cpuload) < 0)
+        {
+          continue;
+        }
+
+      active = cpuload.active - dfs->active[cpu];
+      total  = cpuload.total - dfs->total[cpu];
+
+      /* The counters decay from time to time, use the totals then */
+
+      if (cpuload.total <= dfs->total[cpu] ||
+          cpuload.active < dfs->active[cpu] || active > total)
+        {
+          active = cpuload.active;
+          total  = cpuload.total;
+        }
+
+      dfs->active[cpu] = cpuload.active;
+      dfs->total[cpu]  = cpuload.total;
+
+      if (total > 0)
+        {
+          busy = MAX(busy, 100 - (int)(active * 100 / total));
+        }
+    }
+
+  return busy;
+}
+
+/****************************************************************************
+ * Name: dfs_worker
+ *
+ * Description:
+ *   Step the frequency up or down one level according to the load, never
+ *   below the requested minimum.  Not queued again at the lowest level
+ *   with no request or hold pending.
+ *
+ ****************************************************************************/
+
+static void dfs_worker(FAR void *arg)
+{
+  FAR struct dfs_s *dfs = arg;
+  irqstate_t flags;
+  bool stopped;
+  int floor;
+  int load;
+  int level;
+
+  load = dfs_load(dfs);
+
+  flags = spin_lock_irqsave(&dfs->lock);
+
+  level = dfs->level;
+  if (load > DFS_UP_LOAD && level < DFS_NLEVELS - 1)
+    {
+      level++;
+    }
+  else if (load < DFS_DOWN_LOAD && level > 0)
+    {
+      level--;
+    }
+
+  floor = dfs_floor(dfs, clock_systime_ticks());
+  dfs_set(dfs, MAX(level, floor));
+
+  /* At the lowest level with nothing requested or held there is nothing
+   * left to step down to.  Sleep until the next request or hold.
+   */
+
+  stopped      = dfs->level == 0 && floor == 0;
+  dfs->stopped = stopped;
+
+  spin_unlock_irqrestore(&dfs->lock, flags);
+
+  if (!stopped)
+    {
+      work_queue(LPWORK, &dfs->work, dfs_worker, dfs, DFS_PERIOD);
+    }
+}
+
+/****************************************************************************
+ * Name: dfs_wakeup
+ *
+ * Description:
+ *   Return true if the worker stopped and must be queued again once the
+ *   lock is released, and count it as running.  Called with the lock held.
+ *
+ ****************************************************************************/
+
+static bool dfs_wakeup(FAR struct dfs_s *dfs)
+{
+  bool stopped = dfs->stopped;
+
+  dfs->stopped = false;
+  return stopped;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: esp32s3_dfs_initialize
+ *
+ * Description:
+ *   Start the frequency governor from the frequency selected at boot.
+ *
+ ****************************************************************************/
+
+int esp32s3_dfs_initialize(void)
+{
+  FAR struct dfs_s *dfs = &g_dfs;
+  rtc_cpu_freq_config_t config;
+  int level;
+
+  rtc_clk_cpu_freq_get_config(&config);
+
+  for (level = DFS_NLEVELS - 1; level > 0; level--)
+    {
+      if (g_dfs_mhz[level] <= config.freq_mhz)
+        {
+          break;
+        }
+    }
+
+  dfs->level = level;
+  dfs_load(dfs);
+
+  return work_queue(LPWORK, &dfs->work, dfs_worker, dfs, DFS_PERIOD);
+}
+
+/****************************************************************************
+ * Name: esp32s3_dfs_request / esp32s3_dfs_release
+ *
+ * Description:
+ *   Keep the CPU at DFS_LEVEL_* 'level' or above until the matching
+ *   release.  Requests are counted, the frequency is raised at once and
+ *   lowered by the governor.  Callable from interrupt handlers.
+ *
+ ****************************************************************************/
+
+void esp32s3_dfs_request(int level)
+{
+  FAR struct dfs_s *dfs = &g_dfs;
+  irqstate_t flags;
+  bool wakeup;
+
+  DEBUGASSERT(level >= 0 && level < DFS_NLEVELS);
+
+  flags = spin_lock_irqsave(&dfs->lock);
+
+  dfs->nrequest[level]++;
+  if (level > dfs->level)
+    {
+      dfs_set(dfs, level);
+    }
+
+  wakeup = dfs_wakeup(dfs);
+
+  spin_unlock_irqrestore(&dfs->lock, flags);
+
+  if (wakeup)
+    {
+      work_queue(LPWORK, &dfs->work, dfs_worker, dfs, DFS_PERIOD);
+    }
+}
+
+void esp32s3_dfs_release(int level)
+{
+  FAR struct dfs_s *dfs = &g_dfs;
+  irqstate_t flags;
+
+  DEBUGASSERT(level >= 0 && level < DFS_NLEVELS);
+
+  flags = spin_lock_irqsave(&dfs->lock);
+
+  DEBUGASSERT(dfs->nrequest[level] > 0);
+  dfs->nrequest[level]--;
+
+  spin_unlock_irqrestore(&dfs->lock, flags);
+}
+
+/****************************************************************************
+ * Name: esp32s3_dfs_hold
+ *
+ * Description:
+ *   Keep the CPU at 'level' or above for the next 'ms' milliseconds, for
+ *   bursts of activity that have no natural end such as a display flush.
+ *   Callable from interrupt handlers.
+ *
+ ****************************************************************************/
+
+void esp32s3_dfs_hold(int level, unsigned int ms)
+{
+  FAR struct dfs_s *dfs = &g_dfs;
+  irqstate_t flags;
+  bool wakeup;
+  clock_t end;
+
+  DEBUGASSERT(level >= 0 && level < DFS_NLEVELS);
+
+  end = clock_systime_ticks() + MSEC2TICK(ms);
+
+  flags = spin_lock_irqsave(&dfs->lock);
+
+  if ((sclock_t)(end - dfs->holdend[level]) > 0)
+    {
+      dfs->holdend[level] = end;
+    }
+
+  if (level > dfs->level)
+    {
+      dfs_set(dfs, level);
+    }
+
+  wakeup = dfs_wakeup(dfs);
+
+  spin_unlock_irqrestore(&dfs->lock, flags);
+
+  if (wakeup)
+    {
+      work_queue(LPWORK, &dfs->work, dfs_worker, dfs, DFS_PERIOD);
+    }
+}
+
+/****************************************************************************
+ * Name: esp32s3_dfs_freq
+ *
+ * Description:
+ *   Return the CPU frequency in MHz and the number of changes so far.
+ *
+ ****************************************************************************/
+
+int esp32s3_dfs_freq(FAR uint32_t *nswitch)
+{
+  if (nswitch != NULL)
+    {
+      *nswitch = g_dfs.nswitch;
+    }
+
+  return g_dfs_mhz[g_dfs.level];
+}
+
+#endif /* CONFIG_BOARD_ESP32S3_DFS */
@@ -0,0 +1,475 @@
+/****************************************************************************
+ * boards/xtensa/esp32s3/esp32s3-eye/src/esp32s3_heapcaps.c
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <malloc.h>
+#include <string.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <syslog.h>
+#include <debug.h>
+
+#include <nuttx/arch.h>
+#include <nuttx/kmalloc.h>
+#include <nuttx/mm/mm.h>
+#include <nuttx/fs/fs.h>
+#include <nuttx/fs/procfs.h>
+
+#include "mm_heap/mm.h"
+#include "hardware/esp32s3_soc.h"
+
+#include "board.h"
+
+#ifdef CONFIG_BOARD_ESP32S3_HEAPCAPS
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define HEAPCAPS_LINELEN   64
+#define HEAPCAPS_NPOOLS    4
+
+/* Rows of /proc/heapcaps */
+
+#define HEAPCAPS_INTPOOL   0
+#define HEAPCAPS_EXTPOOL   1
+#define HEAPCAPS_INTERNAL  2
+#define HEAPCAPS_PSRAM     3
+
+/* DMA descriptors and buffers must be word aligned */
+
+#define HEAPCAPS_DMA_ALIGN 4
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+struct heapcaps_file_s
+{
+  struct procfs_file_s base;       /* Base open file structure */
+  char line[HEAPCAPS_LINELEN];     /* Pre-allocated buffer for lines */
+};
+
+/****************************************************************************
+ * Private Function Prototypes
+ ****************************************************************************/
+
+#ifdef CONFIG_FS_PROCFS_REGISTER
+static int     heapcaps_open(FAR struct file *filep,
+                             FAR const char *relpath, int oflags,
+                             mode_t mode);
+static int     heapcaps_close(FAR struct file *filep);
+static ssize_t heapcaps_read(FAR struct file *filep, FAR char *buffer,
+                             size_t buflen);
+static int     heapcaps_dup(FAR const struct file *oldp,
+                            FAR struct file *newp);
+static int     heapcaps_stat(FAR const char *relpath, FAR struct stat *buf);
+#endif
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+/* Internal SRAM reserved for latency critical and DMA buffers.  Being in
+ * .bss it is internal memory regardless of what the common heap spans.
+ */
+
+#if CONFIG_BOARD_ESP32S3_HEAPCAPS_INTERNAL > 0
+static uint8_t g_heapcaps_intmem[CONFIG_BOARD_ESP32S3_HEAPCAPS_INTERNAL]
+  aligned_data(16);
+#endif
+
+static FAR struct mm_heap_s *g_heapcaps_internal;
+
+/* Bulk memory carved out of PSRAM, if configured */
+
+static FAR struct mm_heap_s *g_heapcaps_external;
+#if CONFIG_BOARD_ESP32S3_HEAPCAPS_EXTERNAL > 0
+static FAR void *g_heapcaps_extmem;
+#endif
+
+#ifdef CONFIG_FS_PROCFS_REGISTER
+static FAR const char * const g_heapcaps_names[HEAPCAPS_NPOOLS] =
+{
+  "intpool",
+  "extpool",
+  "internal",
+  "psram",
+};
+
+static const struct procfs_operations g_heapcaps_operations =
+{
+  .open  = heapcaps_open,
+  .close = heapcaps_close,
+  .read  = heapcaps_read,
+  .dup   = heapcaps_dup,
+  .stat  = heapcaps_stat,
+};
+
+static const struct procfs_entry_s g_heapcaps_entry =
+{
+  "heapcaps", &g_heapcaps_operations, PROCFS_FILE_TYPE
+};
+#endif
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: heapcaps_isexternal
+ ****************************************************************************/
+
+static bool heapcaps_isexternal(FAR const void *mem)
+{
+  return (uintptr_t)mem >= SOC_EXTRAM_DATA_LOW &&
+         (uintptr_t)mem < SOC_EXTRAM_DATA_HIGH;
+}
+
+#ifdef CONFIG_FS_PROCFS_REGISTER
+
+/****************************************************************************
+ * Name: heapcaps_node
+ *
+ * Description:
+ *   Account one chunk of the common heap to internal SRAM or to PSRAM.
+ *   Called by mm_foreach() with the heap locked, so it must not allocate.
+ *
+ ****************************************************************************/
+
+static void heapcaps_node(FAR struct mm_allocnode_s *node, FAR void *arg)
+{
+  FAR struct mallinfo *info = arg;
+  int size = MM_SIZEOF_NODE(node);
+
+  info = &info[heapcaps_isexternal(node) ?
+               HEAPCAPS_PSRAM : HEAPCAPS_INTERNAL];
+  info->arena += size;
+
+  if (MM_NODE_IS_ALLOC(node))
+    {
+      info->uordblks += size;
+    }
+  else
+    {
+      info->fordblks += size;
+      if (size > info->mxordblk)
+        {
+          info->mxordblk = size;
+        }
+    }
+}
+
+/****************************************************************************
+ * Name: heapcaps_open
+ ****************************************************************************/
+
+static int heapcaps_open(FAR struct file *filep, FAR const char *relpath,
+                         int oflags, mode_t mode)
+{
+  FAR struct heapcaps_file_s *priv;
+
+  /* This is a read-only file */
+
+  if ((oflags & O_WRONLY) != 0 || (oflags & O_RDONLY) == 0)
+    {
+      return -EACCES;
+    }
+
+  priv = kmm_zalloc(sizeof(struct heapcaps_file_s));
+  if (priv == NULL)
+    {
+      return -ENOMEM;
+    }
+
+  filep->f_priv = priv;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: heapcaps_close
+ ****************************************************************************/
+
+static int heapcaps_close(FAR struct file *filep)
+{
+  kmm_free(filep->f_priv);
+  filep->f_priv = NULL;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: heapcaps_read
+ ****************************************************************************/
+
+static ssize_t heapcaps_read(FAR struct file *filep, FAR char *buffer,
+                             size_t buflen)
+{
+  FAR struct heapcaps_file_s *priv = filep->f_priv;
+  struct mallinfo info[HEAPCAPS_NPOOLS];
+  off_t offset = filep->f_pos;
+  size_t totalsize = 0;
+  size_t linesize;
+  size_t copysize;
+  int i;
+
+  DEBUGASSERT(priv != NULL);
+
+  memset(info, 0, sizeof(info));
+
+  if (g_heapcaps_internal != NULL)
+    {
+      info[HEAPCAPS_INTPOOL] = mm_mallinfo(g_heapcaps_internal);
+    }
+
+  if (g_heapcaps_external != NULL)
+    {
+      info[HEAPCAPS_EXTPOOL] = mm_mallinfo(g_heapcaps_external);
+    }
+
+  /* Split the common heap by address, mallinfo() would lump internal SRAM
+   * and PSRAM together.  The PSRAM pool is an allocation of it.
+   */
+
+  mm_foreach(g_mmheap, heapcaps_node, info);
+
+  linesize = procfs_snprintf(priv->line, HEAPCAPS_LINELEN,
+                             "%-9s %8s %8s %8s %8s\n",
+                             "POOL", "SIZE", "USED", "FREE", "LARGEST");
+  copysize = procfs_memcpy(priv->line, linesize, buffer, buflen, &offset);
+  totalsize += copysize;
+
+  for (i = 0; i < HEAPCAPS_NPOOLS && totalsize < buflen; i++)
+    {
+      linesize = procfs_snprintf(priv->line, HEAPCAPS_LINELEN,
+                                 "%-9s %8d %8d %8d %8d\n",
+                                 g_heapcaps_names[i],
+                                 info[i].arena, info[i].uordblks,
+                                 info[i].fordblks, info[i].mxordblk);
+      copysize = procfs_memcpy(priv->line, linesize, buffer + totalsize,
+                               buflen - totalsize, &offset);
+      totalsize += copysize;
+    }
+
+  filep->f_pos += totalsize;
+  return totalsize;
+}
+
+/****************************************************************************
+ * Name: heapcaps_dup
+ ****************************************************************************/
+
+static int heapcaps_dup(FAR const struct file *oldp, FAR struct file *newp)
+{
+  FAR struct heapcaps_file_s *newpriv;
+
+  newpriv = kmm_zalloc(sizeof(struct heapcaps_file_s));
+  if (newpriv == NULL)
+    {
+      return -ENOMEM;
+    }
+
+  memcpy(newpriv, oldp->f_priv, sizeof(struct heapcaps_file_s));
+  newp->f_priv = newpriv;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: heapcaps_stat
+ ****************************************************************************/
+
+static int heapcaps_stat(FAR const char *relpath, FAR struct stat *buf)
+{
+  memset(buf, 0, sizeof(struct stat));
+  buf->st_mode = S_IFREG | S_IROTH | S_IRGRP | S_IRUSR;
+  return OK;
+}
+
+#endif /* CONFIG_FS_PROCFS_REGISTER */
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: esp32s3_heapcaps_initialize
+ *
+ * Description:
+ *   Create the configured pools: the internal one in .bss and the
+ *   external one carved out of the part of the common heap that lies in
+ *   PSRAM.  A pool size of zero reserves nothing.
+ *
+ ****************************************************************************/
+
+int esp32s3_heapcaps_initialize(void)
+{
+#if CONFIG_BOARD_ESP32S3_HEAPCAPS_INTERNAL > 0
+  g_heapcaps_internal = mm_initialize("intheap", g_heapcaps_intmem,
+                                      sizeof(g_heapcaps_intmem));
+  if (g_heapcaps_internal == NULL)
+    {
+      return -ENOMEM;
+    }
+#endif
+
+#if CONFIG_BOARD_ESP32S3_HEAPCAPS_EXTERNAL > 0
+  /* The internal part of the common heap is much smaller than the pool,
+   * so a block this large can only come from PSRAM.  Check it anyway,
+   * the external pool must never hand out internal memory.
+   */
+
+  g_heapcaps_extmem = kumm_malloc(CONFIG_BOARD_ESP32S3_HEAPCAPS_EXTERNAL);
+  if (g_heapcaps_extmem != NULL && !heapcaps_isexternal(g_heapcaps_extmem))
+    {
+      kumm_free(g_heapcaps_extmem);
+      g_heapcaps_extmem = NULL;
+    }
+
+  if (g_heapcaps_extmem != NULL)
+    {
+      g_heapcaps_external =
+        mm_initialize("extheap", g_heapcaps_extmem,
+                      CONFIG_BOARD_ESP32S3_HEAPCAPS_EXTERNAL);
+    }
+  else
+    {
+      /* External requests still go to the common heap */
+
+      syslog(LOG_WARNING, "WARNING: No PSRAM pool, using the common heap\n");
+    }
+#endif
+
+#ifdef CONFIG_FS_PROCFS_REGISTER
+  return procfs_register(&g_heapcaps_entry);
+#else
+  return OK;
+#endif
+}
+
+/****************************************************************************
+ * Name: esp32s3_caps_malloc
+ *
+ * Description:
+ *   Allocate memory with the HEAPCAP_* capabilities in 'caps'.
+ *
+ *   HEAPCAP_INTERNAL and HEAPCAP_DMA are served from the internal pool,
+ *   then from the internal part of the common heap.  HEAPCAP_EXTERNAL is
+ *   served from the PSRAM pool, then from the common heap, so that bulk
+ *   data leaves internal SRAM alone when it can.  HEAPCAP_EXEC comes from
+ *   the text heap.  Without capabilities this is kumm_malloc().
+ *
+ * Returned Value:
+ *   The allocated memory, or NULL if no memory with the capabilities is
+ *   available.  It must be released with esp32s3_caps_free().
+ *
+ ****************************************************************************/
+
+FAR void *esp32s3_caps_malloc(size_t size, uint32_t caps)
+{
+  FAR void *mem;
+
+  if ((caps & HEAPCAP_EXEC) != 0)
+    {
+#ifdef CONFIG_ARCH_USE_TEXT_HEAP
+      return up_textheap_memalign(sizeof(uint32_t), size);
+#else
+      return NULL;
+#endif
+    }
+
+  if ((caps & (HEAPCAP_INTERNAL | HEAPCAP_DMA)) != 0)
+    {
+      mem = NULL;
+      if (g_heapcaps_internal != NULL)
+        {
+          mem = mm_memalign(g_heapcaps_internal, HEAPCAPS_DMA_ALIGN, size);
+        }
+
+      if (mem == NULL)
+        {
+          mem = kumm_memalign(HEAPCAPS_DMA_ALIGN, size);
+          if (mem != NULL && heapcaps_isexternal(mem))
+            {
+              kumm_free(mem);
+              mem = NULL;
+            }
+        }
+
+      return mem;
+    }
+
+  if ((caps & HEAPCAP_EXTERNAL) != 0 && g_heapcaps_external != NULL)
+    {
+      mem = mm_malloc(g_heapcaps_external, size);
+      if (mem != NULL)
+        {
+          return mem;
+        }
+    }
+
+  return kumm_malloc(size);
+}
+
+/****************************************************************************
+ * Name: esp32s3_caps_free
+ *
+ * Description:
+ *   Release memory returned by esp32s3_caps_malloc().
+ *
+ ****************************************************************************/
+
+void esp32s3_caps_free(FAR void *mem)
+{
+  if (mem == NULL)
+    {
+      return;
+    }
+
+  if (g_heapcaps_internal != NULL &&
+      mm_heapmember(g_heapcaps_internal, mem))
+    {
+      mm_free(g_heapcaps_internal, mem);
+    }
+  else if (g_heapcaps_external != NULL &&
+           mm_heapmember(g_heapcaps_external, mem))
+    {
+      mm_free(g_heapcaps_external, mem);
+    }
+#ifdef CONFIG_ARCH_USE_TEXT_HEAP
+  else if (up_textheap_heapmember(mem))
+    {
+      up_textheap_free(mem);
+    }
+#endif
+  else
+    {
+      kumm_free(mem);
+    }
+}
+
+#endif /* CONFIG_BOARD_ESP32S3_HEAPCAPS */
@@ -0,0 +1,490 @@
+/****************************************************************************
+ * boards/xtensa/esp32s3/esp32s3-eye/src/esp32s3_lsleep.c
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <sys/types.h>
+#include <sys/param.h>
+#include <sys/stat.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <string.h>
+#include <sched.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <syslog.h>
+#include <debug.h>
+
+#include <nuttx/clock.h>
+#include <nuttx/kmalloc.h>
+#include <nuttx/kthread.h>
+#include <nuttx/fs/fs.h>
+#include <nuttx/fs/procfs.h>
+#include <nuttx/power/pm.h>
+#include <nuttx/semaphore.h>
+
+#include "esp_sleep.h"
+#include "esp32s3_pm.h"
+#include "esp32s3_tickless.h"
+
+#include "board.h"
+
+#ifdef CONFIG_BOARD_ESP32S3_LSLEEP
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define LSLEEP_MIN_US      CONFIG_BOARD_ESP32S3_LSLEEP_MIN_US
+#define LSLEEP_LATENCY_US  CONFIG_BOARD_ESP32S3_LSLEEP_LATENCY_US
+#define LSLEEP_BUTTON_PIN  CONFIG_BOARD_ESP32S3_LSLEEP_BUTTON_PIN
+#define LSLEEP_TOUCH_PIN   CONFIG_BOARD_ESP32S3_LSLEEP_TOUCH_PIN
+#define LSLEEP_LINELEN     64
+
+/* Pins that wake the CPU when pulled low, ext1 takes RTC GPIOs only */
+
+#if LSLEEP_BUTTON_PIN >= 0
+#  define LSLEEP_BUTTON_MASK  (UINT64_C(1) << LSLEEP_BUTTON_PIN)
+#else
+#  define LSLEEP_BUTTON_MASK  0
+#endif
+
+#if LSLEEP_TOUCH_PIN >= 0
+#  define LSLEEP_TOUCH_MASK   (UINT64_C(1) << LSLEEP_TOUCH_PIN)
+#else
+#  define LSLEEP_TOUCH_MASK   0
+#endif
+
+#define LSLEEP_WAKE_MASK   (LSLEEP_BUTTON_MASK | LSLEEP_TOUCH_MASK)
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+struct lsleep_s
+{
+  sem_t    sem;            /* Posted with each new deadline */
+  uint64_t deadline;       /* Next UI deadline, in microseconds */
+  uint64_t start;          /* Time of the initialization */
+
+  /* Statistics */
+
+  uint32_t nrequest;       /* Deadlines received */
+  uint32_t nsleep;         /* Light sleeps entered */
+  uint32_t nshort;         /* Deadline or timer too close to sleep */
+  uint32_t nveto;          /* Sleep refused by a driver */
+  uint32_t nwaketimer;     /* Woken by the deadline or a timer */
+  uint32_t nwakegpio;      /* Woken by the button or the touch panel */
+  uint32_t nlate;          /* Woken after the deadline */
+  uint32_t latemax;        /* Worst lateness (us) */
+  uint64_t slept;          /* Time spent in light sleep (us) */
+};
+
+struct lsleep_file_s
+{
+  struct procfs_file_s base;       /* Base open file structure */
+  char line[LSLEEP_LINELEN];       /* Pre-allocated buffer for lines */
+};
+
+/****************************************************************************
+ * Private Function Prototypes
+ ****************************************************************************/
+
+#ifdef CONFIG_FS_PROCFS_REGISTER
+static int     lsleep_open(FAR struct file *filep, FAR const char *relpath,
+                           int oflags, mode_t mode);
+static int     lsleep_close(FAR struct file *filep);
+static ssize_t lsleep_read(FAR struct file *filep, FAR char *buffer,
+                           size_t buflen);
+static int     lsleep_dup(FAR const struct file *oldp,
+                          FAR struct file *newp);
+static int     lsleep_stat(FAR const char *relpath, FAR struct stat *buf);
+#endif
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+static struct lsleep_s g_lsleep =
+{
+  .sem = SEM_INITIALIZER(0),
+};
+
+#ifdef CONFIG_FS_PROCFS_REGISTER
+static const struct procfs_operations g_lsleep_operations =
+{
+  .open  = lsleep_open,
+  .close = lsleep_close,
+  .read  = lsleep_read,
+  .dup   = lsleep_dup,
+  .stat  = lsleep_stat,
+};
+
+static const struct procfs_entry_s g_lsleep_entry =
+{
+  "lsleep", &g_lsleep_operations, PROCFS_FILE_TYPE
+};
+#endif
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: lsleep_now
+ *
+ * Description:
+ *   Return the system time in microseconds.  The time spent in light
+ *   sleep is added back by the power management on wake up.
+ *
+ ****************************************************************************/
+
+static uint64_t lsleep_now(void)
+{
+  struct timespec ts;
+
+  clock_systime_timespec(&ts);
+  return (uint64_t)ts.tv_sec * USEC_PER_SEC + ts.tv_nsec / NSEC_PER_USEC;
+}
+
+/****************************************************************************
+ * Name: lsleep_enter
+ *
+ * Description:
+ *   Sleep for 'usec' microseconds unless a driver holds the CPU awake.
+ *
+ ****************************************************************************/
+
+static void lsleep_enter(FAR struct lsleep_s *ls, uint32_t usec)
+{
+  uint64_t before;
+  uint64_t after;
+  uint32_t late;
+
+  /* Drivers keep the system awake with pm_stay() or veto the transition
+   * from their prepare() callback.
+   */
+
+  if (pm_staycount(PM_IDLE_DOMAIN, PM_NORMAL) > 0 ||
+      pm_changestate(PM_IDLE_DOMAIN, PM_STANDBY) < 0)
+    {
+      ls->nveto++;
+      return;
+    }
+
+#if LSLEEP_WAKE_MASK != 0
+  esp_sleep_enable_ext1_wakeup(LSLEEP_WAKE_MASK,
+                               ESP_EXT1_WAKEUP_ANY_LOW);
+#endif
+
+  before = lsleep_now();
+  esp32s3_pmstandby(usec);
+  after = lsleep_now();
+
+  pm_changestate(PM_IDLE_DOMAIN, PM_NORMAL);
+
+  ls->nsleep++;
+  ls->slept += after - before;
+
+  if (esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_EXT1)
+    {
+      ls->nwakegpio++;
+    }
+  else
+    {
+      ls->nwaketimer++;
+    }
+
+  if (after > ls->deadline)
+    {
+      late = after - ls->deadline;
+      ls->nlate++;
+      if (late > ls->latemax)
+        {
+          ls->latemax = late;
+        }
+    }
+}
+
+/****************************************************************************
+ * Name: lsleep_thread
+ *
+ * Description:
+ *   Runs at the lowest priority, so it only gets the CPU once every other
+ *   thread has blocked, usually with the UI waiting for its deadline.
+ *
+ ****************************************************************************/
+
+static int lsleep_thread(int argc, FAR char *argv[])
+{
+  FAR struct lsleep_s *ls = &g_lsleep;
+  uint64_t usec;
+  uint64_t now;
+
+  for (; ; )
+    {
+      nxsem_wait_uninterruptible(&ls->sem);
+
+      /* Wake early enough for the UI to meet its deadline */
+
+      now = lsleep_now();
+      if (ls->deadline < now + LSLEEP_LATENCY_US + LSLEEP_MIN_US)
+        {
+          ls->nshort++;
+          continue;
+        }
+
+      /* and no later than the next timer event of the scheduler, which
+       * light sleep would otherwise delay.  up_get_idletime() returns zero
+       * when it cannot tell, the sleep is skipped then.
+       */
+
+      usec = ls->deadline - LSLEEP_LATENCY_US - now;
+      usec = MIN(usec, up_get_idletime());
+
+      if (usec < LSLEEP_MIN_US)
+        {
+          ls->nshort++;
+          continue;
+        }
+
+      lsleep_enter(ls, usec);
+    }
+
+  return OK;
+}
+
+#ifdef CONFIG_FS_PROCFS_REGISTER
+
+/****************************************************************************
+ * Name: lsleep_open
+ ****************************************************************************/
+
+static int lsleep_open(FAR struct file *filep, FAR const char *relpath,
+                       int oflags, mode_t mode)
+{
+  FAR struct lsleep_file_s *priv;
+
+  /* This is a read-only file */
+
+  if ((oflags & O_WRONLY) != 0 || (oflags & O_RDONLY) == 0)
+    {
+      return -EACCES;
+    }
+
+  priv = kmm_zalloc(sizeof(struct lsleep_file_s));
+  if (priv == NULL)
+    {
+      return -ENOMEM;
+    }
+
+  filep->f_priv = priv;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: lsleep_close
+ ****************************************************************************/
+
+static int lsleep_close(FAR struct file *filep)
+{
+  kmm_free(filep->f_priv);
+  filep->f_priv = NULL;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: lsleep_read
+ *
+ * Description:
+ *   Report the counters and the sleep residency.
+ *
+ ****************************************************************************/
+
+static ssize_t lsleep_read(FAR struct file *filep, FAR char *buffer,
+                           size_t buflen)
+{
+  FAR struct lsleep_file_s *priv = filep->f_priv;
+  FAR struct lsleep_s *ls = &g_lsleep;
+  off_t offset = filep->f_pos;
+  size_t totalsize = 0;
+  size_t linesize;
+  size_t copysize;
+  uint64_t elapsed;
+  uint64_t slept;
+  uint32_t values[10];
+  FAR const char *names[10];
+  int i;
+
+  DEBUGASSERT(priv != NULL);
+
+  elapsed = lsleep_now() - ls->start;
+  slept   = MIN(ls->slept, elapsed);
+
+  names[0]  = "requests";
+  values[0] = ls->nrequest;
+  names[1]  = "sleeps";
+  values[1] = ls->nsleep;
+  names[2]  = "too_short";
+  values[2] = ls->nshort;
+  names[3]  = "vetoed";
+  values[3] = ls->nveto;
+  names[4]  = "wake_timer";
+  values[4] = ls->nwaketimer;
+  names[5]  = "wake_gpio";
+  values[5] = ls->nwakegpio;
+  names[6]  = "late";
+  values[6] = ls->nlate;
+  names[7]  = "late_max_us";
+  values[7] = ls->latemax;
+
+  /* Deadlines per second approximate the UI refresh rate */
+
+  names[8]  = "refresh_millihz";
+  values[8] = elapsed > 0 ?
+              (uint32_t)((uint64_t)ls->nrequest * 1000000000 / elapsed) : 0;
+  names[9]  = "residency_pct";
+  values[9] = elapsed > 0 ? (uint32_t)(slept * 100 / elapsed) : 0;
+
+  for (i = 0; i < 10 && totalsize < buflen; i++)
+    {
+      linesize = procfs_snprintf(priv->line, LSLEEP_LINELEN,
+                                 "%-15s %10" PRIu32 "\n",
+                                 names[i], values[i]);
+      copysize = procfs_memcpy(priv->line, linesize, buffer + totalsize,
+                               buflen - totalsize, &offset);
+      totalsize += copysize;
+    }
+
+  filep->f_pos += totalsize;
+  return totalsize;
+}
+
+/****************************************************************************
+ * Name: lsleep_dup
+ ****************************************************************************/
+
+static int lsleep_dup(FAR const struct file *oldp, FAR struct file *newp)
+{
+  FAR struct lsleep_file_s *newpriv;
+
+  newpriv = kmm_zalloc(sizeof(struct lsleep_file_s));
+  if (newpriv == NULL)
+    {
+      return -ENOMEM;
+    }
+
+  memcpy(newpriv, oldp->f_priv, sizeof(struct lsleep_file_s));
+  newp->f_priv = newpriv;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: lsleep_stat
+ ****************************************************************************/
+
+static int lsleep_stat(FAR const char *relpath, FAR struct stat *buf)
+{
+  memset(buf, 0, sizeof(struct stat));
+  buf->st_mode = S_IFREG | S_IROTH | S_IRGRP | S_IRUSR;
+  return OK;
+}
+
+#endif /* CONFIG_FS_PROCFS_REGISTER */
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: esp32s3_lsleep_initialize
+ *
+ * Description:
+ *   Keep the idle loop out of the fixed length standby of the power
+ *   management, start the sleep thread and register /proc/lsleep.
+ *
+ ****************************************************************************/
+
+int esp32s3_lsleep_initialize(void)
+{
+  int ret;
+
+  /* Light sleep is entered on UI deadlines only */
+
+  pm_stay(PM_IDLE_DOMAIN, PM_IDLE);
+
+  g_lsleep.start = lsleep_now();
+
+  ret = kthread_create("lsleep", SCHED_PRIORITY_MIN,
+                       CONFIG_BOARD_ESP32S3_LSLEEP_STACKSIZE,
+                       lsleep_thread, NULL);
+  if (ret < 0)
+    {
+      syslog(LOG_ERR, "ERROR: Failed to start the sleep thread: %d\n", ret);
+      pm_relax(PM_IDLE_DOMAIN, PM_IDLE);
+      return ret;
+    }
+
+#ifdef CONFIG_FS_PROCFS_REGISTER
+  ret = procfs_register(&g_lsleep_entry);
+  if (ret < 0)
+    {
+      syslog(LOG_ERR, "ERROR: Failed to register /proc/lsleep: %d\n", ret);
+    }
+#endif
+
+  return OK;
+}
+
+/****************************************************************************
+ * Name: esp32s3_lsleep_deadline
+ *
+ * Description:
+ *   Called through BOARDIOC_UI_DEADLINE by the UI loop right before it
+ *   waits for its next timer.  'usec' is the time left until then, for
+ *   LVGL the value returned by lv_timer_handler() in microseconds.  The
+ *   board sleeps through that time if nothing else needs the CPU.
+ *
+ ****************************************************************************/
+
+int esp32s3_lsleep_deadline(uint32_t usec)
+{
+  FAR struct lsleep_s *ls = &g_lsleep;
+  int semcount;
+
+  ls->deadline = lsleep_now() + usec;
+  ls->nrequest++;
+
+  /* A single pending post is enough, the thread reads the last deadline */
+
+  nxsem_get_value(&ls->sem, &semcount);
+  if (semcount <= 0)
+    {
+      nxsem_post(&ls->sem);
+    }
+
+  return OK;
+}
+
+#endif /* CONFIG_BOARD_ESP32S3_LSLEEP */
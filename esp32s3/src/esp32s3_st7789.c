@@ -27,9 +27,114 @@
 #include <nuttx/spi/spi.h>
 #include <nuttx/lcd/st7789.h>
 
+#include "board.h"
 #include "esp32s3_gpio.h"
 #include "esp32s3_spi.h"
 
+#ifdef CONFIG_BOARD_ESP32S3_PCOUNT
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+/* The display traffic is counted by wrapping the operations of its bus,
+ * the SPI driver itself is left to program the controller.
+ */
+
+static FAR const struct spi_ops_s *g_lcd_spiops;
+static struct spi_ops_s g_lcd_pcountops;
+static bool     g_lcd_selected;          /* The display is selected */
+static int      g_lcd_nbits = 8;         /* Width last set on the bus */
+static uint64_t g_lcd_pcstart;           /* Time it was selected */
+static size_t   g_lcd_pcbytes;           /* Bytes moved since then */
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: lcd_pcount_select
+ ****************************************************************************/
+
+static void lcd_pcount_select(FAR struct spi_dev_s *dev, uint32_t devid,
+                              bool selected)
+{
+  g_lcd_spiops->select(dev, devid, selected);
+
+  if (devid == SPIDEV_DISPLAY(0) && selected != g_lcd_selected)
+    {
+      if (selected)
+        {
+          g_lcd_pcstart = esp32s3_pcount_begin();
+          g_lcd_pcbytes = 0;
+        }
+      else
+        {
+          esp32s3_pcount_end(PCOUNT_DISPLAY, g_lcd_pcstart,
+                             g_lcd_pcbytes, OK);
+        }
+
+      g_lcd_selected = selected;
+    }
+}
+
+/****************************************************************************
+ * Name: lcd_pcount_setbits
+ ****************************************************************************/
+
+static void lcd_pcount_setbits(FAR struct spi_dev_s *dev, int nbits)
+{
+  g_lcd_nbits = nbits;
+  g_lcd_spiops->setbits(dev, nbits);
+}
+
+/****************************************************************************
+ * Name: lcd_pcount_send
+ ****************************************************************************/
+
+static uint32_t lcd_pcount_send(FAR struct spi_dev_s *dev, uint32_t wd)
+{
+  g_lcd_pcbytes += g_lcd_nbits > 8 ? 2 : 1;
+  return g_lcd_spiops->send(dev, wd);
+}
+
+#ifdef CONFIG_SPI_EXCHANGE
+
+/****************************************************************************
+ * Name: lcd_pcount_exchange
+ ****************************************************************************/
+
+static void lcd_pcount_exchange(FAR struct spi_dev_s *dev,
+                                FAR const void *txbuffer,
+                                FAR void *rxbuffer, size_t nwords)
+{
+  g_lcd_pcbytes += g_lcd_nbits > 8 ? nwords * 2 : nwords;
+  g_lcd_spiops->exchange(dev, txbuffer, rxbuffer, nwords);
+}
+
+#else
+
+/****************************************************************************
+ * Name: lcd_pcount_sndblock / lcd_pcount_recvblock
+ ****************************************************************************/
+
+static void lcd_pcount_sndblock(FAR struct spi_dev_s *dev,
+                                FAR const void *buffer, size_t nwords)
+{
+  g_lcd_pcbytes += g_lcd_nbits > 8 ? nwords * 2 : nwords;
+  g_lcd_spiops->sndblock(dev, buffer, nwords);
+}
+
+static void lcd_pcount_recvblock(FAR struct spi_dev_s *dev,
+                                 FAR void *buffer, size_t nwords)
+{
+  g_lcd_pcbytes += g_lcd_nbits > 8 ? nwords * 2 : nwords;
+  g_lcd_spiops->recvblock(dev, buffer, nwords);
+}
+
+#endif /* CONFIG_SPI_EXCHANGE */
+#endif /* CONFIG_BOARD_ESP32S3_PCOUNT */
+
 /****************************************************************************
  * Public Functions
  ****************************************************************************/
@@ -58,6 +163,28 @@ struct lcd_dev_s *board_graphics_setup(unsigned int devno)
       return NULL;
     }
 
+#ifdef CONFIG_BOARD_ESP32S3_PCOUNT
+  /* Count the display traffic, once even if the display is set up again */
+
+  if (spi->ops != &g_lcd_pcountops)
+    {
+      g_lcd_spiops    = spi->ops;
+      g_lcd_pcountops = *spi->ops;
+
+      g_lcd_pcountops.select    = lcd_pcount_select;
+      g_lcd_pcountops.setbits   = lcd_pcount_setbits;
+      g_lcd_pcountops.send      = lcd_pcount_send;
+#  ifdef CONFIG_SPI_EXCHANGE
+      g_lcd_pcountops.exchange  = lcd_pcount_exchange;
+#  else
+      g_lcd_pcountops.sndblock  = lcd_pcount_sndblock;
+      g_lcd_pcountops.recvblock = lcd_pcount_recvblock;
+#  endif
+
+      spi->ops = &g_lcd_pcountops;
+    }
+#endif
+
   return st7789_lcdinitialize(spi);
 }
 
@@ -70,6 +197,17 @@ int esp32s3_spi2_cmddata(struct spi_dev_s *dev, uint32_t devid, bool cmd)
 {
   if (devid == SPIDEV_DISPLAY(0))
     {
+#if defined(CONFIG_BOARD_ESP32S3_DFS) && \
+    CONFIG_BOARD_ESP32S3_DFS_LCD_HOLD_MS > 0
+      /* Pixel data follows, keep the CPU fast while the frame is sent */
+
+      if (!cmd)
+        {
+          esp32s3_dfs_hold(DFS_LEVEL_240M,
+                           CONFIG_BOARD_ESP32S3_DFS_LCD_HOLD_MS);
+        }
+#endif
+
       esp32s3_gpiowrite(CONFIG_BOARD_ESP32S3_LCD_ST7789_DC_PIN, !cmd);
       return OK;
     }